@@ -17,6 +17,11 @@ public:
 	{
 		API_Key = "";
 		EnableNewActionSystem = false;
+		MicrophonePreRollDuration = 0;
+		VoiceReplicationMinBitrate = 12000;
+		VoiceReplicationMaxBitrate = 32000;
+		EnableVoiceRelevancyCulling = true;
+		MaxAudibleVoices = 8;
 	}
 	/* API Key Issued from the website */
 	UPROPERTY(Config, EditAnywhere, Category = "Convai API")
@@ -25,6 +30,26 @@ public:
 	/* API Key Issued from the website */
 	UPROPERTY(Config, EditAnywhere, Category = "Convai API", meta = (DisplayName = "Enable New Action System (Experimental)"))
 	bool EnableNewActionSystem;
+
+	/* Milliseconds of microphone audio kept before "Start Talking" and sent with the new turn so the first syllable is not lost, 0 disables it and keeps the microphone closed while not talking */
+	UPROPERTY(Config, EditAnywhere, Category = "Convai Microphone", meta = (ClampMin = "0", ClampMax = "2000", Units = "ms"))
+	int32 MicrophonePreRollDuration;
+
+	/* Lowest Opus bitrate in bits per second used for replicated character voices on congested or lossy connections */
+	UPROPERTY(Config, EditAnywhere, Category = "Convai Network", meta = (ClampMin = "6000", ClampMax = "510000"))
+	int32 VoiceReplicationMinBitrate;
+
+	/* Highest Opus bitrate in bits per second used for replicated character voices on healthy connections */
+	UPROPERTY(Config, EditAnywhere, Category = "Convai Network", meta = (ClampMin = "6000", ClampMax = "510000"))
+	int32 VoiceReplicationMaxBitrate;
+
+	/* Only send character voice packets to clients within the attenuation range of the character, transcripts and lipsync are still sent to everyone */
+	UPROPERTY(Config, EditAnywhere, Category = "Convai Network")
+	bool EnableVoiceRelevancyCulling;
+
+	/* Most character voices played at once, the quietest and most distant ones outside the active conversation are culled and skip decoding and lipsync, 0 plays all of them */
+	UPROPERTY(Config, EditAnywhere, Category = "Convai Audio", meta = (ClampMin = "0"))
+	int32 MaxAudibleVoices;
 };
 
 
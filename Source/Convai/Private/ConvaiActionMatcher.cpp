@@ -0,0 +1,246 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiActionMatcher.h"
+#include "ConvaiActionUtils.h"
+#include "ConvaiUtils.h"
+
+namespace
+{
+	/** An action matches when fewer than this many edits away */
+	constexpr int32 ActionMatchMaxDistance = 3;
+
+	/** Character and object names allow half their length in edits, within these bounds */
+	constexpr int32 NameMatchMinDistance = 2;
+	constexpr int32 NameMatchMaxDistance = 4;
+
+	FString JoinWords(const TArray<FString>& Words, int32 First, int32 NumWords)
+	{
+		FString Result;
+		for (int32 i = First; i < First + NumWords; i++)
+		{
+			if (i > First)
+				Result.AppendChar(TEXT(' '));
+			Result += Words[i];
+		}
+		return Result;
+	}
+
+	int32 CountWords(const FString& Phrase)
+	{
+		TArray<FString> Words;
+		return Phrase.ParseIntoArray(Words, TEXT(" "), true);
+	}
+
+	/** Words of the parsed action, quoted text is left out and ends the word before it */
+	TArray<FString> CollectWordsOutsideQuotes(const FString& SearchString)
+	{
+		TArray<FString> Words;
+		FString CurrentWord;
+		bool bInsideQuotes = false;
+		for (const TCHAR Char : SearchString)
+		{
+			if (Char == '"')
+			{
+				bInsideQuotes = !bInsideQuotes;
+				if (!CurrentWord.IsEmpty())
+				{
+					Words.Add(CurrentWord);
+					CurrentWord.Empty();
+				}
+				continue;
+			}
+
+			if (bInsideQuotes)
+				continue;
+
+			if (Char == ' ' || Char == '\t')
+			{
+				if (!CurrentWord.IsEmpty())
+				{
+					Words.Add(CurrentWord);
+					CurrentWord.Empty();
+				}
+			}
+			else
+			{
+				CurrentWord.AppendChar(Char);
+			}
+		}
+
+		if (!CurrentWord.IsEmpty())
+			Words.Add(CurrentWord);
+
+		return Words;
+	}
+
+	/** Lowest distance wins, the earlier entry on a tie like the linear scans did */
+	void ConsiderCandidate(int32 Index, int32 Distance, int32& BestIndex, int32& BestDistance)
+	{
+		if (Distance < BestDistance || (Distance == BestDistance && Index < BestIndex))
+		{
+			BestIndex = Index;
+			BestDistance = Distance;
+		}
+	}
+}
+
+void FConvaiFuzzyIndex::Add(const FString& Key, int32 Value)
+{
+	const int32 NewIndex = Nodes.Num();
+	if (NewIndex > 0)
+	{
+		int32 Current = 0;
+		while (true)
+		{
+			const int32 Distance = UConvaiUtils::IndelDistance(Key, Nodes[Current].Key);
+			const TPair<int32, int32>* Child = Nodes[Current].Children.FindByPredicate([Distance](const TPair<int32, int32>& Entry) { return Entry.Key == Distance; });
+			if (!Child)
+			{
+				Nodes[Current].Children.Emplace(Distance, NewIndex);
+				break;
+			}
+			Current = Child->Value;
+		}
+	}
+
+	FNode& Node = Nodes.AddDefaulted_GetRef();
+	Node.Key = Key;
+	Node.Value = Value;
+}
+
+void FConvaiFuzzyIndex::Find(const FString& Query, int32 MaxDistance, TFunctionRef<void(int32 Value, int32 Distance)> Visitor) const
+{
+	if (Nodes.Num() == 0)
+		return;
+
+	TArray<int32, TInlineAllocator<32>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		const int32 Distance = UConvaiUtils::IndelDistance(Query, Node.Key);
+		if (Distance <= MaxDistance)
+			Visitor(Node.Value, Distance);
+
+		// Triangle inequality, anything under a child edge outside this band is further than MaxDistance
+		for (const TPair<int32, int32>& Child : Node.Children)
+		{
+			if (FMath::Abs(Child.Key - Distance) <= MaxDistance)
+				Stack.Add(Child.Value);
+		}
+	}
+}
+
+FConvaiActionMatcher::FConvaiActionMatcher(const UConvaiEnvironment& Environment)
+	: Version(Environment.GetVersion())
+{
+	Actions.Reserve(Environment.Actions.Num());
+	for (const FString& Action : Environment.Actions)
+	{
+		const int32 ActionIndex = Actions.Add(UConvaiActions::RemoveDesc(Action));
+		const FString& Name = Actions[ActionIndex];
+
+		FPhraseGroup& Group = FindOrAddGroup(ActionGroups, CountWords(Name));
+		Group.Index.Add(Name, ActionIndex);
+		if (!Group.ExactIndex.Contains(Name))
+			Group.ExactIndex.Add(Name, ActionIndex);
+	}
+
+	Characters.Build(Environment.Characters);
+	Objects.Build(Environment.Objects);
+}
+
+FString FConvaiActionMatcher::FindAction(const FString& ActionToBeParsed) const
+{
+	TArray<FString> Words;
+	ActionToBeParsed.ParseIntoArray(Words, TEXT(" "), true);
+
+	int32 BestIndex = INDEX_NONE;
+	int32 BestDistance = ActionMatchMaxDistance + 1;
+	for (const FPhraseGroup& Group : ActionGroups)
+	{
+		const FString Prefix = JoinWords(Words, 0, FMath::Min(Group.NumWords, Words.Num()));
+
+		if (const int32* Exact = Group.ExactIndex.Find(Prefix))
+			ConsiderCandidate(*Exact, 0, BestIndex, BestDistance);
+
+		Group.Index.Find(Prefix, ActionMatchMaxDistance, [&BestIndex, &BestDistance](int32 ActionIndex, int32 Distance)
+		{
+			ConsiderCandidate(ActionIndex, Distance, BestIndex, BestDistance);
+		});
+	}
+
+	return BestIndex == INDEX_NONE ? FString(TEXT("None")) : Actions[BestIndex];
+}
+
+bool FConvaiActionMatcher::FindCharacter(const FString& ActionToBeParsed, FConvaiObjectEntry& OutMatch) const
+{
+	return Characters.FindNearest(CollectWordsOutsideQuotes(ActionToBeParsed), OutMatch);
+}
+
+bool FConvaiActionMatcher::FindObject(const FString& ActionToBeParsed, FConvaiObjectEntry& OutMatch) const
+{
+	return Objects.FindNearest(CollectWordsOutsideQuotes(ActionToBeParsed), OutMatch);
+}
+
+void FConvaiActionMatcher::FNamedEntries::Build(const TArray<FConvaiObjectEntry>& InEntries)
+{
+	Entries = InEntries;
+	for (int32 i = 0; i < Entries.Num(); i++)
+	{
+		const FString& Name = Entries[i].Name;
+		const int32 NumWords = CountWords(Name);
+
+		// Nothing to look for in a blank name
+		if (NumWords == 0)
+			continue;
+
+		FPhraseGroup& Group = FindOrAddGroup(Groups, NumWords);
+		Group.Index.Add(Name, i);
+		if (!Group.ExactIndex.Contains(Name))
+			Group.ExactIndex.Add(Name, i);
+	}
+}
+
+bool FConvaiActionMatcher::FNamedEntries::FindNearest(const TArray<FString>& Words, FConvaiObjectEntry& OutMatch) const
+{
+	int32 BestIndex = INDEX_NONE;
+	int32 BestDistance = MAX_int32;
+	for (const FPhraseGroup& Group : Groups)
+	{
+		// Every run of as many words as the names of the group
+		for (int32 First = 0; First <= Words.Num() - Group.NumWords; First++)
+		{
+			const FString Window = JoinWords(Words, First, Group.NumWords);
+
+			if (const int32* Exact = Group.ExactIndex.Find(Window))
+				ConsiderCandidate(*Exact, 0, BestIndex, BestDistance);
+
+			Group.Index.Find(Window, NameMatchMaxDistance, [this, &Window, &BestIndex, &BestDistance](int32 EntryIndex, int32 Distance)
+			{
+				const int32 NameLength = Entries[EntryIndex].Name.Len();
+				const int32 MaxDistance = FMath::Clamp(NameLength / 2, NameMatchMinDistance, NameMatchMaxDistance);
+				if (Distance > MaxDistance || FMath::Abs(Window.Len() - NameLength) >= MaxDistance)
+					return;
+
+				ConsiderCandidate(EntryIndex, Distance, BestIndex, BestDistance);
+			});
+		}
+	}
+
+	if (BestIndex == INDEX_NONE)
+		return false;
+
+	OutMatch = Entries[BestIndex];
+	return true;
+}
+
+FConvaiActionMatcher::FPhraseGroup& FConvaiActionMatcher::FindOrAddGroup(TArray<FPhraseGroup>& Groups, int32 NumWords)
+{
+	if (FPhraseGroup* Group = Groups.FindByPredicate([NumWords](const FPhraseGroup& Entry) { return Entry.NumWords == NumWords; }))
+		return *Group;
+
+	FPhraseGroup& Group = Groups.AddDefaulted_GetRef();
+	Group.NumWords = NumWords;
+	return Group;
+}
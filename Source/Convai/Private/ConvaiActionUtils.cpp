@@ -5,6 +5,7 @@
 #include "ConvaiUtils.h"
 #include "Internationalization/Regex.h"
 #include "ConvaiDefinitions.h"
+#include "ConvaiActionMatcher.h"
 
 DEFINE_LOG_CATEGORY(ConvaiActionUtilsLog);
 
@@ -92,103 +93,6 @@ namespace
 
 		return false; // Substring not found or is within quotes
 	}
-
-	bool FindClosePhraseOutsideQuotes(const FString& SearchString, const FString& PhraseToFind, int& OutBestDistance, int NumWordsToSkip = 0)
-	{
-		if (PhraseToFind.IsEmpty())
-		{
-			return false; // Can't find an empty phrase.
-		}
-
-		int32 MaxLevenshteinDistance = FMath::Clamp(PhraseToFind.Len() / 2, 2, 4);
-		TArray<FString> Words;
-		FString CurrentWord;
-		bool bInsideQuotes = false;
-		OutBestDistance = MaxLevenshteinDistance + 1; // Initialize with a value above the limit
-
-		// Collect words outside quotes
-		for (TCHAR Char : SearchString)
-		{
-			if (Char == '"')
-			{
-				bInsideQuotes = !bInsideQuotes;
-				if (!CurrentWord.IsEmpty())
-				{
-					Words.Add(CurrentWord);
-					CurrentWord.Empty();
-				}
-				continue;
-			}
-
-			if (!bInsideQuotes && (Char == ' ' || Char == '\t'))
-			{
-				if (!CurrentWord.IsEmpty())
-				{
-					Words.Add(CurrentWord);
-					CurrentWord.Empty();
-				}
-			}
-			else if (!bInsideQuotes)
-			{
-				CurrentWord.AppendChar(Char);
-			}
-		}
-
-		// Add the last word if there is one
-		if (!CurrentWord.IsEmpty())
-		{
-			Words.Add(CurrentWord);
-		}
-
-		// Number of words in the phrase to find
-		TArray<FString> PhraseWords;
-		PhraseToFind.ParseIntoArray(PhraseWords, TEXT(" "), true);
-		int32 NumWordsInPhrase = PhraseWords.Num();
-
-		// Sliding window of words to check for the phrase
-		for (int32 i = NumWordsToSkip; i <= Words.Num() - NumWordsInPhrase; ++i)
-		{
-			FString WindowString;
-			for (int32 j = 0; j < NumWordsInPhrase; ++j)
-			{
-				WindowString += (j > 0 ? TEXT(" ") : TEXT("")) + Words[i + j];
-			}
-
-			if (WindowString.Len() - PhraseToFind.Len() >= MaxLevenshteinDistance || PhraseToFind.Len() - WindowString.Len() >= MaxLevenshteinDistance)
-			{
-				continue;
-			}
-
-			int32 Distance = UConvaiUtils::LevenshteinDistance(WindowString, PhraseToFind);
-			if (Distance <= MaxLevenshteinDistance && Distance < OutBestDistance)
-			{
-				OutBestDistance = Distance;
-			}
-		}
-
-		// The function returns true if we found a match within the acceptable Levenshtein distance
-		return OutBestDistance <= MaxLevenshteinDistance;
-	}
-
-	static bool FindNearestObjectByName(FString SearchString, TArray<FConvaiObjectEntry> Objects, FConvaiObjectEntry& ObjectMatch)
-	{
-		bool Found = false;
-		int BestDistance = 100;
-		for (auto o : Objects)
-		{
-			int Distance = 0;
-			if (FindClosePhraseOutsideQuotes(SearchString, o.Name, Distance))
-			{
-				if (Distance < BestDistance)
-				{
-					ObjectMatch = o;
-					BestDistance = Distance;
-					Found = true;
-				}
-			}
-		}
-		return Found;
-	}
 };
 
 TArray<FString> UConvaiActions::SmartSplit(const FString& SequenceString)
@@ -299,14 +203,17 @@ bool UConvaiActions::ParseAction(UConvaiEnvironment* Environment, FString Action
 	FConvaiObjectEntry RelatedObjOrChar;
 	ConvaiResultAction.ActionString = ActionToBeParsed;
 
+	// Built once per environment version and shared, so parsing does not rescan the environment
+	const TSharedRef<const FConvaiActionMatcher, ESPMode::ThreadSafe> Matcher = Environment->GetActionMatcher();
+
 	// find actions
-	ActionToAdd = FindAction(ActionToBeParsed, Environment->Actions);
+	ActionToAdd = Matcher->FindAction(ActionToBeParsed);
 
 	// find characters
-	FindNearestObjectByName(ActionToBeParsed, Environment->Characters, RelatedObjOrChar);
+	Matcher->FindCharacter(ActionToBeParsed, RelatedObjOrChar);
 	
 	// find objects
-	FindNearestObjectByName(ActionToBeParsed, Environment->Objects, RelatedObjOrChar);
+	Matcher->FindObject(ActionToBeParsed, RelatedObjOrChar);
 
 	// Find extra numeric param
 	float ExtraNumber = ExtractNumber(ActionToBeParsed);
@@ -6,13 +6,21 @@
 
 DEFINE_LOG_CATEGORY(ConvaiAudioLog);
 
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mic Capture Overflows"), STAT_ConvaiMicCaptureOverflows, STATGROUP_Convai);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mic Capture Dropped Samples"), STAT_ConvaiMicCaptureDroppedSamples, STATGROUP_Convai);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mic Device Overflows"), STAT_ConvaiMicDeviceOverflows, STATGROUP_Convai);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mic Capture Underruns"), STAT_ConvaiMicCaptureUnderruns, STATGROUP_Convai);
+
 
 namespace Audio
 {
 	FConvaiAudioCaptureSynth::FConvaiAudioCaptureSynth()
-		: NumSamplesEnqueued(0)
-		, bInitialized(false)
+		: bInitialized(false)
 		, bIsCapturing(false)
+		, NumOverflows(0)
+		, NumDroppedSamples(0)
+		, NumDeviceOverflows(0)
+		, NumUnderruns(0)
 	{
 	}
 
@@ -76,21 +84,12 @@ namespace Audio
 		{
 			FOnCaptureFunction OnCapture = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
 			{
-				int32 NumSamples = NumChannels * NumFrames;
-
-				FScopeLock Lock(&CaptureCriticalSection);
-
-				if (bIsCapturing)
-				{
-					// Append the audio memory to the capture data buffer
-					int32 Index = AudioCaptureData.AddUninitialized(NumSamples);
-					float* AudioCaptureDataPtr = AudioCaptureData.GetData();
-					FMemory::Memcpy(&AudioCaptureDataPtr[Index], AudioData, NumSamples * sizeof(float));
-				}
+				OnAudioCaptured(AudioData, NumFrames, NumChannels, bOverFlow);
 			};
 
-			// Prepare the audio buffer memory for 2 seconds of stereo audio at 48k SR to reduce chance for allocation in callbacks
-			AudioCaptureData.Reserve(2 * 2 * 48000);
+			// Allocate the ring once before the capture callback can run, nothing is allocated in the callbacks afterwards
+			if (AudioCaptureRing.Capacity() < ConvaiConstants::AudioCaptureRingBufferCapacity)
+				AudioCaptureRing.Init(ConvaiConstants::AudioCaptureRingBufferCapacity);
 
 			FAudioCaptureDeviceParams Params = FAudioCaptureDeviceParams();
 
@@ -114,21 +113,12 @@ namespace Audio
 		{
 			FOnCaptureFunction OnCapture = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
 			{
-				int32 NumSamples = NumChannels * NumFrames;
-
-				FScopeLock Lock(&CaptureCriticalSection);
-
-				if (bIsCapturing)
-				{
-					// Append the audio memory to the capture data buffer
-					int32 Index = AudioCaptureData.AddUninitialized(NumSamples);
-					float* AudioCaptureDataPtr = AudioCaptureData.GetData();
-					FMemory::Memcpy(&AudioCaptureDataPtr[Index], AudioData, NumSamples * sizeof(float));
-				}
+				OnAudioCaptured(AudioData, NumFrames, NumChannels, bOverFlow);
 			};
 
-			// Prepare the audio buffer memory for 2 seconds of stereo audio at 48k SR to reduce chance for allocation in callbacks
-			AudioCaptureData.Reserve(2 * 2 * 48000);
+			// Allocate the ring once before the capture callback can run, nothing is allocated in the callbacks afterwards
+			if (AudioCaptureRing.Capacity() < ConvaiConstants::AudioCaptureRingBufferCapacity)
+				AudioCaptureRing.Init(ConvaiConstants::AudioCaptureRingBufferCapacity);
 
 			FAudioCaptureDeviceParams Params = FAudioCaptureDeviceParams();
 			Params.DeviceIndex = DeviceIndex;
@@ -145,6 +135,23 @@ namespace Audio
 		return bSuccess;
 	}
 
+	void FConvaiAudioCaptureSynth::OnAudioCaptured(const float* AudioData, int32 NumFrames, int32 NumChannels, bool bOverFlow)
+	{
+		if (!bIsCapturing.load(std::memory_order_acquire))
+			return;
+
+		if (bOverFlow)
+			NumDeviceOverflows.fetch_add(1, std::memory_order_relaxed);
+
+		const uint32 NumSamples = NumChannels * NumFrames;
+		const uint32 NumWritten = AudioCaptureRing.Enqueue(AudioData, NumSamples);
+		if (NumWritten < NumSamples)
+		{
+			NumOverflows.fetch_add(1, std::memory_order_relaxed);
+			NumDroppedSamples.fetch_add(NumSamples - NumWritten, std::memory_order_relaxed);
+		}
+	}
+
 	void FConvaiAudioCaptureSynth::CloseStream()
 	{
 		if (AudioCapture.IsStreamOpen())
@@ -155,13 +162,12 @@ namespace Audio
 
 	bool FConvaiAudioCaptureSynth::StartCapturing()
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
-
-		AudioCaptureData.Reset();
+		// Called from the consumer side, discards whatever was left from the previous capture
+		AudioCaptureRing.Reset();
 
 		check(AudioCapture.IsStreamOpen());
 
-		bIsCapturing = true;
+		bIsCapturing.store(true, std::memory_order_release);
 		return true;
 	}
 
@@ -169,8 +175,7 @@ namespace Audio
 	{
 		check(AudioCapture.IsStreamOpen());
 		check(AudioCapture.IsCapturing());
-		FScopeLock Lock(&CaptureCriticalSection);
-		bIsCapturing = false;
+		bIsCapturing.store(false, std::memory_order_release);
 	}
 
 	void FConvaiAudioCaptureSynth::AbortCapturing()
@@ -186,13 +191,12 @@ namespace Audio
 
 	bool FConvaiAudioCaptureSynth::IsCapturing() const
 	{
-		return bIsCapturing;
+		return bIsCapturing.load(std::memory_order_acquire);
 	}
 
 	int32 FConvaiAudioCaptureSynth::GetNumSamplesEnqueued()
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
-		return AudioCaptureData.Num();
+		return AudioCaptureRing.Num();
 	}
 
 	FAudioCapture* FConvaiAudioCaptureSynth::GetAudioCapture()
@@ -200,23 +204,26 @@ namespace Audio
 		return &AudioCapture;
 	}
 
-	bool FConvaiAudioCaptureSynth::GetAudioData(TArray<float>& OutAudioData)
+	FConvaiAudioCaptureStats FConvaiAudioCaptureSynth::GetCaptureStats() const
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
+		FConvaiAudioCaptureStats Stats;
+		Stats.Overflows = NumOverflows.load(std::memory_order_relaxed);
+		Stats.DroppedSamples = NumDroppedSamples.load(std::memory_order_relaxed);
+		Stats.DeviceOverflows = NumDeviceOverflows.load(std::memory_order_relaxed);
+		Stats.Underruns = NumUnderruns.load(std::memory_order_relaxed);
+		return Stats;
+	}
 
-		int32 CaptureDataSamples = AudioCaptureData.Num();
-		if (CaptureDataSamples > 0)
-		{
-			// Append the capture audio to the output buffer
-			int32 OutIndex = OutAudioData.AddUninitialized(CaptureDataSamples);
-			float* OutDataPtr = OutAudioData.GetData();
-			FMemory::Memcpy(&OutDataPtr[OutIndex], AudioCaptureData.GetData(), CaptureDataSamples * sizeof(float));
+	void FConvaiAudioCaptureSynth::ReportUnderrun()
+	{
+		NumUnderruns.fetch_add(1, std::memory_order_relaxed);
+	}
 
-			// Reset the capture data buffer since we copied the audio out
-			AudioCaptureData.Reset();
-			return true;
-		}
-		return false;
+	int32 FConvaiAudioCaptureSynth::ReadAudioData(float* OutAudio, int32 NumSamples)
+	{
+		if (NumSamples <= 0)
+			return 0;
+		return AudioCaptureRing.Dequeue(OutAudio, NumSamples);
 	}
 };
 
@@ -226,11 +233,9 @@ UConvaiAudioCaptureComponent::UConvaiAudioCaptureComponent(const FObjectInitiali
 	bSuccessfullyInitialized = false;
 	bIsCapturing = false;
 	CapturedAudioDataSamples = 0;
-	ReadSampleIndex = 0;
 	bIsDestroying = false;
 	bIsNotReadyForForFinishDestroy = false;
 	bIsStreamOpen = false;
-	CaptureAudioData.Reserve(2 * 48000 * 5);
 	SelectedDeviceIndex = -1;
 }
 
@@ -357,11 +362,14 @@ Audio::FConvaiAudioCaptureSynth* UConvaiAudioCaptureComponent::GetCaptureSynth()
 	return &CaptureSynth;
 }
 
+Audio::FConvaiAudioCaptureStats UConvaiAudioCaptureComponent::GetCaptureStats() const
+{
+	return CaptureSynth.GetCaptureStats();
+}
+
 void UConvaiAudioCaptureComponent::OnBeginGenerate()
 {
 	CapturedAudioDataSamples = 0;
-	ReadSampleIndex = 0;
-	CaptureAudioData.Reset();
 
 	if (!bIsStreamOpen)
 	{
@@ -376,7 +384,6 @@ void UConvaiAudioCaptureComponent::OnBeginGenerate()
 		// Don't allow this component to be destroyed until the stream is closed again
 		bIsNotReadyForForFinishDestroy = true;
 		FramesSinceStarting = 0;
-		ReadSampleIndex = 0;
 	}
 
 }
@@ -406,38 +413,11 @@ int32 UConvaiAudioCaptureComponent::OnGenerateAudio(float* OutAudio, int32 NumSa
 
 	if (CapturedAudioDataSamples > 0 || CaptureSynth.GetNumSamplesEnqueued() > 1024)
 	{
-		// Check if we need to read more audio data from capture synth
-		if (ReadSampleIndex + NumSamples > CaptureAudioData.Num())
+		// Read straight from the capture ring into the output buffer
+		OutputSamplesGenerated = CaptureSynth.ReadAudioData(OutAudio, NumSamples);
+		if (OutputSamplesGenerated < NumSamples)
 		{
-			// but before we do, copy off the remainder of the capture audio data buffer if there's data in it
-			int32 SamplesLeft = FMath::Max(0, CaptureAudioData.Num() - ReadSampleIndex);
-			if (SamplesLeft > 0)
-			{
-				float* CaptureDataPtr = CaptureAudioData.GetData();
-				FMemory::Memcpy(OutAudio, &CaptureDataPtr[ReadSampleIndex], SamplesLeft * sizeof(float));
-
-				// Track samples generated
-				OutputSamplesGenerated += SamplesLeft;
-			}
-
-			// Get another block of audio from the capture synth
-			CaptureAudioData.Reset();
-			CaptureSynth.GetAudioData(CaptureAudioData);
-
-			// Reset the read sample index since we got a new buffer of audio data
-			ReadSampleIndex = 0;
-		}
-
-		// note it's possible we didn't get any more audio in our last attempt to get it
-		if (CaptureAudioData.Num() > 0)
-		{
-			// Compute samples to copy
-			int32 NumSamplesToCopy = FMath::Min(NumSamples - OutputSamplesGenerated, CaptureAudioData.Num() - ReadSampleIndex);
-
-			float* CaptureDataPtr = CaptureAudioData.GetData();
-			FMemory::Memcpy(&OutAudio[OutputSamplesGenerated], &CaptureDataPtr[ReadSampleIndex], NumSamplesToCopy * sizeof(float));
-			ReadSampleIndex += NumSamplesToCopy;
-			OutputSamplesGenerated += NumSamplesToCopy;
+			CaptureSynth.ReportUnderrun();
 		}
 
 		CapturedAudioDataSamples += OutputSamplesGenerated;
@@ -448,6 +428,13 @@ int32 UConvaiAudioCaptureComponent::OnGenerateAudio(float* OutAudio, int32 NumSa
 		OutputSamplesGenerated = NumSamples;
 	}
 
+#if STATS
+	const Audio::FConvaiAudioCaptureStats Stats = CaptureSynth.GetCaptureStats();
+	SET_DWORD_STAT(STAT_ConvaiMicCaptureOverflows, Stats.Overflows);
+	SET_DWORD_STAT(STAT_ConvaiMicCaptureDroppedSamples, Stats.DroppedSamples);
+	SET_DWORD_STAT(STAT_ConvaiMicDeviceOverflows, Stats.DeviceOverflows);
+	SET_DWORD_STAT(STAT_ConvaiMicCaptureUnderruns, Stats.Underruns);
+#endif
+
 	return OutputSamplesGenerated;
 }
-
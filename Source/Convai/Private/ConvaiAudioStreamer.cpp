@@ -8,6 +8,13 @@
 #include "LipSyncInterface.h"
 #include "Math/UnrealMathUtility.h"
 #include "ConvaiUtils.h"
+#include "ConvaiSoundWaveProcedural.h"
+#include "ConvaiEchoCanceller.h"
+#include "../Convai.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "ConvaiPlayerComponent.h"
+#include "ConvaiSubsystem.h"
 
 // THIRD_PARTY_INCLUDES_START
 #include "opus.h"
@@ -38,49 +45,401 @@
 
 DEFINE_LOG_CATEGORY(ConvaiAudioStreamerLog);
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Face Data Bytes Sent"), STAT_ConvaiFaceDataBytesSent, STATGROUP_Convai);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Face Data Uncompressed Bytes"), STAT_ConvaiFaceDataUncompressedBytes, STATGROUP_Convai);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Face Data Talking Characters"), STAT_ConvaiFaceDataTalkingCharacters, STATGROUP_Convai);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Face Data Bytes/s"), STAT_ConvaiFaceDataBandwidth, STATGROUP_Convai);
+
+namespace
+{
+	/** Seconds between encoder retunes, matches the period of the connection stats */
+	constexpr float EncoderParamsUpdateInterval = 1.0f;
+
+	/** Share of the connection speed a single character voice may use */
+	constexpr float VoiceBandwidthShare = 0.25f;
+
+	/** Smoothing of the measured packet loss */
+	constexpr float PacketLossSmoothing = 0.3f;
+
+	/** Packet loss in percent above which in-band FEC is turned on */
+	constexpr float FECPacketLossThreshold = 1.0f;
+
+	/** Seconds between refreshes of the list of remote listeners */
+	constexpr float VoiceListenersRefreshInterval = 1.0f;
+
+	/** Extra range on top of the attenuation distance so listeners walking in hear the start of the next packet */
+	constexpr float VoiceRelevancyMargin = 1.1f;
+
+	/** Distance in cm at which a voice is heard at its source level, the priority drops by 6 dB per doubling beyond it */
+	constexpr float VoicePriorityReferenceDistance = 100.0f;
+
+	/** Priority bonus in dB for the character talking with the local player, larger than any distance or level difference */
+	constexpr float VoicePriorityConversationBonus = 200.0f;
+
+	/** Priority bonus in dB for voices already audible so two similar voices do not keep swapping */
+	constexpr float VoicePriorityHysteresis = 3.0f;
+
+	/** Smoothing of the measured voice level per received chunk */
+	constexpr float VoiceLoudnessSmoothing = 0.3f;
+
+	constexpr float SilenceLevel = -90.0f;
+
+	/** Seconds the replicated face data bandwidth is averaged over */
+	constexpr float FaceDataBandwidthWindow = 1.0f;
+
+	/** Timeline mismatch in seconds a received face packet may have before it counts as late or as following a lost one */
+	constexpr float FaceDataTimeTolerance = 0.02f;
+}
+
 UConvaiAudioStreamer::UConvaiAudioStreamer(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
 	PrimaryComponentTick.bCanEverTick = true;
 	bAutoActivate = true;
+	EchoReference = MakeShared<FConvaiEchoReference, ESPMode::ThreadSafe>();
+	EncoderParamsUpdateTimer = 0;
+	SmoothedPacketLoss = 0;
+	EncoderSequence = 0;
+	bSendingVoiceStream = false;
+	LastSentVoiceSequence = 0;
+	VoiceStreamIdleTime = 0;
+	DecoderLastFramesPerPacket = 1;
+	VoiceListenersRefreshTime = -1;
+	bVoiceCulled = false;
+	VoiceLoudness = SilenceLevel;
+	SkippedVoiceRemaining = 0;
+	VoiceTimeElapsedOffset = 0;
+	LastSkippedPacketDuration = 0;
+	bResetDecoderOnResume = false;
+	FaceStreamId = 0;
+	bSendingFaceStream = false;
+	FaceStreamTime = 0;
+	FaceStreamIdleTime = 0;
+	FaceStreamBytes = 0;
+	FaceStreamUncompressedBytes = 0;
+	FaceDataBandwidth = 0;
+	ReceivedFaceStreamId = 0;
+	bReceivingFaceStream = false;
+	ReceivedFaceStreamTime = 0;
+	VoiceReorderBuffer.Init(ConvaiConstants::VoiceReorderWindow, ConvaiConstants::VoiceReorderTimeout / 1000.0f);
+}
+
+void UConvaiAudioStreamer::BroadcastVoiceDataToClients_Implementation(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence)
+{
+	FConvaiEncodedVoicePacket Packet;
+	Packet.EncodedData = EncodedVoiceData;
+	Packet.SampleRate = SampleRate;
+	Packet.NumChannels = NumChannels;
+	Packet.SizeBeforeEncode = SizeBeforeEncode;
+	Packet.Sequence = Sequence;
+
+	VoiceReorderBuffer.AddPacket(MoveTemp(Packet), FPlatformTime::Seconds(), ReleasedVoicePackets);
+	DecodeVoicePackets(ReleasedVoicePackets);
 }
 
-void UConvaiAudioStreamer::BroadcastVoiceDataToClients_Implementation(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode)
+void UConvaiAudioStreamer::BroadcastVoiceStreamMarker_Implementation(bool bStart, uint16 Sequence)
 {
-	// Check that decoder is valid and able to decode the input sample rate and channels
-	if (!Decoder || SampleRate != DecoderSampleRate || NumChannels != DecoderNumChannels)
+	if (bStart)
 	{
-		DestroyOpusDecoder();
-		InitDecoder(SampleRate, NumChannels);
-		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Initialized Decoder with SampleRate:%d and Channels:%d"), DecoderSampleRate, DecoderNumChannels);
+		VoiceReorderBuffer.StartStream(Sequence, ReleasedVoicePackets);
+		DecodeVoicePackets(ReleasedVoicePackets);
+	}
+	else
+	{
+		VoiceReorderBuffer.EndStream(Sequence, FPlatformTime::Seconds());
 	}
+}
 
+void UConvaiAudioStreamer::BroadcastFaceData_Implementation(TArray<uint8> const& Packet)
+{
+	// The server played the frames as they arrived
+	if (UKismetSystemLibrary::IsServer(this))
+		return;
+
+	FConvaiFaceFrameCodec::FPacketInfo Info;
+	DecodedFaceSequences.Reset();
+	if (!FConvaiFaceFrameCodec::Decode(Packet, Info, DecodedFaceSequences) || DecodedFaceSequences.Num() == 0 || DecodedFaceSequences[0].AnimationFrames.Num() == 0)
+	{
+		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("BroadcastFaceData: Dropped a malformed face data packet of %d bytes"), Packet.Num());
+		return;
+	}
+
+	if (!bReceivingFaceStream || Info.StreamId != ReceivedFaceStreamId)
+	{
+		bReceivingFaceStream = true;
+		ReceivedFaceStreamId = Info.StreamId;
+		ReceivedFaceStreamTime = 0;
+		LastReceivedFaceFrame = FAnimationFrame();
+		LastReceivedFaceFrame.BlendShapes.Reset(DecodedFaceSequences[0].AnimationFrames[0].BlendShapes.GetCurveSet());
+	}
+
+	// A late packet arrives after its place in the timeline was taken
+	const float Gap = Info.StartTime - ReceivedFaceStreamTime;
+	if (Gap < -FaceDataTimeTolerance)
+		return;
+
+	// Hold the last frame over lost packets so the following frames stay in step with the voice
+	if (Gap > FaceDataTimeTolerance)
+	{
+		FAnimationSequence HoldSequence;
+		HoldSequence.Duration = Gap;
+		HoldSequence.AnimationFrames.Add(LastReceivedFaceFrame);
+		PlayLipSyncWithPreGeneratedData(HoldSequence);
+	}
+
+	ReceivedFaceStreamTime = Info.StartTime;
+	for (const FAnimationSequence& Sequence : DecodedFaceSequences)
+	{
+		if (Sequence.AnimationFrames.Num() == 0)
+			continue;
 
-	// Make sure we have a big enough buffer for decoding
-	if (ReceivedEncodedAudioDataBuffer.GetAllocatedSize() < SizeBeforeEncode * 20) {
-		ReceivedEncodedAudioDataBuffer.Reserve(SizeBeforeEncode * 20);
+		PlayLipSyncWithPreGeneratedData(Sequence);
+		ReceivedFaceStreamTime += Sequence.Duration;
+		LastReceivedFaceFrame = Sequence.AnimationFrames.Last();
 	}
+}
 
-	// Decode the Audio data
-	uint32 outsize = ReceivedEncodedAudioDataBuffer.GetAllocatedSize();
-	//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Allocated buffer size for decoding: %d bytes"), outsize);
+void UConvaiAudioStreamer::ReplicateFaceData(float DeltaTime)
+{
+	// Nobody to send to
+	if (GetNetMode() == NM_Standalone)
+	{
+		PendingFaceSequences.Empty();
+		return;
+	}
 
-	Decode(EncodedVoiceData.GetData(), EncodedVoiceData.Num(), ReceivedEncodedAudioDataBuffer.GetData(), outsize);
+	int32 BytesSent = 0;
+	int32 UncompressedBytes = 0;
+	FAnimationSequence Sequence;
+	while (PendingFaceSequences.Dequeue(Sequence))
+	{
+		if (Sequence.AnimationFrames.Num() == 0)
+			continue;
+
+		if (!bSendingFaceStream)
+		{
+			bSendingFaceStream = true;
+			FaceStreamId++;
+			FaceStreamTime = 0;
+			FaceStreamBytes = 0;
+			FaceStreamUncompressedBytes = 0;
+		}
+
+		// A packet holds a single layout and stays around the size of a bunch
+		const EConvaiFaceCurveSet CurveSet = Sequence.AnimationFrames[0].BlendShapes.GetCurveSet();
+		if (!FaceDataWriter.IsEmpty() && (FaceDataWriter.GetCurveSet() != CurveSet || FaceDataWriter.Num() >= ConvaiConstants::FaceDataMaxPacketSize))
+			BytesSent += SendFaceDataPacket();
+
+		if (FaceDataWriter.IsEmpty())
+			FaceDataWriter.Begin(CurveSet, FaceStreamId, FaceStreamTime);
+
+		FaceDataWriter.AddSequence(Sequence);
+		FaceStreamTime += Sequence.Duration;
+		FaceStreamIdleTime = 0;
+		UncompressedBytes += FConvaiFaceFrameCodec::GetUncompressedSize(Sequence);
+	}
+
+	if (!FaceDataWriter.IsEmpty())
+		BytesSent += SendFaceDataPacket();
+
+	FaceStreamBytes += BytesSent;
+	FaceStreamUncompressedBytes += UncompressedBytes;
+	if (DeltaTime > 0)
+		FaceDataBandwidth += (BytesSent / DeltaTime - FaceDataBandwidth) * FMath::Min(DeltaTime / FaceDataBandwidthWindow, 1.0f);
+
+	if (!bSendingFaceStream)
+		return;
+
+	INC_DWORD_STAT_BY(STAT_ConvaiFaceDataBytesSent, BytesSent);
+	INC_DWORD_STAT_BY(STAT_ConvaiFaceDataUncompressedBytes, UncompressedBytes);
+	INC_DWORD_STAT(STAT_ConvaiFaceDataTalkingCharacters);
+	INC_FLOAT_STAT_BY(STAT_ConvaiFaceDataBandwidth, FaceDataBandwidth);
+
+	FaceStreamIdleTime += DeltaTime;
+	if (FaceStreamIdleTime * 1000.0f >= ConvaiConstants::VoiceStreamIdleTimeout)
+	{
+		bSendingFaceStream = false;
+		UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("Face stream of %s: %d bytes for %.2f s of frames (%.0f B/s), %.0f%% of the uncompressed size"),
+			*GetNameSafe(GetOwner()), FaceStreamBytes, FaceStreamTime, FaceStreamTime > 0 ? FaceStreamBytes / FaceStreamTime : 0.0f,
+			FaceStreamUncompressedBytes > 0 ? 100.0f * FaceStreamBytes / FaceStreamUncompressedBytes : 0.0f);
+	}
+}
+
+int32 UConvaiAudioStreamer::SendFaceDataPacket()
+{
+	const int32 PacketSize = FaceDataWriter.Num();
+	BroadcastFaceData(FaceDataWriter.Packet);
+	FaceDataWriter.Reset();
+	return PacketSize;
+}
+
+void UConvaiAudioStreamer::ProcessVoiceStreamMarker_Implementation(bool bStart, uint16 Sequence)
+{
+	BroadcastVoiceStreamMarker(bStart, Sequence);
+}
+
+void UConvaiAudioStreamer::DecodeVoicePackets(TArray<FConvaiReceivedVoicePacket>& Packets)
+{
+	if (Packets.Num() == 0)
+		return;
 
 	// Do not play incomming audio on the client instance, if this component is owned by the client and "ShouldMuteLocal() == true", which means that we mute the audio locally
 	// Do not play if we want to mute on all clients "ShouldMuteGlobal() == true"
-	if (!(ShouldMuteLocal() && GetOwner()->HasLocalNetOwner()) && !ShouldMuteGlobal())
+	const bool bPlay = !(ShouldMuteLocal() && GetOwner()->HasLocalNetOwner()) && !ShouldMuteGlobal();
+
+	// Run this on server only
+	const bool bServer = UKismetSystemLibrary::IsServer(this);
+
+	// Culled voices keep their place in the stream without being decoded
+	if (bPlay && bVoiceCulled)
 	{
-		PlayVoiceData(ReceivedEncodedAudioDataBuffer.GetData(), outsize, false, SampleRate, NumChannels);
+		for (const FConvaiReceivedVoicePacket& Received : Packets)
+		{
+			const FConvaiEncodedVoicePacket& Packet = Received.Packet;
+			const uint32 BytesPerSecond = Packet.SampleRate * Packet.NumChannels * sizeof(int16);
+			if (!Received.bLost && BytesPerSecond > 0)
+				LastSkippedPacketDuration = float(Packet.SizeBeforeEncode) / BytesPerSecond;
+			SkipVoiceData(LastSkippedPacketDuration);
+		}
+
+		if (!bServer)
+		{
+			Packets.Reset();
+			bResetDecoderOnResume = true;
+			return;
+		}
 	}
 
-	// Run this on server only
-	if (UKismetSystemLibrary::IsServer(this))
+	// Nobody needs the PCM, skip the decode entirely
+	if (!bPlay && !bServer)
+	{
+		Packets.Reset();
+		return;
+	}
+
+	for (FConvaiReceivedVoicePacket& Received : Packets)
+	{
+		Received.bPlay = bPlay && !bVoiceCulled;
+		Received.bServer = bServer;
+		Received.bResetDecoder = bResetDecoderOnResume;
+		bResetDecoderOnResume = false;
+		ReceivedVoicePackets.Enqueue(MoveTemp(Received));
+	}
+	Packets.Reset();
+
+	FGraphEventArray Prerequisites;
+	if (DecodeTask.IsValid() && !DecodeTask->IsComplete())
 	{
-		OnServerAudioReceived(ReceivedEncodedAudioDataBuffer.GetData(), outsize, false, SampleRate, NumChannels);
+		Prerequisites.Add(DecodeTask);
 	}
 
-	//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Decoder Received %d bytes and Outputted %d bytes"), EncodedVoiceData.Num(), outsize);
+	DecodeTask = FFunctionGraphTask::CreateAndDispatchWhenReady([this]()
+	{
+		DecodePendingVoiceData();
+	}, TStatId(), &Prerequisites, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void UConvaiAudioStreamer::DecodePendingVoiceData()
+{
+	FConvaiReceivedVoicePacket Received;
+	while (ReceivedVoicePackets.Dequeue(Received))
+	{
+		const FConvaiEncodedVoicePacket& Packet = Received.Packet;
+
+		// The decoder state predates the packets skipped while culled
+		if (Received.bResetDecoder && Decoder)
+		{
+			opus_decoder_ctl(Decoder, OPUS_RESET_STATE);
+		}
+
+		if (Received.bLost)
+		{
+			// Nothing to conceal before the first packet of a format was decoded
+			if (!Decoder)
+				continue;
+
+			const int32 BytesPerFrame = DecoderFrameSize * DecoderNumChannels * sizeof(opus_int16);
+			if (ReceivedEncodedAudioDataBuffer.Num() < ConvaiConstants::VoiceMaxFramesPerPacket * BytesPerFrame)
+			{
+				ReceivedEncodedAudioDataBuffer.SetNumUninitialized(ConvaiConstants::VoiceMaxFramesPerPacket * BytesPerFrame);
+			}
+
+			uint32 outsize = ReceivedEncodedAudioDataBuffer.Num();
+			DecodeLost(Received.FECData.GetData(), Received.FECData.Num(), ReceivedEncodedAudioDataBuffer.GetData(), outsize);
+
+			if (outsize > 0)
+			{
+				FConvaiDecodedVoiceChunk Chunk;
+				Chunk.PCMData = TArray<uint8>(ReceivedEncodedAudioDataBuffer.GetData(), outsize);
+				Chunk.SampleRate = DecoderSampleRate;
+				Chunk.NumChannels = DecoderNumChannels;
+				Chunk.bPlay = Received.bPlay;
+				Chunk.bServer = Received.bServer;
+				DecodedVoiceChunks.Enqueue(MoveTemp(Chunk));
+			}
+			continue;
+		}
+
+		// Check that decoder is valid and able to decode the input sample rate and channels
+		if (!Decoder || Packet.SampleRate != DecoderSampleRate || Packet.NumChannels != DecoderNumChannels)
+		{
+			DestroyOpusDecoder();
+			InitDecoder(Packet.SampleRate, Packet.NumChannels);
+			UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Initialized Decoder with SampleRate:%d and Channels:%d"), DecoderSampleRate, DecoderNumChannels);
+		}
+
+		if (!Decoder)
+			continue;
+
+		// Make sure we have a big enough buffer for decoding, grows rarely and is reused across packets
+		if (ReceivedEncodedAudioDataBuffer.Num() < (int32)Packet.SizeBeforeEncode * 20)
+		{
+			ReceivedEncodedAudioDataBuffer.SetNumUninitialized(Packet.SizeBeforeEncode * 20);
+		}
+
+		// Decode the Audio data
+		uint32 outsize = ReceivedEncodedAudioDataBuffer.Num();
+		Decode(Packet.EncodedData.GetData(), Packet.EncodedData.Num(), ReceivedEncodedAudioDataBuffer.GetData(), outsize);
+
+		if (outsize > 0)
+		{
+			FConvaiDecodedVoiceChunk Chunk;
+			Chunk.PCMData = TArray<uint8>(ReceivedEncodedAudioDataBuffer.GetData(), outsize);
+			Chunk.SampleRate = Packet.SampleRate;
+			Chunk.NumChannels = Packet.NumChannels;
+			Chunk.bPlay = Received.bPlay;
+			Chunk.bServer = Received.bServer;
+			DecodedVoiceChunks.Enqueue(MoveTemp(Chunk));
+		}
+
+		//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Decoder Received %d bytes and Outputted %d bytes"), Packet.EncodedData.Num(), outsize);
+	}
+}
+
+void UConvaiAudioStreamer::WaitForDecodeTask()
+{
+	if (DecodeTask.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(DecodeTask);
+		DecodeTask = nullptr;
+	}
+}
+
+void UConvaiAudioStreamer::PlayDecodedVoiceData()
+{
+	FConvaiDecodedVoiceChunk Chunk;
+	while (DecodedVoiceChunks.Dequeue(Chunk))
+	{
+		if (Chunk.bPlay)
+		{
+			PlayVoiceData(Chunk.PCMData.GetData(), Chunk.PCMData.Num(), false, Chunk.SampleRate, Chunk.NumChannels);
+		}
+
+		if (Chunk.bServer)
+		{
+			OnServerAudioReceived(Chunk.PCMData.GetData(), Chunk.PCMData.Num(), false, Chunk.SampleRate, Chunk.NumChannels);
+		}
+	}
 }
 
 //void UConvaiAudioStreamer::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
@@ -90,9 +449,102 @@ void UConvaiAudioStreamer::BroadcastVoiceDataToClients_Implementation(TArray<uin
 //	DOREPLIFETIME(UConvaiAudioStreamer, ReplicateVoiceToNetwork);
 //}
 
-void UConvaiAudioStreamer::ProcessEncodedVoiceData_Implementation(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode)
+void UConvaiAudioStreamer::ProcessEncodedVoiceData_Implementation(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence)
+{
+	ReplicateVoicePacket(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+}
+
+void UConvaiAudioStreamer::ClientReceiveRelayedVoiceData_Implementation(UConvaiAudioStreamer* Source, TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence)
+{
+	// The source may not be resolvable yet if its actor just became relevant
+	if (IsValid(Source))
+	{
+		Source->BroadcastVoiceDataToClients_Implementation(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+	}
+}
+
+void UConvaiAudioStreamer::ReplicateVoicePacket(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence)
+{
+	const UNetDriver* NetDriver = GetOwner() ? GetOwner()->GetNetDriver() : nullptr;
+	const float AudibleDistance = GetVoiceAudibleDistance();
+
+	if (!Convai::Get().GetConvaiSettings()->EnableVoiceRelevancyCulling || !NetDriver || AudibleDistance <= 0 || !IsValid(GetWorld()))
+	{
+		BroadcastVoiceDataToClients(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+		return;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (VoiceListenersRefreshTime < 0 || Now - VoiceListenersRefreshTime >= VoiceListenersRefreshInterval)
+	{
+		VoiceListenersRefreshTime = Now;
+		VoiceListeners.Reset();
+
+		TArray<UConvaiPlayerComponent*> PlayerComponents;
+		UConvaiUtils::ConvaiGetAllPlayerComponents(this, PlayerComponents);
+		for (UConvaiPlayerComponent* PlayerComponent : PlayerComponents)
+		{
+			if (PlayerComponent->GetOwner() && PlayerComponent->GetOwner()->GetNetConnection())
+				VoiceListeners.Add(PlayerComponent);
+		}
+	}
+
+	// Every remote connection needs a player component to relay through, otherwise fall back to the multicast
+	TSet<UNetConnection*> ServedConnections;
+	for (const TWeakObjectPtr<UConvaiPlayerComponent>& Listener : VoiceListeners)
+	{
+		if (Listener.IsValid())
+			ServedConnections.Add(Listener->GetOwner()->GetNetConnection());
+	}
+	for (UNetConnection* ClientConnection : NetDriver->ClientConnections)
+	{
+		if (ClientConnection && !ServedConnections.Contains(ClientConnection))
+		{
+			BroadcastVoiceDataToClients(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+			return;
+		}
+	}
+
+	// Listeners on this machine, and on a dedicated server the consumers of the decoded voice, where PlayVoiceData renders nothing
+	if (GetNetMode() != NM_DedicatedServer || UsesServerAudio())
+	{
+		BroadcastVoiceDataToClients_Implementation(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+	}
+
+	const FVector SourceLocation = GetComponentLocation();
+	const float MaxDistanceSquared = FMath::Square(AudibleDistance * VoiceRelevancyMargin);
+	ServedConnections.Reset();
+
+	for (const TWeakObjectPtr<UConvaiPlayerComponent>& Listener : VoiceListeners)
+	{
+		if (!Listener.IsValid())
+			continue;
+
+		UNetConnection* ListenerConnection = Listener->GetOwner()->GetNetConnection();
+		if (!ListenerConnection || ServedConnections.Contains(ListenerConnection))
+			continue;
+
+		FVector ListenerLocation = Listener->GetOwner()->GetActorLocation();
+		if (ListenerConnection->PlayerController)
+		{
+			FRotator ListenerRotation;
+			ListenerConnection->PlayerController->GetPlayerViewPoint(ListenerLocation, ListenerRotation);
+		}
+
+		if (FVector::DistSquared(SourceLocation, ListenerLocation) <= MaxDistanceSquared)
+		{
+			ServedConnections.Add(ListenerConnection);
+			Listener->ClientReceiveRelayedVoiceData(this, EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode, Sequence);
+		}
+	}
+}
+
+float UConvaiAudioStreamer::GetVoiceAudibleDistance() const
 {
-	BroadcastVoiceDataToClients(EncodedVoiceData, SampleRate, NumChannels, SizeBeforeEncode);
+	const FSoundAttenuationSettings* Attenuation = GetAttenuationSettingsToApply();
+	if (!Attenuation || !Attenuation->bAttenuate)
+		return 0;
+	return Attenuation->GetMaxDimension() + Attenuation->FalloffDistance;
 }
 
 bool UConvaiAudioStreamer::ShouldMuteLocal()
@@ -142,44 +594,45 @@ void UConvaiAudioStreamer::PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize,
 		return;
 	}
 
-	// TODO (Mohamed): take number of channels in consideration when calculating the duration
-	// Duration = PCM Data Size / (Sample Rate * Bytes per sample)
-	float NewAudioDuration = float(PCM_DataSize) / float(SampleRate * 2);
-
-	float CurrentRemainingAudioDuration = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
-	if (CurrentRemainingAudioDuration < 0)
-		CurrentRemainingAudioDuration = 0; // Can never be less than zero
-
-	// New Duration = Remaining Duration + New Duration
-	float TotalAudioDuration = CurrentRemainingAudioDuration + NewAudioDuration;
-
-	GetWorld()->GetTimerManager().SetTimer(AudioFinishedTimerHandle, this, &UConvaiAudioStreamer::onAudioFinished, TotalAudioDuration, false);
 	if (!IsTalking)
 	{
 		onAudioStarted();
 
 		IsTalking = true;
+		VoiceTimeElapsedOffset = 0;
+		SkippedVoiceRemaining = 0;
+
+		// Admitted or culled before the first chunk is heard rather than on the next tick
+		UpdateVoiceBudget(0);
+	}
+
+	if (ContainsHeaderData)
+	{
+		// Play only the PCM data which start after 44 bytes
+		VoiceData += 44;
+		VoiceDataSize -= 44;
+	}
+
+	UpdateVoiceLoudness(VoiceData, VoiceDataSize);
+
+	// Played by no sound wave, the end of speech then comes from the game clock instead of the render thread
+	if (bVoiceCulled || !CanRenderVoice())
+	{
+		const uint32 BytesPerSecond = SampleRate * FMath::Max<uint32>(NumChannels, 1) * sizeof(int16);
+		SkipVoiceData(BytesPerSecond > 0 ? float(VoiceDataSize) / BytesPerSecond : 0);
+		return;
 	}
 
 	// TODO (Mohamed) : Needs further testing, especially when sample rate or NumChannels changes
 	// Check that SoundWaveProcedural is valid and able to play input sample rate and channels
 	if (!IsValid(SoundWaveProcedural) || SoundWaveProcedural->GetSampleRateForCurrentPlatform() != SampleRate || SoundWaveProcedural->NumChannels != NumChannels)
 	{
-		if (IsValid(SoundWaveProcedural)) // Destroy SoundWaveProcedural if it is valid
-			SoundWaveProcedural->ConditionalBeginDestroy();
-
-		SoundWaveProcedural = NewObject<USoundWaveProcedural>();
-		SoundWaveProcedural->SetSampleRate(SampleRate);
-		SoundWaveProcedural->NumChannels = NumChannels;
-		SoundWaveProcedural->Duration = INDEFINITELY_LOOPING_DURATION;
-		SoundWaveProcedural->SoundGroup = SOUNDGROUP_Voice;
-		SoundWaveProcedural->bLooping = false;
-		SoundWaveProcedural->bProcedural = true;
-		SoundWaveProcedural->Pitch = 1.0f;
-		SoundWaveProcedural->Volume = 1.0f;
-		SoundWaveProcedural->AttenuationSettings = nullptr;
-		SoundWaveProcedural->bDebug = true;
-		SoundWaveProcedural->VirtualizationMode = EVirtualizationMode::PlayWhenSilent;
+		ReleaseVoiceWave();
+
+		// Waves are pooled per format so starting to speak does not create UObjects or grow buffers
+		UConvaiSubsystem* ConvaiSubsystem = UConvaiUtils::GetConvaiSubsystem(this);
+		SoundWaveProcedural = ConvaiSubsystem ? ConvaiSubsystem->AcquireVoiceWave(SampleRate, NumChannels) : UConvaiSubsystem::CreateVoiceWave(this, SampleRate, NumChannels);
+		SoundWaveProcedural->EchoReference = EchoReference;
 
 		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("New SampleRate: %d"), SampleRate);
 		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("New Channels: %d"), NumChannels);
@@ -188,14 +641,8 @@ void UConvaiAudioStreamer::PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize,
 		Play();
 	}
 
-	if (ContainsHeaderData)
-	{
-		// Play only the PCM data which start after 44 bytes
-		VoiceData += 44;
-		VoiceDataSize -= 44;
-	}
-
-	SoundWaveProcedural->QueueAudio(VoiceData, VoiceDataSize);
+	// The end of speech is detected from what the audio render thread actually consumed, see UpdatePlaybackState()
+	SoundWaveProcedural->QueueVoice(VoiceData, VoiceDataSize);
 
 	// Does the lipsync component require the blendshapes/Visemes to be sent to it
 	if (ConvaiLipSyncExtended && ConvaiLipSyncExtended->RequiresPreGeneratedFaceData())
@@ -217,25 +664,33 @@ void UConvaiAudioStreamer::StopVoice()
 {
 	if (!IsTalking)
 		return;
-	SoundWaveProcedural->ResetAudio();
+	ReleaseVoiceWave();
 	//ResetVoiceFade();
 	StopLipSync();
 	onAudioFinished();
-	ClearAudioFinishedTimer();
 }
 
-void UConvaiAudioStreamer::StopVoiceWithFade(float InVoiceFadeOutDuration)
+void UConvaiAudioStreamer::ReleaseVoiceWave()
 {
-	if (!IsTalking)
+	if (!IsValid(SoundWaveProcedural))
 		return;
 
-	if (!IsValid(GetWorld()))
-	{
-		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceData: GetWorld() is Invalid!"));
+	Stop();
+	SetSound(nullptr);
+	VoiceTimeElapsedOffset += SoundWaveProcedural->GetPlayedDuration();
+	SoundWaveProcedural->ResetVoice();
+
+	if (UConvaiSubsystem* ConvaiSubsystem = UConvaiUtils::GetConvaiSubsystem(this))
+		ConvaiSubsystem->ReleaseVoiceWave(SoundWaveProcedural);
+	SoundWaveProcedural = nullptr;
+}
+
+void UConvaiAudioStreamer::StopVoiceWithFade(float InVoiceFadeOutDuration)
+{
+	if (!IsTalking)
 		return;
-	}
 
-	float CurrentRemainingAudioDuration = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
+	float CurrentRemainingAudioDuration = GetVoiceTimeRemaining();
 	TotalVoiceFadeOutTime = FMath::Min(InVoiceFadeOutDuration, CurrentRemainingAudioDuration);
 	RemainingVoiceFadeOutTime = TotalVoiceFadeOutTime;
 
@@ -253,7 +708,7 @@ void UConvaiAudioStreamer::ResetVoiceFade()
 
 void UConvaiAudioStreamer::UpdateVoiceFade(float DeltaTime)
 {
-	if (!IsVoiceCurrentlyFading() || !IsValid(SoundWaveProcedural))
+	if (!IsVoiceCurrentlyFading())
 		return;
 	RemainingVoiceFadeOutTime -= DeltaTime;
 	if (RemainingVoiceFadeOutTime <= 0)
@@ -262,7 +717,8 @@ void UConvaiAudioStreamer::UpdateVoiceFade(float DeltaTime)
 		return;
 	}
 	float AudioVolume = RemainingVoiceFadeOutTime / TotalVoiceFadeOutTime;
-	SoundWaveProcedural->Volume = AudioVolume;
+	if (IsValid(SoundWaveProcedural))
+		SoundWaveProcedural->Volume = AudioVolume;
 }
 
 bool UConvaiAudioStreamer::IsVoiceCurrentlyFading()
@@ -270,14 +726,149 @@ bool UConvaiAudioStreamer::IsVoiceCurrentlyFading()
 	return (TotalVoiceFadeOutTime > 0 && IsTalking);
 }
 
-void UConvaiAudioStreamer::ClearAudioFinishedTimer()
+float UConvaiAudioStreamer::GetVoiceTimeElapsed() const
 {
-	if (!IsValid(GetWorld()))
+	if (!IsTalking)
+		return 0;
+	return VoiceTimeElapsedOffset + (IsValid(SoundWaveProcedural) ? SoundWaveProcedural->GetPlayedDuration() : 0);
+}
+
+float UConvaiAudioStreamer::GetVoiceTimeRemaining() const
+{
+	if (!IsTalking)
+		return 0;
+	return IsValid(SoundWaveProcedural) ? SoundWaveProcedural->GetRemainingDuration() : FMath::Max(SkippedVoiceRemaining, 0.0f);
+}
+
+float UConvaiAudioStreamer::GetVoicePriority() const
+{
+	float Priority = VoiceLoudness;
+
+	// Heard by the nearest local listener, every split-screen player and the listen server host have one
+	float NearestDistance = MAX_flt;
+	if (const UWorld* World = GetWorld())
+	{
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const APlayerController* PlayerController = It->Get();
+			if (!PlayerController || !PlayerController->IsLocalController())
+				continue;
+
+			FVector ListenerLocation, ListenerFront, ListenerRight;
+			PlayerController->GetAudioListenerPosition(ListenerLocation, ListenerFront, ListenerRight);
+			NearestDistance = FMath::Min(NearestDistance, FVector::Dist(ListenerLocation, GetComponentLocation()));
+		}
+	}
+
+	if (NearestDistance < MAX_flt)
+	{
+		const float Distance = FMath::Max(NearestDistance, VoicePriorityReferenceDistance);
+		Priority -= 20.0f * FMath::LogX(10.0f, Distance / VoicePriorityReferenceDistance);
+	}
+
+	if (IsInConversationWithLocalPlayer())
+		Priority += VoicePriorityConversationBonus;
+
+	if (!bVoiceCulled)
+		Priority += VoicePriorityHysteresis;
+
+	return Priority;
+}
+
+void UConvaiAudioStreamer::UpdateVoiceBudget(float DeltaTime)
+{
+	// Where nothing is rendered there is no budget to share, the speech runs on the game clock anyway
+	bool bAudible = true;
+	if ((IsTalking || VoiceReorderBuffer.IsActive()) && CanRenderVoice())
+	{
+		if (UConvaiSubsystem* ConvaiSubsystem = UConvaiUtils::GetConvaiSubsystem(this))
+			bAudible = ConvaiSubsystem->RequestAudibleVoice(this, GetVoicePriority());
+	}
+
+	if (bAudible == bVoiceCulled)
 	{
-		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("ClearAudioFinishedTimer: GetWorld() is Invalid!"));
+		bVoiceCulled = !bAudible;
+		UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("%s voice of %s"), bVoiceCulled ? TEXT("Culled") : TEXT("Resumed"), *GetNameSafe(GetOwner()));
+
+		if (bVoiceCulled && IsValid(SoundWaveProcedural))
+		{
+			// Carry on from where the sound wave was, its queued audio is skipped
+			SkippedVoiceRemaining = SoundWaveProcedural->GetRemainingDuration();
+			ReleaseVoiceWave();
+			StopLipSync();
+		}
+		// On resume the next received chunk starts a new sound wave at the current position of the speech
+	}
+
+	// Played by no sound wave, the speech timing runs on the game clock
+	if (IsTalking && !IsValid(SoundWaveProcedural))
+	{
+		VoiceTimeElapsedOffset += FMath::Clamp(SkippedVoiceRemaining, 0.0f, DeltaTime);
+		SkippedVoiceRemaining -= DeltaTime;
+	}
+}
+
+void UConvaiAudioStreamer::SkipVoiceData(float Duration)
+{
+	if (!IsTalking)
+	{
+		onAudioStarted();
+		IsTalking = true;
+		VoiceTimeElapsedOffset = 0;
+		SkippedVoiceRemaining = 0;
+	}
+
+	SkippedVoiceRemaining = FMath::Max(SkippedVoiceRemaining, 0.0f) + Duration;
+}
+
+void UConvaiAudioStreamer::UpdateVoiceLoudness(const uint8* PCMData, uint32 NumBytes)
+{
+	const int16* Samples = (const int16*)PCMData;
+	const int32 NumSamples = NumBytes / sizeof(int16);
+	if (NumSamples <= 0)
+		return;
+
+	double SumSquares = 0;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		SumSquares += (double)Samples[i] * Samples[i];
+	}
+
+	const float Rms = FMath::Sqrt(float(SumSquares / NumSamples)) / 32768.0f;
+	const float Level = Rms > 0 ? FMath::Max(20.0f * FMath::LogX(10.0f, Rms), SilenceLevel) : SilenceLevel;
+	VoiceLoudness += (Level - VoiceLoudness) * VoiceLoudnessSmoothing;
+}
+
+bool UConvaiAudioStreamer::CanRenderVoice() const
+{
+	return GetNetMode() != NM_DedicatedServer && GetAudioDevice() != nullptr;
+}
+
+void UConvaiAudioStreamer::UpdatePlaybackState()
+{
+	if (!IsTalking)
 		return;
+
+	// The wave is no longer rendered, e.g. the component was stopped or lost its audio device, carry on like a culled voice
+	if (IsValid(SoundWaveProcedural) && !IsPlaying())
+	{
+		SkippedVoiceRemaining = SoundWaveProcedural->GetRemainingDuration();
+		ReleaseVoiceWave();
+	}
+
+	// Without a sound wave the skipped speech is held for as long as the jitter buffer would wait for more
+	const bool bFinished = IsValid(SoundWaveProcedural)
+		? SoundWaveProcedural->IsPlaybackFinished()
+		: SkippedVoiceRemaining <= -ConvaiConstants::VoiceJitterBufferMinDepth / 1000.0f;
+
+	if (bFinished)
+	{
+		UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("Finished talking, jitter buffer underruns: %d, target depth: %f s"),
+			IsValid(SoundWaveProcedural) ? SoundWaveProcedural->GetNumUnderruns() : 0,
+			IsValid(SoundWaveProcedural) ? SoundWaveProcedural->GetTargetDepth() : 0.0f);
+		ReleaseVoiceWave();
+		onAudioFinished();
 	}
-	GetWorld()->GetTimerManager().ClearTimer(AudioFinishedTimerHandle);
 }
 
 // Not used
@@ -324,6 +915,8 @@ bool UConvaiAudioStreamer::SetLipSyncComponent(UActorComponent* LipSyncComponent
 		ConvaiLipSync = Cast<IConvaiLipSyncInterface>(LipSyncComponent);
 		ConvaiLipSyncExtended = Cast<IConvaiLipSyncExtendedInterface>(LipSyncComponent);
 		ConvaiLipSync->OnVisemesDataReady.BindUObject(this, &UConvaiAudioStreamer::OnVisemesReadyCallback);
+		if (ConvaiLipSyncExtended)
+			ConvaiLipSyncExtended->ConvaiSetVoiceSource(this);
 		return true;
 	}
 	else
@@ -358,35 +951,199 @@ void UConvaiAudioStreamer::TickComponent(float DeltaTime, ELevelTick TickType, F
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	UpdateVoiceBudget(DeltaTime);
+
 	UpdateVoiceFade(DeltaTime);
 
+	UpdatePlaybackState();
+
+	PlayDecodedVoiceData();
+
+	// Conceal packets that did not arrive in time
+	VoiceReorderBuffer.Update(FPlatformTime::Seconds(), ReleasedVoicePackets);
+	DecodeVoicePackets(ReleasedVoicePackets);
+
+	// Replicate the packets finished by the encode task
+	VoiceStreamIdleTime += DeltaTime;
+	FConvaiEncodedVoicePacket EncodedPacket;
+	while (EncodedVoicePackets.Dequeue(EncodedPacket))
+	{
+		// Only the stream boundaries go through the reliable channel
+		if (!bSendingVoiceStream)
+		{
+			ProcessVoiceStreamMarker(true, EncodedPacket.Sequence);
+			bSendingVoiceStream = true;
+		}
+
+		ProcessEncodedVoiceData(EncodedPacket.EncodedData, EncodedPacket.SampleRate, EncodedPacket.NumChannels, EncodedPacket.SizeBeforeEncode, EncodedPacket.Sequence);
+		LastSentVoiceSequence = EncodedPacket.Sequence;
+		VoiceStreamIdleTime = 0;
+	}
+
+	if (bSendingVoiceStream && VoiceStreamIdleTime * 1000.0f >= ConvaiConstants::VoiceStreamIdleTimeout && (!EncodeTask.IsValid() || EncodeTask->IsComplete()))
+	{
+		ProcessVoiceStreamMarker(false, LastSentVoiceSequence);
+		bSendingVoiceStream = false;
+	}
+
+	if (Encoder)
+	{
+		UpdateEncoderParams(DeltaTime);
+	}
+
+	if (ReplicateVoiceToNetwork)
+	{
+		ReplicateFaceData(DeltaTime);
+	}
+
 	int32 BytesPerFrame = EncoderFrameSize * EncoderNumChannels * sizeof(opus_int16);
-	if (AudioDataBuffer.Num() >= BytesPerFrame && Encoder)
+	if (Encoder && BytesPerFrame > 0 && (int32)AudioDataBuffer.Num() >= BytesPerFrame && (!EncodeTask.IsValid() || EncodeTask->IsComplete()))
+	{
+		EncodeTask = FFunctionGraphTask::CreateAndDispatchWhenReady([this, Params = TargetEncoderParams]()
+		{
+			ApplyEncoderParams(Params);
+			EncodePendingVoiceData();
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+}
+
+void UConvaiAudioStreamer::EncodePendingVoiceData()
+{
+	const uint32 BytesPerFrame = EncoderFrameSize * EncoderNumChannels * sizeof(opus_int16);
+	// Small packets keep each unreliable RPC within a single bunch and bound what a single loss costs
+	const uint32 MaxBytesPerPacket = FMath::Min<uint32>(ConvaiConstants::VoiceMaxFramesPerPacket * BytesPerFrame, EncodeInputBuffer.Num());
+
+	while (true)
 	{
-		// Buffer to hold encoded data
-		uint8* CurrentEncodedAudioDataPtr = (uint8*)malloc(AudioDataBuffer.Num());
-		uint32 CurrentEncodedAudioDataSize = AudioDataBuffer.Num();
+		// Only whole frames are encoded, the remainder waits for more data
+		const uint32 NumBytesToEncode = FMath::Min(AudioDataBuffer.Num(), MaxBytesPerPacket) / BytesPerFrame * BytesPerFrame;
+		if (NumBytesToEncode == 0)
+			break;
+
+		AudioDataBuffer.Dequeue(EncodeInputBuffer.GetData(), NumBytesToEncode);
 
 		// Encode the Audio data
-		uint32 remainder = Encode(AudioDataBuffer.GetData(), AudioDataBuffer.Num(), CurrentEncodedAudioDataPtr, CurrentEncodedAudioDataSize);
+		uint32 CurrentEncodedAudioDataSize = EncodeOutputBuffer.Num();
+		Encode(EncodeInputBuffer.GetData(), NumBytesToEncode, EncodeOutputBuffer.GetData(), CurrentEncodedAudioDataSize);
+
+		if (CurrentEncodedAudioDataSize > 0)
+		{
+			FConvaiEncodedVoicePacket Packet;
+			Packet.EncodedData = TArray<uint8>(EncodeOutputBuffer.GetData(), CurrentEncodedAudioDataSize);
+			Packet.SampleRate = EncoderSampleRate;
+			Packet.NumChannels = EncoderNumChannels;
+			Packet.SizeBeforeEncode = NumBytesToEncode;
+			Packet.Sequence = EncoderSequence++;
+			EncodedVoicePackets.Enqueue(MoveTemp(Packet));
+		}
+
+		//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Encoder Received %d bytes and Outputted %d bytes"), NumBytesToEncode, CurrentEncodedAudioDataSize);
+	}
+}
+
+void UConvaiAudioStreamer::UpdateEncoderParams(float DeltaTime)
+{
+	EncoderParamsUpdateTimer -= DeltaTime;
+	if (EncoderParamsUpdateTimer > 0)
+		return;
+	EncoderParamsUpdateTimer = EncoderParamsUpdateInterval;
+
+	const UConvaiSettings* Settings = Convai::Get().GetConvaiSettings();
+	const int32 MinBitrate = Settings->VoiceReplicationMinBitrate;
+	const int32 MaxBitrate = FMath::Max(Settings->VoiceReplicationMaxBitrate, MinBitrate);
+
+	int32 Bitrate = MaxBitrate;
+	if (const UNetConnection* Connection = GetVoiceNetConnection())
+	{
+		const int32 TotalPackets = Connection->OutPackets + Connection->OutPacketsLost;
+		const float PacketLoss = TotalPackets > 0 ? 100.0f * Connection->OutPacketsLost / TotalPackets : 0.0f;
+		SmoothedPacketLoss += (PacketLoss - SmoothedPacketLoss) * PacketLossSmoothing;
+
+		// Stay inside our share of the link and leave the lost fraction as headroom for FEC and retransmissions of other traffic
+		const float BandwidthBudget = Connection->CurrentNetSpeed * 8.0f * VoiceBandwidthShare;
+		Bitrate = FMath::Clamp(FMath::RoundToInt(BandwidthBudget * (1.0f - SmoothedPacketLoss / 100.0f)), MinBitrate, MaxBitrate);
+	}
+	else
+	{
+		SmoothedPacketLoss = 0;
+	}
+
+	FConvaiVoiceEncoderParams Params;
+	Params.Bitrate = Bitrate;
+	Params.bUseFEC = SmoothedPacketLoss >= FECPacketLossThreshold;
+	Params.PacketLossPercentage = Params.bUseFEC ? FMath::Clamp(FMath::CeilToInt(SmoothedPacketLoss), 0, 100) : 0;
+
+	if (Params != TargetEncoderParams)
+	{
+		UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("Voice encoder retuned: Bitrate:%d FEC:%d PacketLoss:%d%%"), Params.Bitrate, Params.bUseFEC, Params.PacketLossPercentage);
+		TargetEncoderParams = Params;
+	}
+}
+
+void UConvaiAudioStreamer::ApplyEncoderParams(const FConvaiVoiceEncoderParams& Params)
+{
+	if (!Encoder || Params == AppliedEncoderParams)
+		return;
+
+	int32 ErrCode = opus_encoder_ctl(Encoder, OPUS_SET_BITRATE(Params.Bitrate > 0 ? Params.Bitrate : OPUS_AUTO));
+	OPUS_CHECK_CTL(ConvaiAudioStreamerLog, OPUS_SET_BITRATE);
+
+	ErrCode = opus_encoder_ctl(Encoder, OPUS_SET_INBAND_FEC(Params.bUseFEC ? 1 : 0));
+	OPUS_CHECK_CTL(ConvaiAudioStreamerLog, OPUS_SET_INBAND_FEC);
+
+	ErrCode = opus_encoder_ctl(Encoder, OPUS_SET_PACKET_LOSS_PERC(Params.PacketLossPercentage));
+	OPUS_CHECK_CTL(ConvaiAudioStreamerLog, OPUS_SET_PACKET_LOSS_PERC);
+
+	AppliedEncoderParams = Params;
+}
 
-		// Remove encoded data
-		uint32 SizeOfDataBeforeEncoding = AudioDataBuffer.Num() - remainder;
-		AudioDataBuffer.RemoveAt(0, SizeOfDataBeforeEncoding);
+UNetConnection* UConvaiAudioStreamer::GetVoiceNetConnection() const
+{
+	const AActor* Owner = GetOwner();
+	if (!Owner)
+		return nullptr;
+
+	if (UNetConnection* OwnerConnection = Owner->GetNetConnection())
+		return OwnerConnection;
+
+	const UNetDriver* NetDriver = Owner->GetNetDriver();
+	if (!NetDriver)
+		return nullptr;
 
-		// Send the encoded data over the network
-		ProcessEncodedVoiceData(TArray<uint8>(CurrentEncodedAudioDataPtr, CurrentEncodedAudioDataSize), EncoderSampleRate, EncoderNumChannels, SizeOfDataBeforeEncoding);
-		
-		// Free the Encoded data buffer
-		free(CurrentEncodedAudioDataPtr);
+	if (NetDriver->ServerConnection)
+		return NetDriver->ServerConnection;
+
+	// The voice is multicast to every client, tune it for the most lossy one
+	UNetConnection* WorstConnection = nullptr;
+	float WorstLoss = -1;
+	for (UNetConnection* ClientConnection : NetDriver->ClientConnections)
+	{
+		if (!ClientConnection)
+			continue;
+		const int32 TotalPackets = ClientConnection->OutPackets + ClientConnection->OutPacketsLost;
+		const float Loss = TotalPackets > 0 ? float(ClientConnection->OutPacketsLost) / TotalPackets : 0.0f;
+		if (Loss > WorstLoss || (Loss == WorstLoss && WorstConnection && ClientConnection->CurrentNetSpeed < WorstConnection->CurrentNetSpeed))
+		{
+			WorstLoss = Loss;
+			WorstConnection = ClientConnection;
+		}
+	}
+	return WorstConnection;
+}
 
-		//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Encoder Received %d bytes and Outputted %d bytes"), SizeOfDataBeforeEncoding, CurrentEncodedAudioDataSize);
-		//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Remaining %d bytes"), AudioDataBuffer.Num());
+void UConvaiAudioStreamer::WaitForEncodeTask()
+{
+	if (EncodeTask.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(EncodeTask);
+		EncodeTask = nullptr;
 	}
 }
 
 void UConvaiAudioStreamer::BeginDestroy()
 {
+	WaitForEncodeTask();
+	WaitForDecodeTask();
 	DestroyOpus();
 	Super::BeginDestroy();
 }
@@ -400,7 +1157,7 @@ void UConvaiAudioStreamer::DestroyOpus()
 
 void UConvaiAudioStreamer::PlayLipSyncWithPreGeneratedData(FAnimationSequence FaceSequence)
 {
-	if (ConvaiLipSync)
+	if (ConvaiLipSync && !bVoiceCulled)
 	{
 		if (ConvaiLipSyncExtended && ConvaiLipSyncExtended->RequiresPreGeneratedFaceData())
 		{
@@ -451,11 +1208,18 @@ const TArray<FString> UConvaiAudioStreamer::GetVisemeNames() const
 
 const TMap<FName, float> UConvaiAudioStreamer::ConvaiGetFaceBlendshapes() const
 {
-	if (ConvaiLipSyncExtended)
-	{
-		return ConvaiLipSyncExtended->ConvaiGetFaceBlendshapes();
-	}
-	return TMap<FName, float>();
+	return GetFaceBlendshapesMap();
+}
+
+const TMap<FName, float>& UConvaiAudioStreamer::GetFaceBlendshapesMap() const
+{
+	static const TMap<FName, float> EmptyBlendshapes;
+	return ConvaiLipSyncExtended ? ConvaiLipSyncExtended->ConvaiGetFaceBlendshapes() : EmptyBlendshapes;
+}
+
+const FConvaiFaceCurves* UConvaiAudioStreamer::GetFaceCurves() const
+{
+	return ConvaiLipSyncExtended ? ConvaiLipSyncExtended->ConvaiGetFaceCurves() : nullptr;
 }
 
 bool UConvaiAudioStreamer::GeneratesVisemesAsBlendshapes()
@@ -469,6 +1233,10 @@ bool UConvaiAudioStreamer::GeneratesVisemesAsBlendshapes()
 
 void UConvaiAudioStreamer::AddFaceDataToSend(FAnimationSequence FaceSequence)
 {
+	// Clients get the frames through the face data channel on the next tick
+	if (ReplicateVoiceToNetwork && FaceSequence.AnimationFrames.Num() > 0)
+		PendingFaceSequences.Enqueue(FaceSequence);
+
 	PlayLipSyncWithPreGeneratedData(FaceSequence);
 }
 
@@ -517,12 +1285,22 @@ void UConvaiAudioStreamer::AddPCMDataToSend(TArray<uint8> PCMDataToAdd,
 		// Check that encoder is valid and able to encode the input sample rate and channels
 		if (InSampleRate != EncoderSampleRate || InNumChannels != EncoderNumChannels)
 		{
+			WaitForEncodeTask();
+
+			// Allocated on first use so only streamers that replicate pay for it
+			if (AudioDataBuffer.Capacity() < ConvaiConstants::VoiceEncodeRingBufferCapacity)
+				AudioDataBuffer.Init(ConvaiConstants::VoiceEncodeRingBufferCapacity);
 			AudioDataBuffer.Reset();
 			DestroyOpusEncoder();
 			InitEncoder(InSampleRate, InNumChannels, EAudioEncodeHint::VoiceEncode_Voice);
 			UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Initialized Encoder with SampleRate:%d and Channels:%d"), EncoderSampleRate, EncoderNumChannels);
 		}
-		AudioDataBuffer.Append((uint8*)OutConverted.GetData(), OutConverted.Num()*2);
+		const uint32 NumBytes = OutConverted.Num() * 2;
+		const uint32 NumBytesQueued = AudioDataBuffer.Enqueue((uint8*)OutConverted.GetData(), NumBytes);
+		if (NumBytesQueued < NumBytes)
+		{
+			UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("AddPCMDataToSend: Encode buffer is full, dropped %d bytes"), NumBytes - NumBytesQueued);
+		}
 	}
 	else if (!ShouldMuteLocal())
 	{
@@ -572,6 +1350,14 @@ bool UConvaiAudioStreamer::InitEncoder(int32 InSampleRate, int32 InNumChannels,
 	EncoderFrameSize = EncoderSampleRate / NUM_OPUS_FRAMES_PER_SEC;
 	//MaxFrameSize = FrameSize * MAX_OPUS_FRAMES;
 
+	// Matches the settings below, the encode task retunes from there
+	AppliedEncoderParams = FConvaiVoiceEncoderParams();
+	EncoderParamsUpdateTimer = 0;
+
+	// Compressed output never exceeds the raw input of a packet
+	EncodeInputBuffer.SetNumUninitialized(MAX_OPUS_UNCOMPRESSED_BUFFER_SIZE);
+	EncodeOutputBuffer.SetNumUninitialized(MAX_OPUS_UNCOMPRESSED_BUFFER_SIZE);
+
 	int32 EncError = 0;
 
 	const int32 Application = (EncodeHint == EAudioEncodeHint::VoiceEncode_Audio) ? OPUS_APPLICATION_AUDIO : OPUS_APPLICATION_VOIP;
@@ -591,7 +1377,7 @@ bool UConvaiAudioStreamer::InitEncoder(int32 InSampleRate, int32 InNumChannels,
 		const int32 UseCVbr = 0;
 		opus_encoder_ctl(Encoder, OPUS_SET_VBR_CONSTRAINT(UseCVbr));
 
-		// Complexity (1-10)
+		// Complexity (1-10), kept at the cheapest setting, only the bitrate and FEC follow the connection
 		const int32 Complexity = 1;
 		opus_encoder_ctl(Encoder, OPUS_SET_COMPLEXITY(Complexity));
 
@@ -602,7 +1388,8 @@ bool UConvaiAudioStreamer::InitEncoder(int32 InSampleRate, int32 InNumChannels,
 	else
 	{
 		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("Failed to init Opus Encoder: %s"), ANSI_TO_TCHAR(opus_strerror(EncError)));
-		DestroyOpus();
+		// The decoder is owned by the decode task, only tear down the encoder
+		DestroyOpusEncoder();
 	}
 
 	return EncError == OPUS_OK;
@@ -734,7 +1521,8 @@ bool UConvaiAudioStreamer::InitDecoder(int32 InSampleRate, int32 InNumChannels)
 	else
 	{
 		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("Failed to init Opus Decoder: %s"), ANSI_TO_TCHAR(opus_strerror(DecError)));
-		DestroyOpus();
+		// The encoder is owned by the encode task, only tear down the decoder
+		DestroyOpusDecoder();
 	}
 
 	return DecError == OPUS_OK;
@@ -786,9 +1574,10 @@ void UConvaiAudioStreamer::Decode(const uint8* InCompressedData, uint32 Compress
 
 	//UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("NumFramesToDecode %d frames"), NumFramesToDecode);
 
+	// Lost packets are expected on the unreliable channel and concealed before we get here
 	if (PacketGeneration != DecoderLastGeneration + 1)
 	{
-		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("Packet generation skipped from %d to %d"), DecoderLastGeneration, PacketGeneration);
+		UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("Packet generation skipped from %d to %d"), DecoderLastGeneration, PacketGeneration);
 	}
 
 	if ((NumFramesToDecode > 0) && (NumFramesToDecode <= MaxFramesEncoded))
@@ -874,6 +1663,54 @@ void UConvaiAudioStreamer::Decode(const uint8* InCompressedData, uint32 Compress
 	UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("OpusDecode[%d]: RawSize: %d HeaderSize: %d CompressedSize: %d NumFramesDecoded: %d "), PacketGeneration, OutRawDataSize, HeaderSize, CompressedDataSize, NumFramesToDecode);
 
 	DecoderLastGeneration = PacketGeneration;
+	if (OutRawDataSize > 0)
+	{
+		DecoderLastFramesPerPacket = NumFramesToDecode;
+	}
+}
+
+void UConvaiAudioStreamer::DecodeLost(const uint8* NextCompressedData, uint32 NextCompressedDataSize, uint8* OutRawPCMData, uint32& OutRawDataSize)
+{
+	check(Decoder);
+
+	// The first frame of the following packet carries the in-band FEC of the last frame of the lost one
+	const uint8* FECFrame = nullptr;
+	int32 FECFrameSize = 0;
+	if (NextCompressedData && NextCompressedDataSize >= 2 * sizeof(uint8))
+	{
+		const int32 NumNextFrames = NextCompressedData[0];
+		const uint32 HeaderSize = 2 * sizeof(uint8) + NumNextFrames * sizeof(uint16);
+		const uint16* CompressedOffsets = (const uint16*)(NextCompressedData + 2 * sizeof(uint8));
+		if (NumNextFrames > 0 && HeaderSize <= NextCompressedDataSize && CompressedOffsets[0] > 0 && HeaderSize + CompressedOffsets[0] <= NextCompressedDataSize)
+		{
+			FECFrame = NextCompressedData + HeaderSize;
+			FECFrameSize = CompressedOffsets[0];
+		}
+	}
+
+	const int32 BytesPerFrame = DecoderFrameSize * DecoderNumChannels * sizeof(opus_int16);
+	const int32 NumFramesToConceal = FMath::Clamp(DecoderLastFramesPerPacket, 1, (int32)ConvaiConstants::VoiceMaxFramesPerPacket);
+	int32 DecompressedBufferOffset = 0;
+
+	for (int32 i = 0; i < NumFramesToConceal && DecompressedBufferOffset + BytesPerFrame <= (int32)OutRawDataSize; i++)
+	{
+		const bool bUseFEC = FECFrame && i == NumFramesToConceal - 1;
+		const int32 NumDecompressedSamples = opus_decode(Decoder,
+			bUseFEC ? FECFrame : nullptr, bUseFEC ? FECFrameSize : 0,
+			(opus_int16*)(OutRawPCMData + DecompressedBufferOffset), DecoderFrameSize, bUseFEC ? 1 : 0);
+
+		if (NumDecompressedSamples < 0)
+		{
+			const char* ErrorStr = opus_strerror(NumDecompressedSamples);
+			UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("Failed to conceal lost packet: [%d] %s"), NumDecompressedSamples, ANSI_TO_TCHAR(ErrorStr));
+			break;
+		}
+		DecompressedBufferOffset += NumDecompressedSamples * DecoderNumChannels * sizeof(opus_int16);
+	}
+
+	OutRawDataSize = DecompressedBufferOffset;
+
+	UE_LOG(ConvaiAudioStreamerLog, Verbose, TEXT("OpusConceal: Frames: %d FEC: %d RawSize: %d"), NumFramesToConceal, FECFrame != nullptr, OutRawDataSize);
 }
 
 void UConvaiAudioStreamer::DestroyOpusDecoder()
@@ -0,0 +1,130 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiBlendshapeRemap.h"
+
+FConvaiBlendshapeRemap::FConvaiBlendshapeRemap()
+	: CompiledCurveSet(EConvaiFaceCurveSet::None)
+	, CompiledHash(0)
+	, CompiledMapSize(0)
+	, bCompiled(false)
+{
+}
+
+bool FConvaiBlendshapeRemap::Update(EConvaiFaceCurveSet SourceCurveSet, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset)
+{
+	const uint32 Hash = HashMapping(BlendshapeMap, GlobalMultiplier, GlobalOffset);
+	if (bCompiled && CompiledCurveSet == SourceCurveSet && CompiledHash == Hash && CompiledMapSize == BlendshapeMap.Num())
+		return false;
+
+	Compile(SourceCurveSet, BlendshapeMap, GlobalMultiplier, GlobalOffset);
+	CompiledCurveSet = SourceCurveSet;
+	CompiledHash = Hash;
+	CompiledMapSize = BlendshapeMap.Num();
+	bCompiled = true;
+	return true;
+}
+
+void FConvaiBlendshapeRemap::Apply(const FConvaiFaceCurves& Source, TArray<float>& OutValues) const
+{
+	OutValues.SetNumUninitialized(TargetNames.Num());
+
+	// Compiled for another layout, the frame has none of its curves
+	const bool bSameLayout = Source.GetCurveSet() == CompiledCurveSet;
+	for (float& Value : OutValues)
+	{
+		Value = bSameLayout ? -MAX_FLT : 0.0f;
+	}
+	if (!bSameLayout)
+		return;
+
+	const float* SourceValues = Source.GetData();
+	float* TargetValues = OutValues.GetData();
+	for (const FEntry& Entry : Entries)
+	{
+		float Value = SourceValues[Entry.Source] * Entry.Scale + Entry.Bias;
+		Value = Value > Entry.ClampMax ? Entry.ClampMax : Value;
+		Value = Value < Entry.ClampMin ? Entry.ClampMin : Value;
+
+		float& Target = TargetValues[Entry.Target];
+		if (Entry.Op == EOp::Set || Value > Target)
+			Target = Value;
+	}
+}
+
+void FConvaiBlendshapeRemap::Compile(EConvaiFaceCurveSet SourceCurveSet, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset)
+{
+	Entries.Reset();
+	TargetNames.Reset();
+	TargetIndices.Reset();
+
+	// Source curves are visited in layout order, the order MapBlendshapes sees them in a frame map
+	const TArray<FName>& SourceNames = FConvaiFaceCurves::GetCurveNames(SourceCurveSet);
+	for (int32 SourceIndex = 0; SourceIndex < SourceNames.Num(); SourceIndex++)
+	{
+		const FName SourceName = SourceNames[SourceIndex];
+		const FConvaiBlendshapeParameters* Parameters = BlendshapeMap.Find(SourceName);
+		if (!Parameters)
+		{
+			Entries.Add({ SourceIndex, FindOrAddTarget(SourceName), 1.0f, 0.0f, -MAX_FLT, MAX_FLT, EOp::Set });
+			continue;
+		}
+
+		for (const FName TargetName : Parameters->TargetNames)
+		{
+			FEntry Entry;
+			Entry.Source = SourceIndex;
+			Entry.Target = FindOrAddTarget(TargetName);
+			if (Parameters->UseOverrideValue)
+			{
+				Entry.Scale = 0;
+				Entry.Bias = Parameters->OverrideValue;
+				Entry.ClampMin = -MAX_FLT;
+				Entry.ClampMax = MAX_FLT;
+				Entry.Op = EOp::Set;
+			}
+			else
+			{
+				// The global modifiers are folded into the entry
+				Entry.Scale = Parameters->IgnoreGlobalModifiers ? Parameters->Multiplyer : Parameters->Multiplyer * GlobalMultiplier;
+				Entry.Bias = Parameters->IgnoreGlobalModifiers ? Parameters->Offset : Parameters->Offset + GlobalOffset;
+				Entry.ClampMin = Parameters->ClampMinValue;
+				Entry.ClampMax = Parameters->ClampMaxValue;
+				Entry.Op = EOp::Max;
+			}
+			Entries.Add(Entry);
+		}
+	}
+}
+
+int32 FConvaiBlendshapeRemap::FindOrAddTarget(FName TargetName)
+{
+	if (const int32* Index = TargetIndices.Find(TargetName))
+		return *Index;
+
+	const int32 Index = TargetNames.Add(TargetName);
+	TargetIndices.Add(TargetName, Index);
+	return Index;
+}
+
+uint32 FConvaiBlendshapeRemap::HashMapping(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset)
+{
+	uint32 Hash = HashCombine(GetTypeHash(GlobalMultiplier), GetTypeHash(GlobalOffset));
+	for (const auto& Mapping : BlendshapeMap)
+	{
+		const FConvaiBlendshapeParameters& Parameters = Mapping.Value;
+		Hash = HashCombine(Hash, GetTypeHash(Mapping.Key));
+		for (const FName TargetName : Parameters.TargetNames)
+		{
+			Hash = HashCombine(Hash, GetTypeHash(TargetName));
+		}
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.TargetNames.Num()));
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.Multiplyer));
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.Offset));
+		Hash = HashCombine(Hash, GetTypeHash((uint32)Parameters.UseOverrideValue));
+		Hash = HashCombine(Hash, GetTypeHash((uint32)Parameters.IgnoreGlobalModifiers));
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.OverrideValue));
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.ClampMinValue));
+		Hash = HashCombine(Hash, GetTypeHash(Parameters.ClampMaxValue));
+	}
+	return Hash;
+}
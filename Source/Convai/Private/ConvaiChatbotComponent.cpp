@@ -23,6 +23,9 @@ UConvaiChatbotComponent::UConvaiChatbotComponent()
 	//SetIsReplicated(true);
 	InterruptVoiceFadeOutDuration = 1.0;
 	LastPlayerName = FString("Unknown");
+	TranscriptionSegment = 0;
+	ReplicatedEnvironmentVersion = 0;
+	AppliedEnvironmentVersion = 0;
 	//Environment = CreateDefaultSubobject<UConvaiEnvironment>(TEXT("Environment"));
 }
 
@@ -41,7 +44,8 @@ void UConvaiChatbotComponent::GetLifetimeReplicatedProps(TArray<FLifetimePropert
 	DOREPLIFETIME(UConvaiChatbotComponent, ActionsQueue);
 	DOREPLIFETIME(UConvaiChatbotComponent, EmotionState);
 	DOREPLIFETIME(UConvaiChatbotComponent, LockEmotionState);
-	DOREPLIFETIME(UConvaiChatbotComponent, ConvaiEnvironmentDetails);
+	DOREPLIFETIME(UConvaiChatbotComponent, ReplicatedEnvironment);
+	DOREPLIFETIME(UConvaiChatbotComponent, ReplicatedEnvironmentVersion);
 }
 
 bool UConvaiChatbotComponent::IsInConversation()
@@ -49,6 +53,11 @@ bool UConvaiChatbotComponent::IsInConversation()
 	return ((IsValid(ConvaiGRPCGetResponseProxy) && !ReceivedFinalData) || IsTalking);
 }
 
+bool UConvaiChatbotComponent::IsInConversationWithLocalPlayer() const
+{
+	return IsValid(CurrentConvaiPlayerComponent) && IsValid(CurrentConvaiPlayerComponent->GetOwner()) && CurrentConvaiPlayerComponent->GetOwner()->HasLocalNetOwner();
+}
+
 bool UConvaiChatbotComponent::IsProcessing()
 {
 	return (IsValid(ConvaiGRPCGetResponseProxy) && !ReceivedFinalData);
@@ -66,24 +75,12 @@ bool UConvaiChatbotComponent::GetIsTalking()
 
 float UConvaiChatbotComponent::GetTalkingTimeElapsed()
 {
-	float TimeElapsed = 0;
-	if (IsValid(GetWorld()))
-	{
-		TimeElapsed = GetWorld()->GetTimerManager().GetTimerElapsed(AudioFinishedTimerHandle);
-	}
-
-	return TimeElapsed;
+	return GetVoiceTimeElapsed();
 }
 
 float UConvaiChatbotComponent::GetTalkingTimeRemaining()
 {
-	float TimeRemaing = 0;
-	if (IsValid(GetWorld()))
-	{
-		TimeRemaing = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
-	}
-
-	return TimeRemaing;
+	return GetVoiceTimeRemaining();
 }
 
 void UConvaiChatbotComponent::ResetConversation()
@@ -474,7 +471,9 @@ void UConvaiChatbotComponent::Start_GRPC_Request(bool UseOverrideAPI_Key, FStrin
 	ReceivedFinalData = false;
 	if (ConvaiLipSyncExtended)
 	{
-		RequireFaceData = ConvaiLipSyncExtended->RequiresPreGeneratedFaceData();
+		// Replicated characters need face data for the clients whatever the server itself shows
+		const bool bFaceDataNeededLocally = ConvaiLipSyncExtended->ConvaiIsFaceDataNeeded() && !IsVoiceCulled();
+		RequireFaceData = ConvaiLipSyncExtended->RequiresPreGeneratedFaceData() && (bFaceDataNeededLocally || (ReplicateVoiceToNetwork && GetNetMode() != NM_Standalone));
 		GeneratesVisemesAsBlendshapes = ConvaiLipSyncExtended->GeneratesVisemesAsBlendshapes();
 	}
 	RequireFaceData = RequireFaceData && VoiceResponse;
@@ -559,52 +558,107 @@ void UConvaiChatbotComponent::onMicrophoneDataReceived()
 //	}
 //}
 
-void UConvaiChatbotComponent::Broadcast_OnTranscriptionReceived_Implementation(const FString& Transcription, bool IsTranscriptionReady, bool IsFinal)
+void UConvaiChatbotComponent::Broadcast_ChatbotUpdates_Implementation(const TArray<FConvaiChatbotUpdate>& Updates)
 {
 	// Execute if you are a client
-	if (!UKismetSystemLibrary::IsServer(this))
+	if (UKismetSystemLibrary::IsServer(this))
+		return;
+
+	for (const FConvaiChatbotUpdate& Update : Updates)
 	{
-		OnTranscriptionReceived(Transcription, IsTranscriptionReady, IsFinal);
+		ApplyChatbotUpdate(Update);
 	}
 }
 
-void UConvaiChatbotComponent::Broadcast_onResponseDataReceived_Implementation(const FString& ReceivedText, bool IsFinal)
+void UConvaiChatbotComponent::Broadcast_PartialTranscription_Implementation(const FString& Transcription, uint16 InTranscriptionSegment)
 {
-	if (!UKismetSystemLibrary::IsServer(this))
-	{
-		onResponseDataReceived(ReceivedText, TArray<uint8>(), 0, IsFinal);
-	}
+	if (UKismetSystemLibrary::IsServer(this))
+		return;
+
+	// Overtaken by the final transcription of its segment
+	if ((int16)(uint16)(InTranscriptionSegment - TranscriptionSegment) < 0)
+		return;
+
+	OnTranscriptionReceived(Transcription, false, false);
 }
 
-void UConvaiChatbotComponent::Broadcast_onSessionIDReceived_Implementation(const FString& ReceivedSessionID)
+void UConvaiChatbotComponent::QueueChatbotUpdate(FConvaiChatbotUpdate&& Update)
 {
-	if (!UKismetSystemLibrary::IsServer(this))
-	{
-		onSessionIDReceived(ReceivedSessionID);
-	}
+	PendingChatbotUpdates.Enqueue(MoveTemp(Update));
 }
 
-void UConvaiChatbotComponent::Broadcast_onActionSequenceReceived_Implementation(const TArray<FConvaiResultAction>& ReceivedSequenceOfActions)
+void UConvaiChatbotComponent::FlushChatbotUpdates()
 {
-	if (!UKismetSystemLibrary::IsServer(this))
+	ChatbotUpdatesToSend.Reset();
+	FConvaiChatbotUpdate Update;
+	while (PendingChatbotUpdates.Dequeue(Update))
+	{
+		if (Update.IsPartialTranscription() || Update.Type == EConvaiChatbotUpdateType::Emotion)
+		{
+			// Only the latest partial transcription and emotion state matter, drop a pending one that was not followed by anything else
+			if (ChatbotUpdatesToSend.Num() > 0 && ChatbotUpdatesToSend.Last().Type == Update.Type && ChatbotUpdatesToSend.Last().IsPartialTranscription() == Update.IsPartialTranscription())
+			{
+				ChatbotUpdatesToSend.Last() = MoveTemp(Update);
+				continue;
+			}
+		}
+		ChatbotUpdatesToSend.Add(MoveTemp(Update));
+	}
+
+	if (ChatbotUpdatesToSend.Num() == 0)
+		return;
+
+	// A partial transcription is stale once a later event was received, a trailing one goes through the unreliable channel
+	FString PartialTranscription;
+	bool HasPartialTranscription = false;
+	if (ChatbotUpdatesToSend.Last().IsPartialTranscription())
 	{
-		onActionSequenceReceived(ReceivedSequenceOfActions);
+		PartialTranscription = MoveTemp(ChatbotUpdatesToSend.Last().Text);
+		HasPartialTranscription = true;
+		ChatbotUpdatesToSend.Pop(false);
 	}
-}
+	ChatbotUpdatesToSend.RemoveAll([](const FConvaiChatbotUpdate& Pending) { return Pending.IsPartialTranscription(); });
 
-void UConvaiChatbotComponent::Broadcast_OnNarrativeSectionReceived_Implementation(const FString& BT_Code, const FString& BT_Constants, const FString& ReceivedNarrativeSectionID)
-{
-	if (!UKismetSystemLibrary::IsServer(this))
+	if (ChatbotUpdatesToSend.Num() > 0)
 	{
-		OnNarrativeSectionReceived(BT_Code, BT_Constants, ReceivedNarrativeSectionID);
+		for (const FConvaiChatbotUpdate& Pending : ChatbotUpdatesToSend)
+		{
+			if (Pending.Type == EConvaiChatbotUpdateType::Transcription)
+				TranscriptionSegment++;
+		}
+		Broadcast_ChatbotUpdates(ChatbotUpdatesToSend);
+	}
+
+	if (HasPartialTranscription)
+	{
+		Broadcast_PartialTranscription(PartialTranscription, TranscriptionSegment);
 	}
 }
 
-void UConvaiChatbotComponent::Broadcast_onEmotionReceived_Implementation(const FString& ReceivedEmotionResponse)
+void UConvaiChatbotComponent::ApplyChatbotUpdate(const FConvaiChatbotUpdate& Update)
 {
-	if (!UKismetSystemLibrary::IsServer(this))
-	{
-		onEmotionReceived(ReceivedEmotionResponse);
+	switch (Update.Type)
+	{
+	case EConvaiChatbotUpdateType::Transcription:
+		if (!Update.IsPartialTranscription())
+			TranscriptionSegment++;
+		OnTranscriptionReceived(Update.Text, Update.IsTranscriptionReady, Update.IsFinal);
+		break;
+	case EConvaiChatbotUpdateType::ResponseText:
+		onResponseDataReceived(Update.Text, TArray<uint8>(), 0, Update.IsFinal);
+		break;
+	case EConvaiChatbotUpdateType::SessionID:
+		onSessionIDReceived(Update.Text);
+		break;
+	case EConvaiChatbotUpdateType::Actions:
+		onActionSequenceReceived(Update.Actions);
+		break;
+	case EConvaiChatbotUpdateType::NarrativeSection:
+		OnNarrativeSectionReceived(Update.BT_Code, Update.BT_Constants, Update.Text);
+		break;
+	case EConvaiChatbotUpdateType::Emotion:
+		onEmotionReceived(Update.Text);
+		break;
 	}
 }
 
@@ -613,7 +667,12 @@ void UConvaiChatbotComponent::OnTranscriptionReceived(FString Transcription, boo
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_OnTranscriptionReceived(Transcription, IsTranscriptionReady, IsFinal);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::Transcription;
+		Update.Text = Transcription;
+		Update.IsTranscriptionReady = IsTranscriptionReady;
+		Update.IsFinal = IsFinal;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	AsyncTask(ENamedThreads::GameThread, [this, Transcription, IsTranscriptionReady, IsFinal]
@@ -633,7 +692,11 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_onResponseDataReceived(ReceivedText, IsFinal);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::ResponseText;
+		Update.Text = ReceivedText;
+		Update.IsFinal = IsFinal;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	AsyncTask(ENamedThreads::GameThread, [this, ReceivedText, ReceivedAudio, SampleRate, IsFinal]
@@ -664,7 +727,10 @@ void UConvaiChatbotComponent::onSessionIDReceived(const FString ReceivedSessionI
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_onSessionIDReceived(ReceivedSessionID);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::SessionID;
+		Update.Text = ReceivedSessionID;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	SessionID = ReceivedSessionID;
@@ -675,7 +741,10 @@ void UConvaiChatbotComponent::onActionSequenceReceived(const TArray<FConvaiResul
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_onActionSequenceReceived(ReceivedSequenceOfActions);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::Actions;
+		Update.Actions = ReceivedSequenceOfActions;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	if (UConvaiUtils::IsNewActionSystemEnabled())
@@ -706,7 +775,10 @@ void UConvaiChatbotComponent::onEmotionReceived(FString ReceivedEmotionResponse)
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_onEmotionReceived(ReceivedEmotionResponse);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::Emotion;
+		Update.Text = ReceivedEmotionResponse;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	// Update teh emotion state
@@ -733,7 +805,12 @@ void UConvaiChatbotComponent::OnNarrativeSectionReceived(FString BT_Code, FStrin
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
-		Broadcast_OnNarrativeSectionReceived(BT_Code, BT_Constants, ReceivedNarrativeSectionID);
+		FConvaiChatbotUpdate Update;
+		Update.Type = EConvaiChatbotUpdateType::NarrativeSection;
+		Update.Text = ReceivedNarrativeSectionID;
+		Update.BT_Code = BT_Code;
+		Update.BT_Constants = BT_Constants;
+		QueueChatbotUpdate(MoveTemp(Update));
 	}
 
 	AsyncTask(ENamedThreads::GameThread, [this, ReceivedNarrativeSectionID]
@@ -756,7 +833,8 @@ void UConvaiChatbotComponent::OnRep_EnvironmentData()
 {
 	if (IsValid(Environment))
 	{
-		Environment->SetFromEnvironment(ConvaiEnvironmentDetails);
+		Environment->SetFromEnvironment(ReplicatedEnvironment.ToEnvironmentDetails());
+		AppliedEnvironmentVersion = Environment->GetVersion();
 	}
 	else
 	{
@@ -766,9 +844,17 @@ void UConvaiChatbotComponent::OnRep_EnvironmentData()
 
 void UConvaiChatbotComponent::UpdateEnvironmentData()
 {
+	// Clients only ever receive the environment
+	if (!UKismetSystemLibrary::IsServer(this))
+		return;
+
 	if (IsValid(Environment))
 	{
-		ConvaiEnvironmentDetails = Environment->ToEnvironmentStruct();
+		if (Environment->GetVersion() == ReplicatedEnvironmentVersion)
+			return;
+
+		ReplicatedEnvironment.Update(Environment);
+		ReplicatedEnvironmentVersion = Environment->GetVersion();
 	}
 	else
 	{
@@ -776,6 +862,17 @@ void UConvaiChatbotComponent::UpdateEnvironmentData()
 	}
 }
 
+uint32 UConvaiChatbotComponent::GetServerEnvironmentVersion(const UConvaiEnvironment* InEnvironment) const
+{
+	if (!IsValid(InEnvironment) || InEnvironment != Environment)
+		return 0;
+
+	if (UKismetSystemLibrary::IsServer(this))
+		return InEnvironment->GetVersion();
+
+	return InEnvironment->GetVersion() == AppliedEnvironmentVersion ? ReplicatedEnvironmentVersion : 0;
+}
+
 void UConvaiChatbotComponent::LoadEnvironment(UConvaiEnvironment* NewConvaiEnvironment)
 {
 	if (IsValid(Environment))
@@ -827,6 +924,10 @@ void UConvaiChatbotComponent::BeginPlay()
 	{
 		Environment->OnEnvironmentChanged.BindUObject(this, &UConvaiChatbotComponent::UpdateEnvironmentData);
 
+		// The environment may have replicated before it existed
+		if (!UKismetSystemLibrary::IsServer(this) && ReplicatedEnvironmentVersion != 0)
+			OnRep_EnvironmentData();
+
 	}
 	else
 	{
@@ -843,6 +944,13 @@ void UConvaiChatbotComponent::TickComponent(float DeltaTime, ELevelTick TickType
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	// One reliable multicast per frame however finely the response is streamed
+	FlushChatbotUpdates();
+
+	// Picks up changes made directly through the environment functions, several changes in a frame are sent together
+	if (GetNetMode() != NM_Standalone && IsValid(Environment) && Environment->GetVersion() != ReplicatedEnvironmentVersion)
+		UpdateEnvironmentData();
+
 	if (!IsValid(ConvaiGRPCGetResponseProxy) || !StreamInProgress)
 		return;
 
@@ -2,6 +2,7 @@
 
 
 #include "ConvaiDefinitions.h"
+#include "ConvaiActionMatcher.h"
 
 const TMap<EEmotionIntensity, float> FConvaiEmotionState::ScoreMultipliers = 
 {
@@ -9,4 +10,231 @@ const TMap<EEmotionIntensity, float> FConvaiEmotionState::ScoreMultipliers =
 	{EEmotionIntensity::LessIntense, 0.25},
 	{EEmotionIntensity::Basic, 0.6},
 	{EEmotionIntensity::MoreIntense, 1}
-};
\ No newline at end of file
+};
+
+namespace
+{
+	bool IsSameEntry(const FConvaiObjectEntry& A, const FConvaiObjectEntry& B)
+	{
+		return A.Name == B.Name
+			&& A.Description == B.Description
+			&& A.OptionalPositionVector == B.OptionalPositionVector
+			&& A.Ref == B.Ref;
+	}
+
+	struct FFaceCurveTable
+	{
+		TArray<FName> Names;
+		TMap<FName, int32> Indices;
+
+		explicit FFaceCurveTable(const TArray<FString>& InNames)
+		{
+			Names.Reserve(InNames.Num());
+			for (const FString& Name : InNames)
+			{
+				Indices.Add(*Name, Names.Num());
+				Names.Add(*Name);
+			}
+		}
+	};
+
+	const FFaceCurveTable& GetFaceCurveTable(EConvaiFaceCurveSet CurveSet)
+	{
+		static const FFaceCurveTable BlendshapeTable(ConvaiConstants::BlendShapesNames);
+		static const FFaceCurveTable VisemeTable(ConvaiConstants::VisemeNames);
+		static const FFaceCurveTable EmptyTable(TArray<FString>{});
+		checkf(BlendshapeTable.Names.Num() == EConvaiBlendshape::Count && VisemeTable.Names.Num() == EConvaiViseme::Count,
+			TEXT("EConvaiBlendshape/EConvaiViseme are out of sync with ConvaiConstants"));
+
+		switch (CurveSet)
+		{
+		case EConvaiFaceCurveSet::Blendshapes:
+			return BlendshapeTable;
+		case EConvaiFaceCurveSet::Visemes:
+			return VisemeTable;
+		default:
+			return EmptyTable;
+		}
+	}
+}
+
+int32 FConvaiFaceCurves::GetNumCurves(EConvaiFaceCurveSet InCurveSet)
+{
+	switch (InCurveSet)
+	{
+	case EConvaiFaceCurveSet::Blendshapes:
+		return EConvaiBlendshape::Count;
+	case EConvaiFaceCurveSet::Visemes:
+		return EConvaiViseme::Count;
+	default:
+		return 0;
+	}
+}
+
+const TArray<FName>& FConvaiFaceCurves::GetCurveNames(EConvaiFaceCurveSet InCurveSet)
+{
+	return GetFaceCurveTable(InCurveSet).Names;
+}
+
+int32 FConvaiFaceCurves::FindCurveIndex(EConvaiFaceCurveSet InCurveSet, FName CurveName)
+{
+	const int32* Index = GetFaceCurveTable(InCurveSet).Indices.Find(CurveName);
+	return Index ? *Index : INDEX_NONE;
+}
+
+bool FConvaiFaceCurves::SetCurve(FName CurveName, float Value)
+{
+	if (CurveSet == EConvaiFaceCurveSet::None)
+	{
+		if (FindCurveIndex(EConvaiFaceCurveSet::Blendshapes, CurveName) != INDEX_NONE)
+			CurveSet = EConvaiFaceCurveSet::Blendshapes;
+		else if (FindCurveIndex(EConvaiFaceCurveSet::Visemes, CurveName) != INDEX_NONE)
+			CurveSet = EConvaiFaceCurveSet::Visemes;
+		else
+			return false;
+	}
+
+	const int32 Index = FindCurveIndex(CurveSet, CurveName);
+	if (Index == INDEX_NONE)
+		return false;
+
+	Values[Index] = Value;
+	return true;
+}
+
+const float* FConvaiFaceCurves::FindCurve(FName CurveName) const
+{
+	const int32 Index = FindCurveIndex(CurveSet, CurveName);
+	return Index != INDEX_NONE ? &Values[Index] : nullptr;
+}
+
+TMap<FName, float> FConvaiFaceCurves::ToMap() const
+{
+	const TArray<FName>& CurveNames = GetCurveNames(CurveSet);
+	TMap<FName, float> CurveMap;
+	CurveMap.Reserve(CurveNames.Num());
+	for (int32 i = 0; i < CurveNames.Num(); i++)
+	{
+		CurveMap.Add(CurveNames[i], Values[i]);
+	}
+	return CurveMap;
+}
+
+void FConvaiFaceCurves::FromMap(const TMap<FName, float>& CurveMap)
+{
+	FMemory::Memzero(Values);
+	for (const auto& Curve : CurveMap)
+	{
+		SetCurve(Curve.Key, Curve.Value);
+	}
+}
+
+void FConvaiEnvironmentItems::Update(const UConvaiEnvironment* Environment)
+{
+	if (!IsValid(Environment))
+		return;
+
+	typedef TTuple<EConvaiEnvironmentItemType, FString> FItemKey;
+
+	TMap<FItemKey, int32> ExistingItems;
+	ExistingItems.Reserve(Items.Num());
+	for (int32 i = 0; i < Items.Num(); i++)
+	{
+		ExistingItems.Add(FItemKey(Items[i].Type, Items[i].Entry.Name), i);
+	}
+
+	TBitArray<> Seen(false, Items.Num());
+
+	auto UpdateItem = [&](EConvaiEnvironmentItemType Type, const FConvaiObjectEntry& Entry)
+	{
+		if (const int32* Index = ExistingItems.Find(FItemKey(Type, Entry.Name)))
+		{
+			Seen[*Index] = true;
+			FConvaiEnvironmentItem& Item = Items[*Index];
+			if (!IsSameEntry(Item.Entry, Entry))
+			{
+				Item.Entry = Entry;
+				MarkItemDirty(Item);
+			}
+			return;
+		}
+
+		FConvaiEnvironmentItem& Item = Items.AddDefaulted_GetRef();
+		Item.Type = Type;
+		Item.Entry = Entry;
+		MarkItemDirty(Item);
+	};
+
+	FConvaiObjectEntry ActionEntry;
+	for (const FString& Action : Environment->Actions)
+	{
+		ActionEntry.Name = Action;
+		UpdateItem(EConvaiEnvironmentItemType::Action, ActionEntry);
+	}
+	for (const FConvaiObjectEntry& Object : Environment->Objects)
+	{
+		UpdateItem(EConvaiEnvironmentItemType::Object, Object);
+	}
+	for (const FConvaiObjectEntry& Character : Environment->Characters)
+	{
+		UpdateItem(EConvaiEnvironmentItemType::Character, Character);
+	}
+	if (!Environment->MainCharacter.Name.IsEmpty())
+	{
+		UpdateItem(EConvaiEnvironmentItemType::MainCharacter, Environment->MainCharacter);
+	}
+	if (!Environment->AttentionObject.Name.IsEmpty())
+	{
+		UpdateItem(EConvaiEnvironmentItemType::AttentionObject, Environment->AttentionObject);
+	}
+
+	// Items added above are past the end of the seen flags and are kept
+	bool RemovedAny = false;
+	for (int32 i = Seen.Num() - 1; i >= 0; i--)
+	{
+		if (!Seen[i])
+		{
+			Items.RemoveAt(i);
+			RemovedAny = true;
+		}
+	}
+	if (RemovedAny)
+	{
+		MarkArrayDirty();
+	}
+}
+
+FConvaiEnvironmentDetails FConvaiEnvironmentItems::ToEnvironmentDetails() const
+{
+	FConvaiEnvironmentDetails Details;
+	for (const FConvaiEnvironmentItem& Item : Items)
+	{
+		switch (Item.Type)
+		{
+		case EConvaiEnvironmentItemType::Action:
+			Details.Actions.Add(Item.Entry.Name);
+			break;
+		case EConvaiEnvironmentItemType::Object:
+			Details.Objects.Add(Item.Entry);
+			break;
+		case EConvaiEnvironmentItemType::Character:
+			Details.Characters.Add(Item.Entry);
+			break;
+		case EConvaiEnvironmentItemType::MainCharacter:
+			Details.MainCharacter = Item.Entry;
+			break;
+		case EConvaiEnvironmentItemType::AttentionObject:
+			Details.AttentionObject = Item.Entry;
+			break;
+		}
+	}
+	return Details;
+}
+
+TSharedRef<const FConvaiActionMatcher, ESPMode::ThreadSafe> UConvaiEnvironment::GetActionMatcher() const
+{
+	FScopeLock Lock(&ActionMatcherLock);
+	if (!ActionMatcher.IsValid() || ActionMatcher->GetVersion() != Version)
+		ActionMatcher = MakeShared<const FConvaiActionMatcher, ESPMode::ThreadSafe>(*this);
+	return ActionMatcher.ToSharedRef();
+}
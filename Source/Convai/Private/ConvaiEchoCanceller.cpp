@@ -0,0 +1,380 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiEchoCanceller.h"
+#include "ConvaiDefinitions.h"
+
+namespace
+{
+	/** Frames used by the barge-in detector */
+	constexpr float BargeInFrameSeconds = 0.01f;
+
+	/** Near-end level relative to the reference peak that is considered double talk */
+	constexpr float GeigelThreshold = 0.5f;
+
+	/** Blocks to keep adaptation frozen after double talk ends */
+	constexpr int32 DoubleTalkHangoverBlocks = 5;
+
+	/** Decay of the reference peak per block */
+	constexpr float ReferencePeakDecay = 0.95f;
+
+	/** Slow upward drift of the noise floor estimate per frame */
+	constexpr float NoiseFloorRise = 1.002f;
+
+	/** Residual energy has to exceed the noise floor by this factor to count as speech */
+	constexpr float NoiseFloorMargin = 4.0f;
+
+	/** Envelope resolution of the delay estimator */
+	constexpr float DelayEstimatorBlockSeconds = 0.004f;
+
+	/** Envelope span correlated for each estimate, long enough to hold a few syllables of the character */
+	constexpr float DelayEstimatorWindowSeconds = 2.0f;
+
+	/** Time between estimates */
+	constexpr float DelayEstimatorIntervalSeconds = 0.5f;
+
+	/** Envelope correlation below this is not trusted, e.g. while the player talks over the character */
+	constexpr double DelayEstimatorMinCorrelation = 0.5;
+}
+
+FConvaiEchoReference::FConvaiEchoReference()
+	: bAttached(false)
+	, SampleRate(0)
+{
+}
+
+void FConvaiEchoReference::PushRenderedAudio(const int16* InterleavedPCM, int32 NumSamples, int32 NumChannels, int32 InSampleRate)
+{
+	if (!IsAttached() || NumSamples <= 0 || NumChannels <= 0)
+		return;
+
+	SampleRate.store(InSampleRate, std::memory_order_release);
+
+	if (NumChannels == 1)
+	{
+		Samples.Enqueue(InterleavedPCM, NumSamples);
+		return;
+	}
+
+	const int32 NumFrames = NumSamples / NumChannels;
+	DownmixScratch.SetNumUninitialized(NumFrames, false);
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		int32 Sum = 0;
+		for (int32 Channel = 0; Channel < NumChannels; Channel++)
+		{
+			Sum += InterleavedPCM[Frame * NumChannels + Channel];
+		}
+		DownmixScratch[Frame] = (int16)(Sum / NumChannels);
+	}
+	Samples.Enqueue(DownmixScratch.GetData(), NumFrames);
+}
+
+void FConvaiEchoReference::PushSilence(int32 NumFrames)
+{
+	if (!IsAttached() || NumFrames <= 0)
+		return;
+
+	TArrayView<int16> First, Second;
+	const uint32 NumWritten = Samples.GetWriteRegions(First, Second, NumFrames);
+	FMemory::Memzero(First.GetData(), First.Num() * sizeof(int16));
+	FMemory::Memzero(Second.GetData(), Second.Num() * sizeof(int16));
+	Samples.CommitWrite(NumWritten);
+}
+
+void FConvaiEchoReference::Attach()
+{
+	// Allocated on first use, the producer does not touch the storage until attached
+	if (Samples.Capacity() < ConvaiConstants::EchoReferenceCapacity)
+		Samples.Init(ConvaiConstants::EchoReferenceCapacity);
+
+	Samples.Reset();
+	bAttached.store(true, std::memory_order_release);
+}
+
+void FConvaiEchoReference::Detach()
+{
+	bAttached.store(false, std::memory_order_release);
+	Samples.Reset();
+}
+
+FConvaiEchoCanceller::FConvaiEchoCanceller()
+	: FilterLength(0)
+	, StepSize(0.5f)
+	, HistoryPos(0)
+	, WindowPower(0)
+	, ReferencePeak(0)
+	, DoubleTalkHangover(0)
+{
+}
+
+void FConvaiEchoCanceller::Init(int32 InFilterLength, float InStepSize)
+{
+	FilterLength = FMath::Max(InFilterLength, 1);
+	StepSize = FMath::Clamp(InStepSize, KINDA_SMALL_NUMBER, 1.0f);
+	Weights.SetNumUninitialized(FilterLength);
+	History.SetNumUninitialized(FilterLength * 2);
+	Reset();
+}
+
+void FConvaiEchoCanceller::Reset()
+{
+	FMemory::Memzero(Weights.GetData(), Weights.Num() * sizeof(float));
+	FMemory::Memzero(History.GetData(), History.Num() * sizeof(float));
+	HistoryPos = 0;
+	WindowPower = 0;
+	ReferencePeak = 0;
+	DoubleTalkHangover = 0;
+}
+
+void FConvaiEchoCanceller::Process(float* InOutMic, const float* Ref, int32 NumSamples)
+{
+	if (!IsInitialized() || NumSamples <= 0)
+		return;
+
+	// Block level Geigel double talk detection
+	float BlockRefPeak = 0;
+	float BlockMicPeak = 0;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		BlockRefPeak = FMath::Max(BlockRefPeak, FMath::Abs(Ref[i]));
+		BlockMicPeak = FMath::Max(BlockMicPeak, FMath::Abs(InOutMic[i]));
+	}
+	ReferencePeak = FMath::Max(ReferencePeak * ReferencePeakDecay, BlockRefPeak);
+
+	if (ReferencePeak > KINDA_SMALL_NUMBER && BlockMicPeak > GeigelThreshold * ReferencePeak)
+		DoubleTalkHangover = DoubleTalkHangoverBlocks;
+	else if (DoubleTalkHangover > 0)
+		DoubleTalkHangover--;
+
+	const bool bAdapt = DoubleTalkHangover == 0;
+	const float Regularization = FilterLength * 1e-6f;
+
+	float* W = Weights.GetData();
+	float* H = History.GetData();
+
+	for (int32 n = 0; n < NumSamples; n++)
+	{
+		// Window[k] holds x[n - k]
+		HistoryPos = HistoryPos == 0 ? FilterLength - 1 : HistoryPos - 1;
+		const float Oldest = H[HistoryPos];
+		H[HistoryPos] = H[HistoryPos + FilterLength] = Ref[n];
+		const float* Window = H + HistoryPos;
+
+		WindowPower = FMath::Max(WindowPower + Ref[n] * Ref[n] - Oldest * Oldest, 0.0f);
+
+		float EchoEstimate = 0;
+		for (int32 k = 0; k < FilterLength; k++)
+		{
+			EchoEstimate += W[k] * Window[k];
+		}
+
+		const float Error = InOutMic[n] - EchoEstimate;
+		InOutMic[n] = Error;
+
+		if (bAdapt && WindowPower > Regularization)
+		{
+			const float Mu = StepSize * Error / (WindowPower + Regularization);
+			for (int32 k = 0; k < FilterLength; k++)
+			{
+				W[k] += Mu * Window[k];
+			}
+		}
+	}
+}
+
+FConvaiEchoDelayEstimator::FConvaiEchoDelayEstimator()
+	: BlockSize(0)
+	, MaxLeadBlocks(0)
+	, MaxDelayBlocks(0)
+	, WindowBlocks(0)
+	, IntervalBlocks(0)
+{
+	Reset();
+}
+
+void FConvaiEchoDelayEstimator::Init(int32 InSampleRate, int32 InMaxLead, int32 InMaxDelay)
+{
+	BlockSize = FMath::Max(FMath::RoundToInt(InSampleRate * DelayEstimatorBlockSeconds), 1);
+	MaxLeadBlocks = FMath::Max(InMaxLead, 0) / BlockSize;
+	MaxDelayBlocks = FMath::Max(InMaxDelay, 0) / BlockSize;
+	WindowBlocks = FMath::Max(FMath::RoundToInt(DelayEstimatorWindowSeconds / DelayEstimatorBlockSeconds), 1);
+	IntervalBlocks = FMath::Max(FMath::RoundToInt(DelayEstimatorIntervalSeconds / DelayEstimatorBlockSeconds), 1);
+
+	// Every lag is correlated over a full window
+	const int32 HistoryBlocks = WindowBlocks + MaxLeadBlocks + MaxDelayBlocks;
+	MicEnvelope.SetNumUninitialized(HistoryBlocks);
+	RefEnvelope.SetNumUninitialized(HistoryBlocks);
+	Reset();
+}
+
+void FConvaiEchoDelayEstimator::Reset()
+{
+	HistoryPos = 0;
+	HistoryNum = 0;
+	BlocksSinceEstimate = 0;
+	BlockFill = 0;
+	BlockMicEnergy = 0;
+	BlockRefEnergy = 0;
+	Delay = 0;
+}
+
+bool FConvaiEchoDelayEstimator::Process(const float* Mic, const float* Ref, int32 NumSamples)
+{
+	if (!IsInitialized())
+		return false;
+
+	bool bNewEstimate = false;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		BlockMicEnergy += Mic[i] * Mic[i];
+		BlockRefEnergy += Ref[i] * Ref[i];
+		if (++BlockFill < BlockSize)
+			continue;
+
+		MicEnvelope[HistoryPos] = FMath::Sqrt(BlockMicEnergy / BlockSize);
+		RefEnvelope[HistoryPos] = FMath::Sqrt(BlockRefEnergy / BlockSize);
+		HistoryPos = (HistoryPos + 1) % MicEnvelope.Num();
+		HistoryNum = FMath::Min(HistoryNum + 1, MicEnvelope.Num());
+		BlockFill = 0;
+		BlockMicEnergy = 0;
+		BlockRefEnergy = 0;
+
+		if (HistoryNum == MicEnvelope.Num() && ++BlocksSinceEstimate >= IntervalBlocks)
+		{
+			BlocksSinceEstimate = 0;
+			bNewEstimate |= Estimate();
+		}
+	}
+	return bNewEstimate;
+}
+
+bool FConvaiEchoDelayEstimator::Estimate()
+{
+	const int32 HistoryBlocks = MicEnvelope.Num();
+	const double N = WindowBlocks;
+
+	double BestCorrelation = DelayEstimatorMinCorrelation;
+	int32 BestLag = 0;
+	bool bFound = false;
+
+	for (int32 Lag = -MaxLeadBlocks; Lag <= MaxDelayBlocks; Lag++)
+	{
+		// Ages count back from the newest block, the microphone block at age A is paired with the reference block at age A + Lag
+		const int32 FirstMicAge = FMath::Max(-Lag, 0);
+
+		double SumMic = 0, SumRef = 0, SumMicRef = 0, SumMic2 = 0, SumRef2 = 0;
+		for (int32 Age = FirstMicAge; Age < FirstMicAge + WindowBlocks; Age++)
+		{
+			const float MicValue = MicEnvelope[(HistoryPos - 1 - Age + HistoryBlocks) % HistoryBlocks];
+			const float RefValue = RefEnvelope[(HistoryPos - 1 - Age - Lag + HistoryBlocks) % HistoryBlocks];
+			SumMic += MicValue;
+			SumRef += RefValue;
+			SumMicRef += MicValue * RefValue;
+			SumMic2 += MicValue * MicValue;
+			SumRef2 += RefValue * RefValue;
+		}
+
+		// Pearson correlation, a silent reference or microphone has no defined delay
+		const double Variance = (N * SumMic2 - SumMic * SumMic) * (N * SumRef2 - SumRef * SumRef);
+		if (Variance <= SMALL_NUMBER)
+			continue;
+
+		const double Correlation = (N * SumMicRef - SumMic * SumRef) / FMath::Sqrt(Variance);
+		if (Correlation > BestCorrelation)
+		{
+			BestCorrelation = Correlation;
+			BestLag = Lag;
+			bFound = true;
+		}
+	}
+
+	if (bFound)
+		Delay = BestLag * BlockSize;
+	return bFound;
+}
+
+FConvaiBargeInDetector::FConvaiBargeInDetector()
+	: SampleRate(0)
+	, FrameSize(0)
+	, ThresholdEnergy(0)
+	, MinSpeechDuration(0)
+	, EchoRatio(0)
+{
+	Reset();
+}
+
+void FConvaiBargeInDetector::Init(int32 InSampleRate, float InThresholdDb, float InMinSpeechDuration, float InEchoRatio)
+{
+	SampleRate = FMath::Max(InSampleRate, 1);
+	FrameSize = FMath::Max(FMath::RoundToInt(SampleRate * BargeInFrameSeconds), 1);
+	ThresholdEnergy = FMath::Pow(10.0f, InThresholdDb / 10.0f);
+	MinSpeechDuration = InMinSpeechDuration;
+	EchoRatio = InEchoRatio;
+	Reset();
+}
+
+void FConvaiBargeInDetector::Reset()
+{
+	NoiseFloor = 0;
+	SpeechDuration = 0;
+	SilenceDuration = 0;
+	bTriggered = false;
+	bTriggeredThisBlock = false;
+	FrameFill = 0;
+	FrameMicEnergy = 0;
+	FrameResidualEnergy = 0;
+}
+
+bool FConvaiBargeInDetector::Process(const float* Mic, const float* Residual, int32 NumSamples, bool bReferenceActive)
+{
+	if (FrameSize == 0)
+		return false;
+
+	bTriggeredThisBlock = false;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		FrameMicEnergy += Mic[i] * Mic[i];
+		FrameResidualEnergy += Residual[i] * Residual[i];
+		if (++FrameFill == FrameSize)
+		{
+			ProcessFrame(FrameMicEnergy / FrameSize, FrameResidualEnergy / FrameSize, bReferenceActive);
+			FrameFill = 0;
+			FrameMicEnergy = 0;
+			FrameResidualEnergy = 0;
+		}
+	}
+	return bTriggeredThisBlock;
+}
+
+void FConvaiBargeInDetector::ProcessFrame(float MicEnergy, float ResidualEnergy, bool bReferenceActive)
+{
+	// Minimum tracking noise floor, drops immediately and rises slowly
+	NoiseFloor = NoiseFloor <= 0 ? ResidualEnergy : FMath::Min(NoiseFloor * NoiseFloorRise, FMath::Max(ResidualEnergy, SMALL_NUMBER));
+
+	const bool bLoudEnough = ResidualEnergy > ThresholdEnergy && ResidualEnergy > NoiseFloor * NoiseFloorMargin;
+
+	// While the character is audible most of the microphone energy should be removed by the canceller, a large residual means near-end speech
+	const bool bNotEcho = !bReferenceActive || ResidualEnergy > EchoRatio * MicEnergy;
+
+	if (bLoudEnough && bNotEcho)
+	{
+		SpeechDuration += BargeInFrameSeconds;
+		SilenceDuration = 0;
+	}
+	else
+	{
+		// Short gaps between syllables should not reset the accumulated speech
+		SpeechDuration = FMath::Max(SpeechDuration - BargeInFrameSeconds * 0.5f, 0.0f);
+		SilenceDuration += BargeInFrameSeconds;
+	}
+
+	if (!bTriggered && SpeechDuration >= MinSpeechDuration)
+	{
+		bTriggered = true;
+		bTriggeredThisBlock = true;
+	}
+	else if (bTriggered && SpeechDuration <= 0)
+	{
+		bTriggered = false;
+	}
+}
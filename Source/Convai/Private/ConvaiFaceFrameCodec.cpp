@@ -0,0 +1,190 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiFaceFrameCodec.h"
+
+namespace
+{
+	/** Packet layout: curve set, stream id, start time in ms, number of sequences, then per sequence its frame count, duration in ms and frames */
+	constexpr int32 FacePacketHeaderSize = 1 + 1 + 4 + 1;
+	constexpr int32 FaceSequenceHeaderSize = 2 + 2;
+
+	/** Head rotations are signed, they are quantized to 254 steps so that zero stays exact */
+	bool IsSignedCurve(EConvaiFaceCurveSet CurveSet, int32 CurveIndex)
+	{
+		return CurveSet == EConvaiFaceCurveSet::Blendshapes && CurveIndex >= EConvaiBlendshape::HeadRoll;
+	}
+
+	uint8 Quantize(float Value, bool bSigned)
+	{
+		return bSigned
+			? (uint8)FMath::RoundToInt((FMath::Clamp(Value, -1.0f, 1.0f) + 1.0f) * 127.0f)
+			: (uint8)FMath::RoundToInt(FMath::Clamp(Value, 0.0f, 1.0f) * 255.0f);
+	}
+
+	float Dequantize(uint8 Value, bool bSigned)
+	{
+		return bSigned ? Value / 127.0f - 1.0f : Value / 255.0f;
+	}
+
+	void ResetToZero(EConvaiFaceCurveSet CurveSet, uint8* Values)
+	{
+		const int32 NumCurves = FConvaiFaceCurves::GetNumCurves(CurveSet);
+		for (int32 i = 0; i < NumCurves; i++)
+		{
+			Values[i] = Quantize(0, IsSignedCurve(CurveSet, i));
+		}
+	}
+
+	void WriteUInt16(TArray<uint8>& Out, uint16 Value)
+	{
+		Out.Add(Value & 0xFF);
+		Out.Add(Value >> 8);
+	}
+
+	void WriteUInt32(TArray<uint8>& Out, uint32 Value)
+	{
+		WriteUInt16(Out, Value & 0xFFFF);
+		WriteUInt16(Out, Value >> 16);
+	}
+
+	struct FPacketReader
+	{
+		const TArray<uint8>& Data;
+		int32 Offset = 0;
+
+		bool CanRead(int32 NumBytes) const { return Offset + NumBytes <= Data.Num(); }
+		uint8 ReadUInt8() { return Data[Offset++]; }
+		uint16 ReadUInt16() { const uint16 Low = ReadUInt8(); return Low | (uint16(ReadUInt8()) << 8); }
+		uint32 ReadUInt32() { const uint32 Low = ReadUInt16(); return Low | (uint32(ReadUInt16()) << 16); }
+	};
+
+	bool ReadSequences(FPacketReader& Reader, EConvaiFaceCurveSet CurveSet, int32 NumSequences, TArray<FAnimationSequence>& OutSequences)
+	{
+		const int32 NumCurves = FConvaiFaceCurves::GetNumCurves(CurveSet);
+		const int32 MaskSize = (NumCurves + 7) / 8;
+		uint8 Values[FConvaiFaceCurves::MaxCurves];
+		ResetToZero(CurveSet, Values);
+
+		for (int32 SequenceIndex = 0; SequenceIndex < NumSequences; SequenceIndex++)
+		{
+			if (!Reader.CanRead(FaceSequenceHeaderSize))
+				return false;
+
+			const int32 NumFrames = Reader.ReadUInt16();
+			const float Duration = Reader.ReadUInt16() / 1000.0f;
+
+			// Every frame carries at least its mask, so a frame count the rest of the packet cannot hold is rejected before allocating
+			if (!Reader.CanRead(NumFrames * MaskSize))
+				return false;
+
+			FAnimationSequence& Sequence = OutSequences.AddDefaulted_GetRef();
+			Sequence.Duration = Duration;
+			Sequence.AnimationFrames.SetNum(NumFrames);
+
+			for (int32 FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+			{
+				if (!Reader.CanRead(MaskSize))
+					return false;
+				const int32 MaskOffset = Reader.Offset;
+				Reader.Offset += MaskSize;
+
+				FAnimationFrame& Frame = Sequence.AnimationFrames[FrameIndex];
+				Frame.FrameIndex = FrameIndex;
+				Frame.BlendShapes.Reset(CurveSet);
+				for (int32 i = 0; i < NumCurves; i++)
+				{
+					if (Reader.Data[MaskOffset + i / 8] & (1 << (i % 8)))
+					{
+						if (!Reader.CanRead(1))
+							return false;
+						Values[i] += Reader.ReadUInt8();
+					}
+					Frame.BlendShapes[i] = Dequantize(Values[i], IsSignedCurve(CurveSet, i));
+				}
+			}
+		}
+		return true;
+	}
+}
+
+void FConvaiFaceFrameCodec::FWriter::Begin(EConvaiFaceCurveSet InCurveSet, uint8 StreamId, float StartTime)
+{
+	CurveSet = InCurveSet;
+	NumSequences = 0;
+	ResetToZero(CurveSet, PreviousValues);
+
+	Packet.Reset();
+	Packet.Add((uint8)CurveSet);
+	Packet.Add(StreamId);
+	WriteUInt32(Packet, (uint32)FMath::Max(FMath::RoundToInt(StartTime * 1000.0f), 0));
+	Packet.Add(0);
+}
+
+void FConvaiFaceFrameCodec::FWriter::AddSequence(const FAnimationSequence& Sequence)
+{
+	const int32 NumCurves = FConvaiFaceCurves::GetNumCurves(CurveSet);
+	const int32 MaskSize = (NumCurves + 7) / 8;
+	const int32 NumFrames = FMath::Min(Sequence.AnimationFrames.Num(), (int32)MAX_uint16);
+	if (NumCurves == 0 || NumFrames == 0 || NumSequences == MAX_uint8)
+		return;
+
+	WriteUInt16(Packet, NumFrames);
+	WriteUInt16(Packet, (uint16)FMath::Clamp(FMath::RoundToInt(Sequence.Duration * 1000.0f), 0, (int32)MAX_uint16));
+
+	for (int32 FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+	{
+		const FConvaiFaceCurves& Curves = Sequence.AnimationFrames[FrameIndex].BlendShapes;
+		const bool bSameLayout = Curves.GetCurveSet() == CurveSet;
+
+		// The mask is written first and filled in while the deltas follow it
+		const int32 MaskOffset = Packet.AddZeroed(MaskSize);
+		for (int32 i = 0; i < NumCurves; i++)
+		{
+			const uint8 Value = Quantize(bSameLayout ? Curves[i] : 0.0f, IsSignedCurve(CurveSet, i));
+			if (Value == PreviousValues[i])
+				continue;
+
+			Packet[MaskOffset + i / 8] |= 1 << (i % 8);
+			Packet.Add((uint8)(Value - PreviousValues[i]));
+			PreviousValues[i] = Value;
+		}
+	}
+
+	NumSequences++;
+	Packet[FacePacketHeaderSize - 1] = (uint8)NumSequences;
+}
+
+bool FConvaiFaceFrameCodec::Decode(const TArray<uint8>& Packet, FPacketInfo& OutInfo, TArray<FAnimationSequence>& OutSequences)
+{
+	FPacketReader Reader{ Packet };
+	if (!Reader.CanRead(FacePacketHeaderSize))
+		return false;
+
+	const EConvaiFaceCurveSet CurveSet = (EConvaiFaceCurveSet)Reader.ReadUInt8();
+	const int32 NumCurves = FConvaiFaceCurves::GetNumCurves(CurveSet);
+	if (NumCurves == 0)
+		return false;
+
+	OutInfo.StreamId = Reader.ReadUInt8();
+	OutInfo.StartTime = Reader.ReadUInt32() / 1000.0f;
+	const int32 NumSequences = Reader.ReadUInt8();
+
+	// A malformed packet leaves nothing behind, the sequences decoded before the error are dropped
+	const int32 NumSequencesBefore = OutSequences.Num();
+	if (!ReadSequences(Reader, CurveSet, NumSequences, OutSequences) || Reader.Offset != Packet.Num())
+	{
+		OutSequences.SetNum(NumSequencesBefore);
+		return false;
+	}
+	return true;
+}
+
+int32 FConvaiFaceFrameCodec::GetUncompressedSize(const FAnimationSequence& Sequence)
+{
+	int32 Size = 0;
+	for (const FAnimationFrame& Frame : Sequence.AnimationFrames)
+	{
+		Size += Frame.BlendShapes.Num() * sizeof(float);
+	}
+	return Size;
+}
@@ -0,0 +1,68 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiFaceFrameRing.h"
+
+namespace
+{
+	/** Enough for a couple of seconds of visemes before the first growth */
+	constexpr int32 FaceFrameRingInitialCapacity = 256;
+}
+
+FConvaiFaceFrameRing::FConvaiFaceFrameRing()
+	: Head(0)
+	, Count(0)
+{
+}
+
+void FConvaiFaceFrameRing::Add(const FAnimationFrame& Frame)
+{
+	Reserve(Count + 1);
+	Slots[(Head + Count) & (Slots.Num() - 1)] = Frame;
+	Count++;
+}
+
+void FConvaiFaceFrameRing::Append(const TArray<FAnimationFrame>& Frames)
+{
+	Reserve(Count + Frames.Num());
+	const int32 Mask = Slots.Num() - 1;
+	for (const FAnimationFrame& Frame : Frames)
+	{
+		Slots[(Head + Count) & Mask] = Frame;
+		Count++;
+	}
+}
+
+void FConvaiFaceFrameRing::RemoveFront(int32 NumToRemove)
+{
+	NumToRemove = FMath::Clamp(NumToRemove, 0, Count);
+	if (NumToRemove == 0)
+		return;
+
+	Head = (Head + NumToRemove) & (Slots.Num() - 1);
+	Count -= NumToRemove;
+}
+
+void FConvaiFaceFrameRing::Reset()
+{
+	Head = 0;
+	Count = 0;
+}
+
+void FConvaiFaceFrameRing::Reserve(int32 MinCapacity)
+{
+	if (MinCapacity <= Slots.Num())
+		return;
+
+	const int32 NewCapacity = FMath::RoundUpToPowerOfTwo(FMath::Max(MinCapacity, FaceFrameRingInitialCapacity));
+
+	// Unwrap the live frames to the start of the new storage
+	TArray<FAnimationFrame> NewSlots;
+	NewSlots.SetNum(NewCapacity);
+	for (int32 i = 0; i < Count; i++)
+	{
+		NewSlots[i] = (*this)[i];
+	}
+
+	Slots = MoveTemp(NewSlots);
+	Head = 0;
+}
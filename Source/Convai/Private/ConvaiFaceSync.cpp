@@ -2,13 +2,45 @@
 
 #include "ConvaiFaceSync.h"
 #include "ConvaiUtils.h"
+#include "ConvaiAudioStreamer.h"
+#include "ConvaiFaceSyncSubsystem.h"
+#include "ConvaiVisemeEstimator.h"
+#include "Async/Async.h"
+#include "Containers/Queue.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 
 DEFINE_LOG_CATEGORY(ConvaiFaceSyncLog);
 
+/** Voice audio waiting for the viseme estimator, outlives the component while a worker task holds it */
+struct FConvaiLocalLipSync
+{
+	struct FChunk
+	{
+		TArray<int16> PCM;
+		int32 NumChannels = 0;
+		int32 SampleRate = 0;
+		EConvaiFaceCurveSet CurveSet = EConvaiFaceCurveSet::None;
+		uint32 Generation = 0;
+	};
+
+	/** Filled on the game thread, drained by at most one worker task at a time */
+	TQueue<FChunk, EQueueMode::Spsc> PendingChunks;
+	std::atomic<bool> bWorkerActive{ false };
+
+	/** Bumped when the voice stops, chunks and frames of an older generation are dropped */
+	std::atomic<uint32> Generation{ 0 };
+
+	/** Worker side */
+	FConvaiVisemeEstimator Estimator;
+	uint32 EstimatorGeneration = 0;
+};
+
 namespace
 {
 	// Helper function: Creates a zero blendshapes map
-	TMap<FName, float> CreateZeroBlendshapes()
+	TMap<FName, float> CreateZeroBlendshapesMap()
 	{
 		TMap<FName, float> ZeroBlendshapes;
 		for (const auto& BlendShapeName : ConvaiConstants::BlendShapesNames)
@@ -19,7 +51,7 @@ namespace
 	}
 	
 	// Helper function: Creates a zero visemes map
-	TMap<FName, float> CreateZeroVisemes()
+	TMap<FName, float> CreateZeroVisemesMap()
 	{
 		TMap<FName, float> ZeroVisemes;
 		for (const auto& VisemeName : ConvaiConstants::VisemeNames)
@@ -30,6 +62,137 @@ namespace
 		return ZeroVisemes;
 	}
 
+#if ENGINE_MAJOR_VERSION >= 5
+	typedef VectorRegister4Float FCurveVector;
+#else
+	typedef VectorRegister FCurveVector;
+#endif
+
+	// Curves missing from a frame interpolate from or to zero
+	const float ZeroCurveValues[FConvaiFaceCurves::MaxCurves] = {};
+
+	// Out = Start + (End - Start) * Alpha, four curves at a time. Out may alias Start or End
+	void LerpCurves(const float* Start, const float* End, float Alpha, float* Out, int32 NumCurves)
+	{
+		const FCurveVector AlphaVector = VectorSetFloat1(Alpha);
+		int32 i = 0;
+		for (; i + 4 <= NumCurves; i += 4)
+		{
+			const FCurveVector StartVector = VectorLoad(Start + i);
+			const FCurveVector EndVector = VectorLoad(End + i);
+			VectorStore(VectorMultiplyAdd(VectorSubtract(EndVector, StartVector), AlphaVector, StartVector), Out + i);
+		}
+		for (; i < NumCurves; i++)
+		{
+			Out[i] = FMath::Lerp(Start[i], End[i], Alpha);
+		}
+	}
+
+	/** Minimum seconds between evaluations per tier, the off tier only keeps the sequence timing and releases played frames */
+	const float LipSyncLODUpdateIntervals[] = { 0.0f, 1.0f / 30.0f, 1.0f / 15.0f, 0.25f };
+
+	/** Seconds to blend into a new tier */
+	constexpr float LipSyncLODBlendTime = 0.25f;
+
+	/** A lower tier is only taken once the screen size falls this far below its threshold, so the tier does not flicker */
+	constexpr float LipSyncLODHysteresis = 0.8f;
+
+	/** Seconds a character may go unrendered before its lipsync is culled */
+	constexpr float LipSyncLODRenderedTimeout = 0.5f;
+
+	// Curves evaluated by a tier, as a contiguous range of the layout
+	void GetLipSyncLODCurves(EConvaiFaceCurveSet CurveSet, EConvaiLipSyncLOD LOD, int32& OutFirstCurve, int32& OutNumCurves)
+	{
+		const int32 NumCurves = FConvaiFaceCurves::GetNumCurves(CurveSet);
+		OutFirstCurve = 0;
+		OutNumCurves = 0;
+
+		switch (LOD)
+		{
+		case EConvaiLipSyncLOD::Full:
+			OutNumCurves = NumCurves;
+			break;
+		case EConvaiLipSyncLOD::MouthOnly:
+			if (CurveSet == EConvaiFaceCurveSet::Blendshapes)
+			{
+				OutFirstCurve = EConvaiBlendshape::JawForward;
+				OutNumCurves = EConvaiBlendshape::MouthUpperUpRight + 1 - EConvaiBlendshape::JawForward;
+			}
+			else
+			{
+				// Visemes only describe the mouth
+				OutNumCurves = NumCurves;
+			}
+			break;
+		case EConvaiLipSyncLOD::JawOnly:
+			if (NumCurves > 0)
+			{
+				OutFirstCurve = CurveSet == EConvaiFaceCurveSet::Blendshapes ? (int32)EConvaiBlendshape::JawOpen : (int32)EConvaiViseme::aa;
+				OutNumCurves = 1;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Estimates the queued chunks in order on a worker thread, the frames are handed to the face sync on the game thread
+	void RunLocalLipSync(TSharedRef<FConvaiLocalLipSync, ESPMode::ThreadSafe> State, TWeakObjectPtr<UConvaiFaceSyncComponent> WeakFaceSync)
+	{
+		if (State->bWorkerActive.exchange(true))
+			return;
+
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [State, WeakFaceSync]
+		{
+			do
+			{
+				FConvaiLocalLipSync::FChunk Chunk;
+				while (State->PendingChunks.Dequeue(Chunk))
+				{
+					if (Chunk.Generation != State->Generation.load())
+						continue;
+
+					if (Chunk.Generation != State->EstimatorGeneration)
+					{
+						State->Estimator.Reset();
+						State->EstimatorGeneration = Chunk.Generation;
+					}
+
+					FAnimationSequence Sequence;
+					State->Estimator.Process(Chunk.PCM.GetData(), Chunk.PCM.Num() / Chunk.NumChannels, Chunk.NumChannels, Chunk.SampleRate, Chunk.CurveSet, Sequence.AnimationFrames);
+					if (Sequence.AnimationFrames.Num() == 0)
+						continue;
+					Sequence.Duration = Sequence.AnimationFrames.Num() * FConvaiVisemeEstimator::GetFrameDuration();
+
+					AsyncTask(ENamedThreads::GameThread, [State, WeakFaceSync, Generation = Chunk.Generation, Sequence = MoveTemp(Sequence)]
+					{
+						UConvaiFaceSyncComponent* FaceSync = WeakFaceSync.Get();
+						if (FaceSync && Generation == State->Generation.load())
+							FaceSync->ConvaiProcessLipSyncAdvanced(nullptr, 0, 0, 0, Sequence);
+					});
+				}
+
+				State->bWorkerActive.store(false);
+
+				// A chunk queued after the drain and before the flag was cleared found the worker busy
+			} while (!State->PendingChunks.IsEmpty() && !State->bWorkerActive.exchange(true));
+		});
+	}
+
+	// Helper function: Creates zero blendshapes
+	FConvaiFaceCurves CreateZeroBlendshapes()
+	{
+		return FConvaiFaceCurves(EConvaiFaceCurveSet::Blendshapes);
+	}
+	
+	// Helper function: Creates zero visemes
+	FConvaiFaceCurves CreateZeroVisemes()
+	{
+		FConvaiFaceCurves ZeroVisemes(EConvaiFaceCurveSet::Visemes);
+		ZeroVisemes[EConvaiViseme::sil] = 1;
+		return ZeroVisemes;
+	}
+
 
 	float Calculate1DBezierCurve(float t, float P0, float P1, float P2, float P3)
 	{
@@ -45,14 +208,18 @@ namespace
 };
 
 
-const TMap<FName, float> UConvaiFaceSyncComponent::ZeroBlendshapeFrame = CreateZeroBlendshapes();
-const TMap<FName, float> UConvaiFaceSyncComponent::ZeroVisemeFrame = CreateZeroVisemes();
+const FConvaiFaceCurves UConvaiFaceSyncComponent::ZeroBlendshapeCurves = CreateZeroBlendshapes();
+const FConvaiFaceCurves UConvaiFaceSyncComponent::ZeroVisemeCurves = CreateZeroVisemes();
+const TMap<FName, float> UConvaiFaceSyncComponent::ZeroBlendshapeFrame = CreateZeroBlendshapesMap();
+const TMap<FName, float> UConvaiFaceSyncComponent::ZeroVisemeFrame = CreateZeroVisemesMap();
 
 UConvaiFaceSyncComponent::UConvaiFaceSyncComponent()
 {
+	// Evaluated by the face sync subsystem, only ticks itself in worlds without one
 	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 	CurrentSequenceTimePassed = 0;
-	//CurrentBlendShapesMap = ZeroBlendshapeFrame;
+	//CurrentFrame = ZeroBlendshapeCurves;
 }
 
 UConvaiFaceSyncComponent::~UConvaiFaceSyncComponent() // Implement destructor
@@ -63,7 +230,23 @@ UConvaiFaceSyncComponent::~UConvaiFaceSyncComponent() // Implement destructor
 void UConvaiFaceSyncComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	CurrentBlendShapesMap = GenerateZeroFrame();
+	SetCurrentFrametoZero();
+
+	UWorld* World = GetWorld();
+	FaceSyncSubsystem = World ? World->GetSubsystem<UConvaiFaceSyncSubsystem>() : nullptr;
+	if (FaceSyncSubsystem)
+		RequestFaceSyncUpdate();
+	else
+		SetComponentTickEnabled(true);
+}
+
+void UConvaiFaceSyncComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (FaceSyncSubsystem)
+		FaceSyncSubsystem->RemoveFaceSync(this);
+	FaceSyncSubsystem = nullptr;
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickType,
@@ -71,78 +254,111 @@ void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	UpdateLipSyncLOD();
+	if (EvaluateFaceSync(GetSequenceDeltaTime(DeltaTime)))
+	{
+		// Trigger the blueprint event
+		OnVisemesDataReady.ExecuteIfBound();
+	}
+}
+
+bool UConvaiFaceSyncComponent::EvaluateFaceSync(float SequenceDeltaTime, float& InOutPendingTime)
+{
+	// Lower tiers gather the time and evaluate less often
+	InOutPendingTime += SequenceDeltaTime;
+	if (InOutPendingTime < LipSyncLODUpdateIntervals[(int32)LipSyncLOD])
+		return false;
+	SequenceDeltaTime = InOutPendingTime;
+	InOutPendingTime = 0;
+
+	SequenceCriticalSection.Lock();
+
 	// Interpolate blendshapes and advance animation sequence
-	if (IsValidSequence(MainSequenceBuffer))
+	if (HasMainSequence())
 	{
-		SequenceCriticalSection.Lock();
-		CurrentSequenceTimePassed += DeltaTime;
+		CurrentSequenceTimePassed += SequenceDeltaTime;
 
-		if (CurrentSequenceTimePassed > MainSequenceBuffer.Duration && Stopping)
+		if (CurrentSequenceTimePassed > MainSequenceDuration && Stopping)
 		{
 			CurrentSequenceTimePassed = 0;
 			ClearMainSequence();
 			SetCurrentFrametoZero();
-			OnVisemesDataReady.ExecuteIfBound();
 			Stopping = false;
 			SequenceCriticalSection.Unlock();
-			return;
+			return true;
 		}
-		else if (CurrentSequenceTimePassed > MainSequenceBuffer.Duration && !Stopping)
+		else if (CurrentSequenceTimePassed > MainSequenceDuration && !Stopping)
 		{
 			Stopping = true;
-			ConvaiStopLipSync();
+			FadeOutMainSequence();
 		}
 
 		// Calculate frame duration and offsets
-		float FrameDuration = MainSequenceBuffer.Duration / MainSequenceBuffer.AnimationFrames.Num();
+		float FrameDuration = MainSequenceDuration / MainSequenceFrames.Num();
 		float FrameOffset = FrameDuration * 0.5f;
 
-		TMap<FName, float> StartFrame;
-		TMap<FName, float> EndFrame;
+		// Frames are interpolated in place, the lock keeps them alive against appends from the network thread
+		const FConvaiFaceCurves* StartFrame;
+		const FConvaiFaceCurves* EndFrame;
 		float Alpha;
+		int32 NumConsumedFrames = 0;
 
 		// Choose the current and next BlendShapes
 		if (CurrentSequenceTimePassed <= FrameOffset)
 		{
 			//StartFrame = ZeroBlendshapeFrame;
-			StartFrame = GetCurrentFrame();
-			EndFrame = MainSequenceBuffer.AnimationFrames[0].BlendShapes;
+			StartFrame = &CurrentFrame;
+			EndFrame = &MainSequenceFrames[0].BlendShapes;
 			Alpha = CurrentSequenceTimePassed / FrameOffset + 0.5;
 		}
-		else if (CurrentSequenceTimePassed >= MainSequenceBuffer.Duration - FrameOffset)
+		else if (CurrentSequenceTimePassed >= MainSequenceDuration - FrameOffset)
 		{
-			int LastFrameIdx = MainSequenceBuffer.AnimationFrames.Num() - 1;
-			StartFrame = MainSequenceBuffer.AnimationFrames[LastFrameIdx].BlendShapes;
-			EndFrame = GenerateZeroFrame();
-			Alpha = (CurrentSequenceTimePassed - (MainSequenceBuffer.Duration - FrameOffset)) / FrameOffset;
+			StartFrame = &MainSequenceFrames.Last().BlendShapes;
+			EndFrame = &GetZeroCurves();
+			Alpha = (CurrentSequenceTimePassed - (MainSequenceDuration - FrameOffset)) / FrameOffset;
 		}
 		else
 		{
 			int CurrentFrameIndex = FMath::FloorToInt((CurrentSequenceTimePassed - FrameOffset) / FrameDuration);
-			CurrentFrameIndex = FMath::Min(CurrentFrameIndex, MainSequenceBuffer.AnimationFrames.Num() - 1);
-			int NextFrameIndex = FMath::Min(CurrentFrameIndex + 1, MainSequenceBuffer.AnimationFrames.Num() - 1);
-			StartFrame = MainSequenceBuffer.AnimationFrames[CurrentFrameIndex].BlendShapes;
-			EndFrame = MainSequenceBuffer.AnimationFrames[NextFrameIndex].BlendShapes;
+			CurrentFrameIndex = FMath::Min(CurrentFrameIndex, MainSequenceFrames.Num() - 1);
+			int NextFrameIndex = FMath::Min(CurrentFrameIndex + 1, MainSequenceFrames.Num() - 1);
+			StartFrame = &MainSequenceFrames[CurrentFrameIndex].BlendShapes;
+			EndFrame = &MainSequenceFrames[NextFrameIndex].BlendShapes;
 			Alpha = (CurrentSequenceTimePassed - FrameOffset - (CurrentFrameIndex * FrameDuration)) / FrameDuration;
+
+			// Keep one played frame so the time never falls back into the lead-in from the current frame
+			NumConsumedFrames = CurrentFrameIndex - 1;
 		}
-		SequenceCriticalSection.Unlock();
 
 		//AnchorValue = FMath::Clamp(AnchorValue, 0, 1);
 		//Alpha = Calculate1DBezierCurve(Alpha, AnchorValue,0, 1-AnchorValue, 1);
 
-		CurrentBlendShapesMap = InterpolateFrames(StartFrame, EndFrame, Alpha);
+		const bool bFrameChanged = InterpolateFramesForLOD(*StartFrame, *EndFrame, Alpha, SequenceDeltaTime);
 
-		// Trigger the blueprint event
-		OnVisemesDataReady.ExecuteIfBound();
-	}	
+		// Release played frames and rebase the time on the first remaining one, the frame duration stays the same
+		if (NumConsumedFrames > 0)
+		{
+			const float ConsumedDuration = NumConsumedFrames * FrameDuration;
+			MainSequenceFrames.RemoveFront(NumConsumedFrames);
+			MainSequenceDuration -= ConsumedDuration;
+			CurrentSequenceTimePassed -= ConsumedDuration;
+		}
+		SequenceCriticalSection.Unlock();
+		return bFrameChanged;
+	}
+
+	SequenceCriticalSection.Unlock();
+	return false;
 }
 
 void UConvaiFaceSyncComponent::ConvaiProcessLipSyncAdvanced(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels, FAnimationSequence FaceSequence)
 {
 	SequenceCriticalSection.Lock();
-	MainSequenceBuffer.AnimationFrames.Append(FaceSequence.AnimationFrames);
-	MainSequenceBuffer.Duration += FaceSequence.Duration;
+	MainSequenceFrames.Append(FaceSequence.AnimationFrames);
+	MainSequenceDuration += FaceSequence.Duration;
 	SequenceCriticalSection.Unlock();
+
+	RequestFaceSyncUpdate();
 }
 
 void UConvaiFaceSyncComponent::ConvaiProcessLipSyncSingleFrame(FAnimationFrame FaceFrame, float Duration)
@@ -157,18 +373,194 @@ void UConvaiFaceSyncComponent::ConvaiProcessLipSyncSingleFrame(FAnimationFrame F
 
 	if (!GeneratesVisemesAsBlendshapes())
 	{
-		float* sil = FaceFrame.BlendShapes.Find("sil");
-		if (sil != nullptr && *sil < 0)
+		if (FaceFrame.BlendShapes.GetCurveSet() == EConvaiFaceCurveSet::Visemes && FaceFrame.BlendShapes[EConvaiViseme::sil] < 0)
 		{
 			ClearMainSequence();
 			Stopping = true;
+			SequenceCriticalSection.Unlock();
 			return;
 		}
 	}
 
-	MainSequenceBuffer.AnimationFrames.Add(FaceFrame);
-	MainSequenceBuffer.Duration += Duration;
+	MainSequenceFrames.Add(FaceFrame);
+	MainSequenceDuration += Duration;
+	SequenceCriticalSection.Unlock();
+
+	RequestFaceSyncUpdate();
+}
+
+float UConvaiFaceSyncComponent::GetSequenceDeltaTime(float DeltaTime, float& InOutLastVoiceTime) const
+{
+	const UConvaiAudioStreamer* Voice = VoiceSource.Get();
+	if (!Voice || !Voice->IsTalking)
+	{
+		InOutLastVoiceTime = -1;
+		return DeltaTime;
+	}
+
+	// The voice time counts what the audio thread rendered, so hitches, time dilation, buffering and concealed or skipped audio are all accounted for
+	const float VoiceTime = Voice->GetVoiceTimeElapsed();
+	const float VoiceDeltaTime = FMath::Max(VoiceTime - FMath::Max(InOutLastVoiceTime, 0.0f), 0.0f);
+	InOutLastVoiceTime = VoiceTime;
+	return VoiceDeltaTime;
+}
+
+void UConvaiFaceSyncComponent::ConvaiSetVoiceSource(UConvaiAudioStreamer* InVoiceSource)
+{
+	VoiceSource = InVoiceSource;
+	LastVoiceTime = -1;
+	if (FaceSyncSubsystem)
+		FaceSyncSubsystem->ResetVoiceClock(this);
+}
+
+void UConvaiFaceSyncComponent::RequestFaceSyncUpdate()
+{
+	if (FaceSyncSubsystem && !bFaceSyncActive.exchange(true))
+		FaceSyncSubsystem->ActivateFaceSync(this);
+}
+
+bool UConvaiFaceSyncComponent::TryDeactivateFaceSync()
+{
+	// Cleared before looking, so frames appended meanwhile are either seen here or queue the component again
+	bFaceSyncActive = false;
+
+	SequenceCriticalSection.Lock();
+	const bool bIdle = !HasMainSequence();
 	SequenceCriticalSection.Unlock();
+
+	if (!bIdle)
+		bFaceSyncActive = true;
+	return bIdle;
+}
+
+float UConvaiFaceSyncComponent::GetVoiceClock() const
+{
+	const UConvaiAudioStreamer* Voice = VoiceSource.Get();
+	return Voice && Voice->IsTalking ? Voice->GetVoiceTimeElapsed() : -1;
+}
+
+bool UConvaiFaceSyncComponent::InterpolateFramesForLOD(const FConvaiFaceCurves& StartFrame, const FConvaiFaceCurves& EndFrame, float Alpha, float DeltaTime)
+{
+	if (LODBlendRemaining <= 0)
+	{
+		if (LipSyncLOD == EConvaiLipSyncLOD::Full)
+		{
+			InterpolateFrames(StartFrame, EndFrame, Alpha, CurrentFrame);
+			return true;
+		}
+		if (LipSyncLOD == EConvaiLipSyncLOD::Off)
+			return false;
+	}
+
+	const FConvaiFaceCurves& ZeroFrame = GetZeroCurves();
+	const EConvaiFaceCurveSet CurveSet = ZeroFrame.GetCurveSet();
+	LODTargetFrame = ZeroFrame;
+
+	int32 FirstCurve, NumCurves;
+	GetLipSyncLODCurves(CurveSet, LipSyncLOD, FirstCurve, NumCurves);
+	if (NumCurves > 0)
+	{
+		const float* StartValues = StartFrame.GetCurveSet() == CurveSet ? StartFrame.GetData() : ZeroCurveValues;
+		const float* EndValues = EndFrame.GetCurveSet() == CurveSet ? EndFrame.GetData() : ZeroCurveValues;
+		LerpCurves(StartValues + FirstCurve, EndValues + FirstCurve, Alpha, LODTargetFrame.GetData() + FirstCurve, NumCurves);
+	}
+
+	if (LODBlendRemaining > 0 && CurrentFrame.GetCurveSet() == CurveSet)
+	{
+		const float Blend = FMath::Min(DeltaTime / LODBlendRemaining, 1.0f);
+		LODBlendRemaining -= DeltaTime;
+		LerpCurves(CurrentFrame.GetData(), LODTargetFrame.GetData(), Blend, CurrentFrame.GetData(), CurrentFrame.Num());
+	}
+	else
+	{
+		LODBlendRemaining = 0;
+		CurrentFrame = LODTargetFrame;
+	}
+
+	bCurrentFrameMapDirty = true;
+	return true;
+}
+
+void UConvaiFaceSyncComponent::UpdateLipSyncLOD()
+{
+	const EConvaiLipSyncLOD NewLOD = ComputeLipSyncLOD();
+	if (NewLOD == LipSyncLOD)
+		return;
+
+	UE_LOG(ConvaiFaceSyncLog, Verbose, TEXT("Lipsync LOD of %s: %d -> %d"), *GetNameSafe(GetOwner()), (int32)LipSyncLOD, (int32)NewLOD);
+	LipSyncLOD = NewLOD;
+	LODBlendRemaining = LipSyncLODBlendTime;
+}
+
+EConvaiLipSyncLOD UConvaiFaceSyncComponent::ComputeLipSyncLOD() const
+{
+	if (bLipSyncLODOverridden)
+		return LipSyncLODOverride;
+
+	if (!bEnableLipSyncLOD)
+		return EConvaiLipSyncLOD::Full;
+
+	// Nobody watches a dedicated server
+	if (GetNetMode() == NM_DedicatedServer)
+		return EConvaiLipSyncLOD::Off;
+
+	const AActor* Owner = GetOwner();
+	const UWorld* World = GetWorld();
+	if (!Owner || !World)
+		return EConvaiLipSyncLOD::Full;
+
+	// Sized for the local viewer that sees the character largest, every split-screen player has its own camera
+	const USceneComponent* Root = Owner->GetRootComponent();
+	const float Radius = Root ? Root->Bounds.SphereRadius : 0.0f;
+	float ScreenSize = -1;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		const APlayerCameraManager* CameraManager = PlayerController && PlayerController->IsLocalController() ? PlayerController->PlayerCameraManager : nullptr;
+		if (!CameraManager)
+			continue;
+
+		const float Distance = FMath::Max(FVector::Dist(CameraManager->GetCameraLocation(), Owner->GetActorLocation()), 1.0f);
+		const float HalfFOVTan = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(CameraManager->GetFOVAngle(), 1.0f, 170.0f) * 0.5f));
+		ScreenSize = FMath::Max(ScreenSize, Radius / (Distance * HalfFOVTan));
+	}
+
+	if (ScreenSize < 0)
+		return EConvaiLipSyncLOD::Full;
+
+	if (!Owner->WasRecentlyRendered(LipSyncLODRenderedTimeout))
+		return EConvaiLipSyncLOD::Off;
+
+	// Staying on a tier needs less screen size than entering it
+	auto IsAbove = [this, ScreenSize](float Threshold, EConvaiLipSyncLOD Tier)
+	{
+		return ScreenSize >= (LipSyncLOD <= Tier ? Threshold * LipSyncLODHysteresis : Threshold);
+	};
+
+	if (IsAbove(MouthOnlyScreenSize, EConvaiLipSyncLOD::Full))
+		return EConvaiLipSyncLOD::Full;
+	if (IsAbove(JawOnlyScreenSize, EConvaiLipSyncLOD::MouthOnly))
+		return EConvaiLipSyncLOD::MouthOnly;
+	if (IsAbove(OffScreenSize, EConvaiLipSyncLOD::JawOnly))
+		return EConvaiLipSyncLOD::JawOnly;
+	return EConvaiLipSyncLOD::Off;
+}
+
+void UConvaiFaceSyncComponent::SetLipSyncLODOverride(EConvaiLipSyncLOD LOD)
+{
+	bLipSyncLODOverridden = true;
+	LipSyncLODOverride = LOD;
+}
+
+void UConvaiFaceSyncComponent::ClearLipSyncLODOverride()
+{
+	bLipSyncLODOverridden = false;
+}
+
+bool UConvaiFaceSyncComponent::ConvaiIsFaceDataNeeded()
+{
+	UpdateLipSyncLOD();
+	return LipSyncLOD != EConvaiLipSyncLOD::Off;
 }
 
 bool UConvaiFaceSyncComponent::IsValidSequence(const FAnimationSequence &Sequence)
@@ -182,33 +574,127 @@ bool UConvaiFaceSyncComponent::IsValidSequence(const FAnimationSequence &Sequenc
 void UConvaiFaceSyncComponent::ClearMainSequence()
 {
 	SequenceCriticalSection.Lock();
-	MainSequenceBuffer.AnimationFrames.Empty();
-	MainSequenceBuffer.Duration = 0;
+	MainSequenceFrames.Reset();
+	MainSequenceDuration = 0;
 	SequenceCriticalSection.Unlock();
 }
 
 TMap<FName, float> UConvaiFaceSyncComponent::InterpolateFrames(const TMap<FName, float>& StartFrame, const TMap<FName, float>& EndFrame, float Alpha)
 {
-	const TArray<FString>& CurveNames = GeneratesVisemesAsBlendshapes() ? ConvaiConstants::BlendShapesNames : ConvaiConstants::VisemeNames;
-	TMap<FName, float> Result;
-	for (const auto& CurveName : CurveNames)
+	const EConvaiFaceCurveSet CurveSet = GeneratesVisemesAsBlendshapes() ? EConvaiFaceCurveSet::Blendshapes : EConvaiFaceCurveSet::Visemes;
+	FConvaiFaceCurves StartCurves(CurveSet);
+	FConvaiFaceCurves EndCurves(CurveSet);
+	StartCurves.FromMap(StartFrame);
+	EndCurves.FromMap(EndFrame);
+
+	FConvaiFaceCurves Result;
+	InterpolateFrames(StartCurves, EndCurves, Alpha, Result);
+	return Result.ToMap();
+}
+
+void UConvaiFaceSyncComponent::InterpolateFrames(const FConvaiFaceCurves& StartFrame, const FConvaiFaceCurves& EndFrame, float Alpha, FConvaiFaceCurves& OutFrame)
+{
+	const EConvaiFaceCurveSet CurveSet = GeneratesVisemesAsBlendshapes() ? EConvaiFaceCurveSet::Blendshapes : EConvaiFaceCurveSet::Visemes;
+	const float* StartValues = StartFrame.GetCurveSet() == CurveSet ? StartFrame.GetData() : ZeroCurveValues;
+	const float* EndValues = EndFrame.GetCurveSet() == CurveSet ? EndFrame.GetData() : ZeroCurveValues;
+
+	// A layout switch only happens when an input is of another layout, so resetting never clobbers a used input
+	if (OutFrame.GetCurveSet() != CurveSet)
 	{
-		float StartValue = StartFrame.Contains(*CurveName) ? StartFrame[*CurveName] : 0.0;
-		float EndValue = EndFrame.Contains(*CurveName) ? EndFrame[*CurveName] : 0.0;
-		Result.Add(*CurveName, FMath::Lerp(StartValue, EndValue, Alpha));
+		OutFrame.Reset(CurveSet);
+	}
+
+	LerpCurves(StartValues, EndValues, Alpha, OutFrame.GetData(), OutFrame.Num());
+
+	if (&OutFrame == &CurrentFrame)
+	{
+		bCurrentFrameMapDirty = true;
 	}
-	return Result;
+}
+
+const TMap<FName, float>& UConvaiFaceSyncComponent::GetCurrentFrameMap()
+{
+	if (!bCurrentFrameMapDirty)
+		return CurrentFrameMap;
+	bCurrentFrameMapDirty = false;
+
+	const TArray<FName>& CurveNames = FConvaiFaceCurves::GetCurveNames(CurrentFrame.GetCurveSet());
+	if (CurrentFrameMap.Num() != CurveNames.Num())
+	{
+		CurrentFrameMap = CurrentFrame.ToMap();
+		return CurrentFrameMap;
+	}
+
+	// Keys were added in curve order and are never removed, so the values line up with the curve indices
+	int32 Index = 0;
+	for (auto& Curve : CurrentFrameMap)
+	{
+		Curve.Value = CurrentFrame[Index++];
+	}
+	return CurrentFrameMap;
+}
+
+const TMap<FName, float>& UConvaiFaceSyncComponent::GetMappedFrameMap(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset)
+{
+	if (BlendshapeRemap.Update(CurrentFrame.GetCurveSet(), BlendshapeMap, GlobalMultiplier, GlobalOffset))
+	{
+		const TArray<FName>& TargetNames = BlendshapeRemap.GetTargetNames();
+		MappedFrameMap.Empty(TargetNames.Num());
+		for (const FName TargetName : TargetNames)
+		{
+			MappedFrameMap.Add(TargetName, 0);
+		}
+	}
+
+	BlendshapeRemap.Apply(CurrentFrame, MappedFrameValues);
+
+	// Keys were added in target order and are only replaced on recompile, so the values line up
+	int32 Index = 0;
+	for (auto& Curve : MappedFrameMap)
+	{
+		Curve.Value = MappedFrameValues[Index++];
+	}
+	return MappedFrameMap;
+}
+
+void UConvaiFaceSyncComponent::ConvaiProcessLipSync(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels)
+{
+	if (!bEstimateVisemesFromAudio || !InPCMData || InPCMDataSize < sizeof(int16) * InNumChannels || InSampleRate == 0 || InNumChannels == 0)
+		return;
+
+	if (!LocalLipSync.IsValid())
+		LocalLipSync = MakeShared<FConvaiLocalLipSync, ESPMode::ThreadSafe>();
+
+	FConvaiLocalLipSync::FChunk Chunk;
+	const int32 NumSamples = InPCMDataSize / (sizeof(int16) * InNumChannels) * InNumChannels;
+	Chunk.PCM.Append(reinterpret_cast<const int16*>(InPCMData), NumSamples);
+	Chunk.NumChannels = InNumChannels;
+	Chunk.SampleRate = InSampleRate;
+	Chunk.CurveSet = GetZeroCurves().GetCurveSet();
+	Chunk.Generation = LocalLipSync->Generation.load();
+	LocalLipSync->PendingChunks.Enqueue(MoveTemp(Chunk));
+
+	RunLocalLipSync(LocalLipSync.ToSharedRef(), this);
 }
 
 void UConvaiFaceSyncComponent::ConvaiStopLipSync()
+{
+	// Audio still waiting for the estimator belongs to the stopped voice
+	if (LocalLipSync.IsValid())
+		LocalLipSync->Generation++;
+
+	FadeOutMainSequence();
+}
+
+void UConvaiFaceSyncComponent::FadeOutMainSequence()
 {
 	CurrentSequenceTimePassed = 0;
 	ClearMainSequence();
 
-	FAnimationFrame CurrentFrame = FAnimationFrame();
-	CurrentFrame.BlendShapes = CurrentBlendShapesMap;
+	FAnimationFrame StoppingFrame = FAnimationFrame();
+	StoppingFrame.BlendShapes = CurrentFrame;
 	FAnimationSequence StoppingSequence;
 	StoppingSequence.Duration = 0.2;
-	StoppingSequence.AnimationFrames.Add(CurrentFrame);
+	StoppingSequence.AnimationFrames.Add(StoppingFrame);
 	ConvaiProcessLipSyncAdvanced(nullptr, 0, 0, 0, StoppingSequence);
 }
@@ -0,0 +1,133 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiFaceSyncSubsystem.h"
+#include "ConvaiFaceSync.h"
+#include "ConvaiDefinitions.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("FaceSync Evaluate"), STAT_ConvaiFaceSyncEvaluate, STATGROUP_Convai);
+
+namespace
+{
+	/** Below this many active components the evaluation runs inline, the task dispatch would cost more than it saves */
+	constexpr int32 FaceSyncMinParallelCount = 4;
+}
+
+void UConvaiFaceSyncSubsystem::Deinitialize()
+{
+	for (UConvaiFaceSyncComponent* Component : ActiveComponents)
+	{
+		if (IsValid(Component))
+			Component->FaceSyncSlot = INDEX_NONE;
+	}
+	ActiveComponents.Empty();
+	LastVoiceTimes.Empty();
+	PendingSequenceTimes.Empty();
+	PendingActivations.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UConvaiFaceSyncSubsystem::IsTickable() const
+{
+	return ActiveComponents.Num() > 0 || !PendingActivations.IsEmpty();
+}
+
+TStatId UConvaiFaceSyncSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UConvaiFaceSyncSubsystem, STATGROUP_Convai);
+}
+
+void UConvaiFaceSyncSubsystem::ActivateFaceSync(UConvaiFaceSyncComponent* Component)
+{
+	PendingActivations.Enqueue(Component);
+}
+
+void UConvaiFaceSyncSubsystem::RemoveFaceSync(UConvaiFaceSyncComponent* Component)
+{
+	if (Component && Component->FaceSyncSlot != INDEX_NONE)
+		RemoveSlot(Component->FaceSyncSlot);
+}
+
+void UConvaiFaceSyncSubsystem::ResetVoiceClock(const UConvaiFaceSyncComponent* Component)
+{
+	if (Component && Component->FaceSyncSlot != INDEX_NONE)
+		LastVoiceTimes[Component->FaceSyncSlot] = -1;
+}
+
+void UConvaiFaceSyncSubsystem::AddSlot(UConvaiFaceSyncComponent* Component)
+{
+	Component->FaceSyncSlot = ActiveComponents.Add(Component);
+	LastVoiceTimes.Add(Component->GetVoiceClock());
+	PendingSequenceTimes.Add(0);
+}
+
+void UConvaiFaceSyncSubsystem::RemoveSlot(int32 Slot)
+{
+	if (IsValid(ActiveComponents[Slot]))
+		ActiveComponents[Slot]->FaceSyncSlot = INDEX_NONE;
+
+	ActiveComponents.RemoveAtSwap(Slot);
+	LastVoiceTimes.RemoveAtSwap(Slot);
+	PendingSequenceTimes.RemoveAtSwap(Slot);
+
+	if (ActiveComponents.IsValidIndex(Slot) && IsValid(ActiveComponents[Slot]))
+		ActiveComponents[Slot]->FaceSyncSlot = Slot;
+}
+
+void UConvaiFaceSyncSubsystem::Tick(float DeltaTime)
+{
+	TWeakObjectPtr<UConvaiFaceSyncComponent> Pending;
+	while (PendingActivations.Dequeue(Pending))
+	{
+		UConvaiFaceSyncComponent* Component = Pending.Get();
+		if (IsValid(Component) && Component->FaceSyncSlot == INDEX_NONE)
+			AddSlot(Component);
+	}
+
+	for (int32 i = ActiveComponents.Num() - 1; i >= 0; i--)
+	{
+		if (!IsValid(ActiveComponents[i]))
+			RemoveSlot(i);
+	}
+
+	const int32 NumComponents = ActiveComponents.Num();
+	if (NumComponents == 0)
+		return;
+
+	// The voice clocks are read from UObjects, so on the game thread
+	SequenceDeltaTimes.SetNumUninitialized(NumComponents);
+	FramesChanged.SetNumUninitialized(NumComponents);
+	for (int32 i = 0; i < NumComponents; i++)
+	{
+		ActiveComponents[i]->UpdateLipSyncLOD();
+		SequenceDeltaTimes[i] = ActiveComponents[i]->GetSequenceDeltaTime(DeltaTime, LastVoiceTimes[i]);
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ConvaiFaceSyncEvaluate);
+		ParallelFor(NumComponents, [this](int32 i)
+		{
+			FramesChanged[i] = ActiveComponents[i]->EvaluateFaceSync(SequenceDeltaTimes[i], PendingSequenceTimes[i]);
+		}, NumComponents < FaceSyncMinParallelCount);
+	}
+
+	UpdatedComponents.Reset();
+	for (int32 i = NumComponents - 1; i >= 0; i--)
+	{
+		UConvaiFaceSyncComponent* Component = ActiveComponents[i];
+		if (FramesChanged[i])
+			UpdatedComponents.Add(Component);
+
+		// Swapping in the last slot keeps the slots below i, which are still to be visited, in place
+		if (Component->TryDeactivateFaceSync())
+			RemoveSlot(i);
+	}
+
+	// Listeners may destroy components, so they run once the list is consistent
+	for (const TWeakObjectPtr<UConvaiFaceSyncComponent>& Updated : UpdatedComponents)
+	{
+		if (UConvaiFaceSyncComponent* Component = Updated.Get())
+			Component->OnVisemesDataReady.ExecuteIfBound();
+	}
+}
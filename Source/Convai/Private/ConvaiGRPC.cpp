@@ -591,32 +591,34 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 
 			if (HasBlendshapes && GeneratesVisemesAsBlendshapes)
 			{
-				std::string FaceBlendshapeData = reply->audio_response().blendshapes_data().blendshape_data();
+				// Parsed from the UTF-8 bytes in place, the payload is never converted or copied
+				const std::string& FaceBlendshapeData = reply->audio_response().blendshapes_data().blendshape_data();
 				if (FaceBlendshapeData.size() > 0)
 				{
-					FString FaceData_string = UConvaiUtils::FUTF8ToFString(FaceBlendshapeData.c_str());
-					FaceDataAnimation.AnimationFrames = UConvaiUtils::ParseJsonToBlendShapeData(FaceData_string);
+					UConvaiUtils::ParseJsonToBlendShapeData(FaceBlendshapeData.data(), (int32)FaceBlendshapeData.size(), FaceDataAnimation.AnimationFrames);
 				}
 			}
 			else if (HasVisemes && !GeneratesVisemesAsBlendshapes)
 			{
 				auto Visemes = reply->audio_response().visemes_data().visemes();
 				FAnimationFrame AnimationFrame;
-				AnimationFrame.BlendShapes.Add("sil", Visemes.sil());
-				AnimationFrame.BlendShapes.Add("PP", Visemes.pp());
-				AnimationFrame.BlendShapes.Add("FF", Visemes.ff());
-				AnimationFrame.BlendShapes.Add("TH", Visemes.th());
-				AnimationFrame.BlendShapes.Add("DD", Visemes.dd());
-				AnimationFrame.BlendShapes.Add("kk", Visemes.kk());
-				AnimationFrame.BlendShapes.Add("CH", Visemes.ch());
-				AnimationFrame.BlendShapes.Add("SS", Visemes.ss());
-				AnimationFrame.BlendShapes.Add("nn", Visemes.nn());
-				AnimationFrame.BlendShapes.Add("RR", Visemes.rr());
-				AnimationFrame.BlendShapes.Add("aa", Visemes.aa());
-				AnimationFrame.BlendShapes.Add("E", Visemes.e());
-				AnimationFrame.BlendShapes.Add("ih", Visemes.ih());
-				AnimationFrame.BlendShapes.Add("oh", Visemes.oh());
-				AnimationFrame.BlendShapes.Add("ou", Visemes.ou());
+				FConvaiFaceCurves& Curves = AnimationFrame.BlendShapes;
+				Curves.Reset(EConvaiFaceCurveSet::Visemes);
+				Curves[EConvaiViseme::sil] = Visemes.sil();
+				Curves[EConvaiViseme::PP] = Visemes.pp();
+				Curves[EConvaiViseme::FF] = Visemes.ff();
+				Curves[EConvaiViseme::TH] = Visemes.th();
+				Curves[EConvaiViseme::DD] = Visemes.dd();
+				Curves[EConvaiViseme::kk] = Visemes.kk();
+				Curves[EConvaiViseme::CH] = Visemes.ch();
+				Curves[EConvaiViseme::SS] = Visemes.ss();
+				Curves[EConvaiViseme::nn] = Visemes.nn();
+				Curves[EConvaiViseme::RR] = Visemes.rr();
+				Curves[EConvaiViseme::aa] = Visemes.aa();
+				Curves[EConvaiViseme::E] = Visemes.e();
+				Curves[EConvaiViseme::ih] = Visemes.ih();
+				Curves[EConvaiViseme::oh] = Visemes.oh();
+				Curves[EConvaiViseme::ou] = Visemes.ou();
 				FaceDataAnimation.AnimationFrames.Add(AnimationFrame);
 				FaceDataAnimation.Duration += 0.01;
 				//UE_LOG(ConvaiGRPCLog, Log, TEXT("GetResponse FaceData: %s"), *AnimationFrame.ToString());
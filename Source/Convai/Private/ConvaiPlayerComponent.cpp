@@ -7,6 +7,7 @@
 #include "ConvaiActionUtils.h"
 #include "ConvaiUtils.h"
 #include "ConvaiDefinitions.h"
+#include "../Convai.h"
 
 #include "Net/UnrealNetwork.h"
 #include "Misc/FileHelper.h"
@@ -19,10 +20,24 @@
 #include "Sound/SoundWave.h"
 #include "AudioDevice.h"
 #include "AudioMixerDevice.h"
+#include "AudioThread.h"
+#include "Async/Async.h"
 
 
 DEFINE_LOG_CATEGORY(ConvaiPlayerLog);
 
+namespace
+{
+	/** Largest reference backlog kept in the ring, also the largest lead of the echo that reading ahead can make up for */
+	constexpr float EchoReferenceMaxBacklogSeconds = 0.25f;
+
+	/** Taps left in front of the estimated echo path, covers the resolution of the delay estimate */
+	constexpr int32 EchoDelayMargin = ConvaiConstants::EchoCancellerFilterLength / 8;
+
+	/** Smaller changes of the estimate are left to the filter, moving the reference resets it */
+	constexpr int32 EchoDelayTolerance = ConvaiConstants::EchoCancellerFilterLength / 4;
+}
+
 static FAudioDevice* GetAudioDeviceFromWorldContext(const UObject* WorldContextObject)
 {
 	UWorld* ThisWorld = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
@@ -130,6 +145,7 @@ bool UConvaiPlayerComponent::Init()
 
 	IsInit = true;
 	Token = 0;
+	InitPreRoll();
 	return true;
 }
 
@@ -253,7 +269,12 @@ bool UConvaiPlayerComponent::SetCaptureDeviceByIndex(int DeviceIndex)
 		return false;
 	}
 
-	return AudioCaptureComponent->SetCaptureDevice(DeviceIndex);
+	if (!AudioCaptureComponent->SetCaptureDevice(DeviceIndex))
+		return false;
+
+	// Audio from the previous device should not open the next turn
+	InitPreRoll();
+	return true;
 }
 
 bool UConvaiPlayerComponent::SetCaptureDeviceByName(FString DeviceName)
@@ -379,21 +400,22 @@ void UConvaiPlayerComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 		return;
 	}
 
+	UpdatePreRoll();
+	UpdateBargeInMonitoring();
 	UpdateVoiceCapture(DeltaTime);
 }
 
 void UConvaiPlayerComponent::UpdateVoiceCapture(float DeltaTime)
 {
-	if (IsRecording || IsStreaming) {
+	if (IsRecording || IsStreaming || IsMonitoringBargeIn || IsPreRolling) {
 		RemainingTimeUntilNextUpdate -= DeltaTime;
 		if (RemainingTimeUntilNextUpdate <= 0)
 		{
 			float ExpectedRecordingTime = DeltaTime > TIME_BETWEEN_VOICE_UPDATES_SECS ? DeltaTime : TIME_BETWEEN_VOICE_UPDATES_SECS;
-			FAudioThread::RunCommandOnAudioThread([this, ExpectedRecordingTime]()
-				{
-					StopVoiceChunkCapture();
-					StartVoiceChunkCapture(ExpectedRecordingTime);
-				});
+
+			// Only queues the work, the audio thread reads, resamples and echo cancels the chunk
+			StopVoiceChunkCapture();
+			StartVoiceChunkCapture(ExpectedRecordingTime);
 			RemainingTimeUntilNextUpdate = TIME_BETWEEN_VOICE_UPDATES_SECS;
 		}
 	}
@@ -405,27 +427,41 @@ void UConvaiPlayerComponent::UpdateVoiceCapture(float DeltaTime)
 
 void UConvaiPlayerComponent::StartVoiceChunkCapture(float ExpectedRecordingTime)
 {
-	//GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Yellow, FString::Printf(TEXT("StartVoiceChunkCapture() in VoiceCaptureComp.cpp")));
-	//UE_LOG(LogTemp, Warning, TEXT("StartVoiceChunkCapture() in VoiceCaptureComp.cpp"));
-	UAudioMixerBlueprintLibrary::StartRecordingOutput(this, ExpectedRecordingTime, Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix));
+	Audio::FMixerDevice* MixerDevice = GetAudioMixerDeviceFromWorldContext(this);
+	if (!MixerDevice)
+		return;
+
+	USoundSubmix* Submix = Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix);
+	RunOnCaptureThread([MixerDevice, Submix, ExpectedRecordingTime]()
+	{
+		MixerDevice->StartRecording(Submix, ExpectedRecordingTime);
+	});
 }
 
-void UConvaiPlayerComponent::ReadRecordedBuffer(Audio::AlignedFloatBuffer& RecordedBuffer, float& OutNumChannels, float& OutSampleRate)
+FConvaiVoiceCaptureMode UConvaiPlayerComponent::GetVoiceCaptureMode() const
 {
-	if (Audio::FMixerDevice* MixerDevice = GetAudioMixerDeviceFromWorldContext(this))
-	{
-		// call the thing here.
-		RecordedBuffer = MixerDevice->StopRecording(Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix), OutNumChannels, OutSampleRate);
+	FConvaiVoiceCaptureMode Mode;
+	Mode.bRecording = IsRecording;
+	Mode.bStreaming = IsStreaming;
+	Mode.bMonitoringBargeIn = IsMonitoringBargeIn;
+	Mode.bBargeInTurn = IsBargeInTurn;
+	Mode.bPreRolling = IsPreRolling;
+	Mode.bReplicate = ReplicateVoiceToNetwork;
+	Mode.bEchoCancellation = EnableEchoCancellation;
+	Mode.BargeInEndSilenceDuration = BargeInEndSilenceDuration;
+	return Mode;
+}
 
-		if (RecordedBuffer.Num() == 0)
-		{
-			//UE_LOG(ConvaiPlayerLog, Warning, TEXT("ReadRecordedBuffer: No audio data. Did you call Start Recording Output?"));
-		}
-	}
-	else
-	{
-		UE_LOG(ConvaiPlayerLog, Warning, TEXT("ReadRecordedBuffer: Could not get MixerDevice"));
-	}
+void UConvaiPlayerComponent::RunOnCaptureThread(TFunction<void()> Command)
+{
+	FAudioThread::RunCommandOnAudioThread(MoveTemp(Command));
+}
+
+void UConvaiPlayerComponent::WaitForCaptureThread()
+{
+	FAudioCommandFence Fence;
+	Fence.BeginFence();
+	Fence.Wait();
 }
 
 void UConvaiPlayerComponent::StartAudioCaptureComponent()
@@ -435,20 +471,129 @@ void UConvaiPlayerComponent::StartAudioCaptureComponent()
 
 void UConvaiPlayerComponent::StopAudioCaptureComponent()
 {
+	// The capture stays open to feed the pre-roll buffer
+	if (CanPreRoll())
+		return;
+
 	AudioCaptureComponent->Stop();
 }
 
+bool UConvaiPlayerComponent::CanPreRoll() const
+{
+	// Barge-in sizes the buffer too, but only the opt-in setting keeps the microphone open between turns
+	return Convai::Get().GetConvaiSettings()->MicrophonePreRollDuration > 0 && PreRollCapacity > 0 && IsValid(GetOwner()) && GetOwner()->HasLocalNetOwner();
+}
+
+int32 UConvaiPlayerComponent::GetDesiredPreRollSamples() const
+{
+	int32 PreRollDuration = Convai::Get().GetConvaiSettings()->MicrophonePreRollDuration;
+
+	// Barge-in needs room for the speech used to detect it
+	if (EnableBargeIn && EnableEchoCancellation)
+		PreRollDuration = FMath::Max(PreRollDuration, FMath::CeilToInt(BargeInMinSpeechDuration * 1000) + 200);
+
+	return ConvaiConstants::VoiceCaptureSampleRate * PreRollDuration / 1000;
+}
+
+void UConvaiPlayerComponent::InitPreRoll()
+{
+	PreRollCapacity = GetDesiredPreRollSamples();
+
+	const int32 Capacity = PreRollCapacity;
+	RunOnCaptureThread([this, Capacity]()
+	{
+		PreRollBuffer.SetNumUninitialized(Capacity);
+		PreRollWriteIndex = 0;
+		PreRollNum = 0;
+	});
+}
+
+void UConvaiPlayerComponent::UpdatePreRoll()
+{
+	// Follows the project setting and the barge-in properties when they change at runtime
+	if (PreRollCapacity != GetDesiredPreRollSamples())
+		InitPreRoll();
+
+	const bool ShouldPreRoll = CanPreRoll() && !IsStreaming && !IsRecording;
+
+	if (ShouldPreRoll && !IsPreRolling)
+	{
+		StartAudioCaptureComponent();
+		IsPreRolling = true;
+	}
+	else if (!ShouldPreRoll && IsPreRolling)
+	{
+		IsPreRolling = false;
+
+		// Pre-roll was turned off, close the microphone unless streaming, recording or barge-in took it over
+		if (!IsStreaming && !IsRecording && !IsMonitoringBargeIn)
+			StopAudioCaptureComponent();
+	}
+}
+
+void UConvaiPlayerComponent::PushPreRoll(const TArray<int16>& PCMData)
+{
+	const int32 Capacity = PreRollBuffer.Num();
+	if (Capacity == 0)
+		return;
+
+	// Only the newest samples can survive
+	const int32 NumToWrite = FMath::Min(PCMData.Num(), Capacity);
+	const int16* Source = PCMData.GetData() + PCMData.Num() - NumToWrite;
+
+	const int32 FirstPart = FMath::Min(NumToWrite, Capacity - PreRollWriteIndex);
+	FMemory::Memcpy(PreRollBuffer.GetData() + PreRollWriteIndex, Source, FirstPart * sizeof(int16));
+	FMemory::Memcpy(PreRollBuffer.GetData(), Source + FirstPart, (NumToWrite - FirstPart) * sizeof(int16));
+
+	PreRollWriteIndex = (PreRollWriteIndex + NumToWrite) % Capacity;
+	PreRollNum = FMath::Min(PreRollNum + NumToWrite, Capacity);
+}
+
+void UConvaiPlayerComponent::FlushPreRoll(bool bReplicate)
+{
+	if (PreRollNum == 0)
+		return;
+
+	const int32 Capacity = PreRollBuffer.Num();
+	const int32 ReadIndex = (PreRollWriteIndex - PreRollNum + Capacity) % Capacity;
+	const int32 FirstPart = FMath::Min(PreRollNum, Capacity - ReadIndex);
+
+	TArray<uint8> PreRollData;
+	PreRollData.SetNumUninitialized(PreRollNum * sizeof(int16));
+	FMemory::Memcpy(PreRollData.GetData(), PreRollBuffer.GetData() + ReadIndex, FirstPart * sizeof(int16));
+	FMemory::Memcpy(PreRollData.GetData() + FirstPart * sizeof(int16), PreRollBuffer.GetData(), (PreRollNum - FirstPart) * sizeof(int16));
+	PreRollNum = 0;
+
+	if (bReplicate)
+		AddPCMDataToSend(PreRollData, false, ConvaiConstants::VoiceCaptureSampleRate, 1);
+	else
+		VoiceCaptureRingBuffer.Enqueue(PreRollData.GetData(), PreRollData.Num());
+}
+
 void UConvaiPlayerComponent::StopVoiceChunkCapture()
 {
 	//USoundWave* SoundWaveMic = UAudioMixerBlueprintLibrary::StopRecordingOutput(this, EAudioRecordingExportType::SoundWave, "Convsound", "ConvSound", Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix));
 
+	Audio::FMixerDevice* MixerDevice = GetAudioMixerDeviceFromWorldContext(this);
+	if (!MixerDevice)
+	{
+		UE_LOG(ConvaiPlayerLog, Warning, TEXT("StopVoiceChunkCapture: Could not get MixerDevice"));
+		return;
+	}
+
+	USoundSubmix* Submix = Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix);
+	const FConvaiVoiceCaptureMode Mode = GetVoiceCaptureMode();
+	RunOnCaptureThread([this, MixerDevice, Submix, Mode]()
+	{
+		ProcessVoiceChunk(MixerDevice, Submix, Mode);
+	});
+}
+
+void UConvaiPlayerComponent::ProcessVoiceChunk(Audio::FMixerDevice* MixerDevice, USoundSubmix* Submix, const FConvaiVoiceCaptureMode& Mode)
+{
 	float NumChannels;
 	float SampleRate;
-	Audio::AlignedFloatBuffer RecordedBuffer = Audio::AlignedFloatBuffer();
-
-	ReadRecordedBuffer(RecordedBuffer, NumChannels, SampleRate);
-	//NumChannels = 2;
-	//SampleRate = ConvaiConstants::VoiceCaptureSampleRate;
+	Audio::AlignedFloatBuffer RecordedBuffer = MixerDevice->StopRecording(Submix, NumChannels, SampleRate);
 
 	if (RecordedBuffer.Num() == 0)
 		return;
@@ -470,15 +615,40 @@ void UConvaiPlayerComponent::StopVoiceChunkCapture()
 	//UE_LOG(ConvaiPlayerLog, Log, TEXT("Int16Buffer.GetNumSamples() %i, NumChannels %f,  SampleRate %f"), Int16Buffer.GetNumSamples(), NumChannels, SampleRate);
 	//UE_LOG(ConvaiPlayerLog, Log, TEXT("OutConverted.Num() %i"), OutConverted.Num());
 
-	if (IsRecording)
+	if (Mode.bStreaming || Mode.bMonitoringBargeIn)
+	{
+		const bool BargeInDetected = ProcessEchoCancellation(OutConverted, Mode);
+
+		if (Mode.bMonitoringBargeIn)
+		{
+			if (BargeInDetected)
+				BargeInDetectedPending = true;
+
+			// Nothing is sent until barge-in opens a new turn, the speech that triggered it is kept as pre-roll
+			PushPreRoll(OutConverted);
+			return;
+		}
+
+		if (Mode.bBargeInTurn && BargeInDetector.GetSilenceDuration() >= Mode.BargeInEndSilenceDuration)
+			BargeInTurnEndedPending = true;
+	}
+
+	// Keep the most recent audio while idle, it is sent at the start of the next turn
+	if (Mode.bPreRolling && !Mode.bStreaming && !Mode.bRecording)
+	{
+		PushPreRoll(OutConverted);
+		return;
+	}
+
+	if (Mode.bRecording)
 	{
 		VoiceCaptureBuffer.Append((uint8*)OutConverted.GetData(), OutConverted.Num() * sizeof(int16));
 		return;
 	}
 
-	if (!ReplicateVoiceToNetwork)
+	if (!Mode.bReplicate)
 	{
-		if (IsStreaming)
+		if (Mode.bStreaming)
 			VoiceCaptureRingBuffer.Enqueue((uint8*)OutConverted.GetData(), OutConverted.Num() * sizeof(int16));
 
 		onDataReceived_Delegate.ExecuteIfBound();
@@ -490,6 +660,265 @@ void UConvaiPlayerComponent::StopVoiceChunkCapture()
 	}
 }
 
+bool UConvaiPlayerComponent::ProcessEchoCancellation(TArray<int16>& InOutPCM, const FConvaiVoiceCaptureMode& Mode)
+{
+	const bool RunEchoCanceller = Mode.bEchoCancellation && CapturedEchoReference.IsValid() && CapturedEchoReference->IsAttached();
+
+	// Without a canceller the character's own voice leaking into the microphone would read as the player speaking over it
+	const bool RunBargeInDetector = (Mode.bMonitoringBargeIn && RunEchoCanceller) || Mode.bBargeInTurn;
+	const int32 NumSamples = InOutPCM.Num();
+
+	if ((!RunEchoCanceller && !RunBargeInDetector) || NumSamples == 0)
+		return false;
+
+	EchoMicScratch.SetNumUninitialized(NumSamples, false);
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		EchoMicScratch[i] = InOutPCM[i] / 32768.0f;
+	}
+	EchoMicOriginal = EchoMicScratch;
+
+	bool ReferenceActive = false;
+	if (RunEchoCanceller)
+	{
+		ReadEchoReference(NumSamples);
+
+		// Estimated on the reference as read, before the delay line
+		if (!EchoDelayEstimator.IsInitialized())
+			EchoDelayEstimator.Init(ConvaiConstants::VoiceCaptureSampleRate, FMath::RoundToInt(ConvaiConstants::VoiceCaptureSampleRate * EchoReferenceMaxBacklogSeconds), ConvaiConstants::EchoMaxBulkDelay + EchoDelayMargin);
+
+		if (EchoDelayEstimator.Process(EchoMicOriginal.GetData(), EchoReferenceDelayLine.GetData() + EchoReferenceDelayLine.Num() - NumSamples, NumSamples))
+			ApplyEchoDelay(EchoDelayEstimator.GetDelay());
+
+		EchoReferenceAligned.SetNumUninitialized(NumSamples, false);
+		const int32 AlignedStart = EchoReferenceDelayLine.Num() - NumSamples - EchoReferenceDelay;
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			const int32 Index = AlignedStart + i;
+			EchoReferenceAligned[i] = Index >= 0 ? EchoReferenceDelayLine[Index] : 0;
+		}
+
+		// Only the longest delay has to stay reachable, trimmed in bulk to keep the copies rare
+		if (EchoReferenceDelayLine.Num() > 2 * ConvaiConstants::EchoMaxBulkDelay)
+			EchoReferenceDelayLine.RemoveAt(0, EchoReferenceDelayLine.Num() - ConvaiConstants::EchoMaxBulkDelay, false);
+
+		for (int32 i = 0; i < NumSamples && !ReferenceActive; i++)
+		{
+			ReferenceActive = FMath::Abs(EchoReferenceAligned[i]) > 1e-3f;
+		}
+		EchoReferenceSilentSamples = ReferenceActive ? 0 : EchoReferenceSilentSamples + NumSamples;
+
+		// Skip the filter once its window only holds silence
+		if (EchoReferenceSilentSamples < ConvaiConstants::EchoCancellerFilterLength)
+		{
+			if (!EchoCanceller.IsInitialized())
+				EchoCanceller.Init(ConvaiConstants::EchoCancellerFilterLength);
+
+			EchoCanceller.Process(EchoMicScratch.GetData(), EchoReferenceAligned.GetData(), NumSamples);
+
+			for (int32 i = 0; i < NumSamples; i++)
+			{
+				InOutPCM[i] = (int16)FMath::Clamp(FMath::RoundToInt(EchoMicScratch[i] * 32768.0f), -32768, 32767);
+			}
+		}
+	}
+
+	if (RunBargeInDetector)
+		return BargeInDetector.Process(EchoMicOriginal.GetData(), EchoMicScratch.GetData(), NumSamples, ReferenceActive);
+
+	return false;
+}
+
+void UConvaiPlayerComponent::ReadEchoReference(int32 NumSamples)
+{
+	float* Out = EchoReferenceDelayLine.GetData() + EchoReferenceDelayLine.AddUninitialized(NumSamples);
+
+	const int32 ReferenceSampleRate = CapturedEchoReference->GetSampleRate();
+	if (ReferenceSampleRate <= 0)
+	{
+		FMemory::Memzero(Out, NumSamples * sizeof(float));
+		return;
+	}
+
+	TConvaiSPSCRingBuffer<int16>& Samples = CapturedEchoReference->Samples;
+	const float Step = float(ReferenceSampleRate) / float(ConvaiConstants::VoiceCaptureSampleRate);
+	const int32 Needed = FMath::FloorToInt(EchoReferencePhase + NumSamples * Step) + 1;
+
+	// Playback and capture share the mixer clock, so a growing backlog means the reference fell behind.
+	// Dropping it moves the echo later relative to the reference, the delay line makes up for that.
+	const uint32 MaxBacklog = uint32(ReferenceSampleRate * EchoReferenceMaxBacklogSeconds) + Needed;
+	const uint32 Backlog = Samples.Num();
+	if (Backlog > MaxBacklog)
+	{
+		Samples.CommitRead(Backlog - MaxBacklog);
+		EchoReferenceDelay = FMath::Min(EchoReferenceDelay + FMath::RoundToInt((Backlog - MaxBacklog) / Step), (int32)ConvaiConstants::EchoMaxBulkDelay);
+		EchoDelayEstimator.Reset();
+	}
+
+	EchoReferenceScratch.SetNumUninitialized(Needed + 1, false);
+	EchoReferenceScratch[0] = LastEchoReferenceSample;
+
+	TArrayView<const int16> First, Second;
+	const uint32 Available = Samples.GetReadRegions(First, Second, Needed);
+	int32 Index = 1;
+	for (const int16 Sample : First)
+		EchoReferenceScratch[Index++] = Sample / 32768.0f;
+	for (const int16 Sample : Second)
+		EchoReferenceScratch[Index++] = Sample / 32768.0f;
+	while (Index <= Needed)
+		EchoReferenceScratch[Index++] = 0;
+
+	// Linear interpolation down to the capture sample rate
+	float Position = EchoReferencePhase;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		const int32 Integer = (int32)Position;
+		Out[i] = FMath::Lerp(EchoReferenceScratch[Integer], EchoReferenceScratch[Integer + 1], Position - Integer);
+		Position += Step;
+	}
+
+	const int32 Consumed = FMath::Min((int32)Position, Needed);
+	EchoReferencePhase = Position - Consumed;
+	LastEchoReferenceSample = EchoReferenceScratch[Consumed];
+	Samples.CommitRead(FMath::Min((uint32)Consumed, Available));
+}
+
+void UConvaiPlayerComponent::ApplyEchoDelay(int32 EstimatedDelay)
+{
+	const int32 TargetDelay = EstimatedDelay - EchoDelayMargin;
+
+	// An echo leading the reference is never within the filter's reach, always corrected
+	if (EstimatedDelay >= 0 && FMath::Abs(TargetDelay - EchoReferenceDelay) < EchoDelayTolerance)
+		return;
+
+	if (TargetDelay >= 0)
+	{
+		EchoReferenceDelay = FMath::Min(TargetDelay, (int32)ConvaiConstants::EchoMaxBulkDelay);
+	}
+	else
+	{
+		TConvaiSPSCRingBuffer<int16>& Samples = CapturedEchoReference->Samples;
+		const uint32 Skip = (uint32)FMath::CeilToInt(-TargetDelay * float(CapturedEchoReference->GetSampleRate()) / ConvaiConstants::VoiceCaptureSampleRate);
+		Samples.CommitRead(FMath::Min(Skip, Samples.Num()));
+		EchoReferenceDelay = 0;
+
+		// The envelopes before and after the skip no longer line up
+		EchoDelayEstimator.Reset();
+	}
+
+	EchoCanceller.Reset();
+	UE_LOG(ConvaiPlayerLog, Verbose, TEXT("Echo delay estimated at %d ms, reference delayed by %d ms"), EstimatedDelay * 1000 / ConvaiConstants::VoiceCaptureSampleRate, EchoReferenceDelay * 1000 / ConvaiConstants::VoiceCaptureSampleRate);
+}
+
+void UConvaiPlayerComponent::SetEchoReferenceSource(UConvaiChatbotComponent* ChatbotComponent)
+{
+	TSharedPtr<FConvaiEchoReference, ESPMode::ThreadSafe> EchoReference = IsValid(ChatbotComponent) ? ChatbotComponent->GetEchoReference() : nullptr;
+	if (EchoReference.IsValid() && EchoReferenceSource.Get() == ChatbotComponent)
+		return;
+
+	EchoReferenceSource = EchoReference.IsValid() ? ChatbotComponent : nullptr;
+
+	RunOnCaptureThread([this, EchoReference]()
+	{
+		if (CapturedEchoReference.IsValid())
+			CapturedEchoReference->Detach();
+
+		CapturedEchoReference = EchoReference;
+
+		if (CapturedEchoReference.IsValid())
+			CapturedEchoReference->Attach();
+
+		EchoCanceller.Reset();
+		EchoDelayEstimator.Reset();
+		EchoReferenceDelayLine.Reset();
+		EchoReferenceDelay = 0;
+		EchoReferencePhase = 0;
+		LastEchoReferenceSample = 0;
+		EchoReferenceSilentSamples = 0;
+	});
+}
+
+void UConvaiPlayerComponent::InitBargeInDetector()
+{
+	const float ThresholdDb = BargeInThresholdDb;
+	const float MinSpeechDuration = BargeInMinSpeechDuration;
+	RunOnCaptureThread([this, ThresholdDb, MinSpeechDuration]()
+	{
+		BargeInDetector.Init(ConvaiConstants::VoiceCaptureSampleRate, ThresholdDb, MinSpeechDuration);
+	});
+}
+
+void UConvaiPlayerComponent::UpdateBargeInMonitoring()
+{
+	if (BargeInDetectedPending.exchange(false))
+		OnBargeInDetected();
+	if (BargeInTurnEndedPending.exchange(false))
+		OnBargeInTurnEnded();
+
+	UConvaiChatbotComponent* ChatbotComponent = LastTalkingParams.ChatbotComponent.Get();
+	const bool ShouldMonitor = EnableBargeIn && EnableEchoCancellation && IsValid(ChatbotComponent) && ChatbotComponent->GetIsTalking() && !IsStreaming && !IsRecording;
+
+	if (ShouldMonitor && !IsMonitoringBargeIn)
+		StartBargeInMonitoring();
+	else if (!ShouldMonitor && IsMonitoringBargeIn)
+		StopBargeInMonitoring();
+}
+
+void UConvaiPlayerComponent::StartBargeInMonitoring()
+{
+	StartAudioCaptureComponent();
+
+	// reset audio buffers
+	StartVoiceChunkCapture();
+	StopVoiceChunkCapture();
+
+	SetEchoReferenceSource(LastTalkingParams.ChatbotComponent.Get());
+	InitBargeInDetector();
+	IsMonitoringBargeIn = true;
+}
+
+void UConvaiPlayerComponent::StopBargeInMonitoring()
+{
+	IsMonitoringBargeIn = false;
+	StopVoiceChunkCapture();
+	StopAudioCaptureComponent();
+	SetEchoReferenceSource(nullptr);
+
+	// Without pre-roll the monitored audio would otherwise open a later, unrelated turn
+	if (!CanPreRoll())
+		InitPreRoll();
+}
+
+void UConvaiPlayerComponent::OnBargeInDetected()
+{
+	if (!IsMonitoringBargeIn)
+		return;
+
+	// Keep the capture component and echo reference running into the new turn
+	IsMonitoringBargeIn = false;
+
+	UConvaiChatbotComponent* ChatbotComponent = LastTalkingParams.ChatbotComponent.Get();
+	if (!IsValid(ChatbotComponent))
+	{
+		StopBargeInMonitoring();
+		return;
+	}
+
+	UE_LOG(ConvaiPlayerLog, Log, TEXT("Barge-in detected, interrupting the character"));
+	OnBargeInEvent.Broadcast(ChatbotComponent);
+
+	// StartGetResponseStream interrupts the character before opening the new turn
+	StartTalking(ChatbotComponent, LastTalkingParams.Environment.Get(), LastTalkingParams.GenerateActions, LastTalkingParams.VoiceResponse, LastTalkingParams.RunOnServer, LastTalkingParams.StreamPlayerMic, LastTalkingParams.UseServerAPI_Key);
+	IsBargeInTurn = IsStreaming;
+}
+
+void UConvaiPlayerComponent::OnBargeInTurnEnded()
+{
+	if (IsBargeInTurn && IsStreaming)
+		FinishTalking();
+	IsBargeInTurn = false;
+}
+
 void UConvaiPlayerComponent::StartRecording()
 {
 	if (IsRecording)
@@ -520,7 +949,10 @@ void UConvaiPlayerComponent::StartRecording()
 	// reset audio buffers
 	StartVoiceChunkCapture();
 	StopVoiceChunkCapture();
-	VoiceCaptureBuffer.Empty(ConvaiConstants::VoiceCaptureBufferSize);
+	RunOnCaptureThread([this]()
+	{
+		VoiceCaptureBuffer.Empty(ConvaiConstants::VoiceCaptureBufferSize);
+	});
 
 	IsRecording = true;
 }
@@ -536,6 +968,9 @@ USoundWave* UConvaiPlayerComponent::FinishRecording()
 	UE_LOG(ConvaiPlayerLog, Log, TEXT("Stopped Recording "));
 	StopVoiceChunkCapture();
 
+	// The last chunk is appended on the audio thread
+	WaitForCaptureThread();
+
 	USoundWave* OutSoundWave = UConvaiUtils::PCMDataToSoundWav(VoiceCaptureBuffer, 1, ConvaiConstants::VoiceCaptureSampleRate);
 	StopAudioCaptureComponent();  //stop the AudioCaptureComponent
 	if (IsValid(OutSoundWave))
@@ -590,6 +1025,14 @@ void UConvaiPlayerComponent::StartTalking(
 
 	UE_LOG(ConvaiPlayerLog, Log, TEXT("Started Talking"));
 
+	LastTalkingParams.ChatbotComponent = ConvaiChatbotComponent;
+	LastTalkingParams.Environment = Environment;
+	LastTalkingParams.GenerateActions = GenerateActions;
+	LastTalkingParams.VoiceResponse = VoiceResponse;
+	LastTalkingParams.RunOnServer = RunOnServer;
+	LastTalkingParams.StreamPlayerMic = StreamPlayerMic;
+	LastTalkingParams.UseServerAPI_Key = UseServerAPI_Key;
+
 	StartAudioCaptureComponent();    //Start the AudioCaptureComponent
 
 	// reset audio buffers
@@ -597,7 +1040,20 @@ void UConvaiPlayerComponent::StartTalking(
 	StopVoiceChunkCapture();
 
 	IsStreaming = true;
-	VoiceCaptureRingBuffer.Empty();
+
+	// The gRPC thread consumes the buffer, it drops the stale audio on its next read.
+	// Through the server the buffer is filled and reset there, on the game thread.
+	if (!RunOnServer)
+	{
+		RunOnCaptureThread([this]()
+		{
+			VoiceCaptureRingBuffer.RequestReset();
+		});
+	}
+
+	if (EnableEchoCancellation)
+		SetEchoReferenceSource(ConvaiChatbotComponent);
+	InitBargeInDetector();
 
 	ReplicateVoiceToNetwork = RunOnServer;
 	
@@ -605,16 +1061,26 @@ void UConvaiPlayerComponent::StartTalking(
 
 	if (RunOnServer)
 	{
-		if (IsValid(Environment))
-			StartTalkingServer(ConvaiChatbotComponent, true, Environment->Actions, Environment->Objects, Environment->Characters, Environment->MainCharacter, GenerateActions, VoiceResponse, StreamPlayerMic, UseServerAPI_Key, ClientAPI_Key);
+		// The character's own environment is already on the server, only its version is sent
+		const uint32 EnvironmentVersion = IsValid(ConvaiChatbotComponent) ? ConvaiChatbotComponent->GetServerEnvironmentVersion(Environment) : 0;
+		if (EnvironmentVersion != 0)
+			StartTalkingServer(ConvaiChatbotComponent, true, EnvironmentVersion, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, StreamPlayerMic, UseServerAPI_Key, ClientAPI_Key);
+		else if (IsValid(Environment))
+			StartTalkingServer(ConvaiChatbotComponent, true, 0, Environment->Actions, Environment->Objects, Environment->Characters, Environment->MainCharacter, GenerateActions, VoiceResponse, StreamPlayerMic, UseServerAPI_Key, ClientAPI_Key);
 		else
-			StartTalkingServer(ConvaiChatbotComponent, false, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, StreamPlayerMic, UseServerAPI_Key, ClientAPI_Key);
+			StartTalkingServer(ConvaiChatbotComponent, false, 0, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, StreamPlayerMic, UseServerAPI_Key, ClientAPI_Key);
 	}
 	else
 	{
 		bool UseOverrideAPI_Key = false;
 		ConvaiChatbotComponent->StartGetResponseStream(this, FString(""), Environment, GenerateActions, VoiceResponse, false, UseOverrideAPI_Key, FString(""), Token);
 	}
+
+	// Sent after the turn is opened so the server receives it in order
+	RunOnCaptureThread([this, RunOnServer]()
+	{
+		FlushPreRoll(RunOnServer);
+	});
 }
 
 void UConvaiPlayerComponent::FinishTalking()
@@ -628,6 +1094,8 @@ void UConvaiPlayerComponent::FinishTalking()
 	StopVoiceChunkCapture();
 	StopAudioCaptureComponent();  //stop the AudioCaptureComponent
 	IsStreaming = false;
+	IsBargeInTurn = false;
+	SetEchoReferenceSource(nullptr);
 
 	if (ReplicateVoiceToNetwork)
 	{
@@ -645,6 +1113,7 @@ void UConvaiPlayerComponent::FinishTalking()
 void UConvaiPlayerComponent::StartTalkingServer_Implementation(
 	class UConvaiChatbotComponent* ConvaiChatbotComponent,
 	bool EnvironemntSent,
+	uint32 EnvironmentVersion,
 	const TArray<FString>& Actions,
 	const TArray<FConvaiObjectEntry>& Objects,
 	const TArray<FConvaiObjectEntry>& Characters,
@@ -658,30 +1127,63 @@ void UConvaiPlayerComponent::StartTalkingServer_Implementation(
 	// if "StreamPlayerMic" is true then "bShouldMuteGlobal" should be false, meaning we will play the player's audio on other clients
 	bShouldMuteGlobal = !StreamPlayerMic;
 
-	// Make sure the ring buffer is empty
-	VoiceCaptureRingBuffer.Empty();
+	// Make sure the ring buffer is empty, the gRPC thread drops the stale audio on its next read
+	VoiceCaptureRingBuffer.RequestReset();
 
 	// if "ConvaiChatbotComponent" is valid then run StartGetResponseStream function
 	if (IsValid(ConvaiChatbotComponent))
 	{
-		UConvaiEnvironment* Environment = nullptr;
-		if (EnvironemntSent)
+		UConvaiEnvironment* Environment = ResolveServerEnvironment(ConvaiChatbotComponent, EnvironemntSent, EnvironmentVersion, Actions, Objects, Characters, MainCharacter);
+		bool UseOverrideAPI_Key = !UseServerAPI_Key;
+		ConvaiChatbotComponent->StartGetResponseStream(this, FString(""), Environment, GenerateActions, VoiceResponse, true, UseOverrideAPI_Key, ClientAPI_Key, Token);
+	}
+}
+
+UConvaiEnvironment* UConvaiPlayerComponent::ResolveServerEnvironment(
+	UConvaiChatbotComponent* ConvaiChatbotComponent,
+	bool EnvironemntSent,
+	uint32 EnvironmentVersion,
+	const TArray<FString>& Actions,
+	const TArray<FConvaiObjectEntry>& Objects,
+	const TArray<FConvaiObjectEntry>& Characters,
+	const FConvaiObjectEntry& MainCharacter)
+{
+	if (!EnvironemntSent)
+		return nullptr;
+
+	if (EnvironmentVersion != 0)
+	{
+		UConvaiEnvironment* Environment = ConvaiChatbotComponent->Environment;
+		if (!IsValid(Environment))
 		{
-			if (IsValid(ConvaiChatbotComponent->Environment))
-				Environment = ConvaiChatbotComponent->Environment;
-			else
-			{
-				Environment = UConvaiEnvironment::CreateConvaiEnvironment();
-			}
+			UE_LOG(ConvaiPlayerLog, Warning, TEXT("ResolveServerEnvironment: Environment of the character is not valid"));
+			return nullptr;
+		}
 
-			Environment->Actions = Actions;
-			Environment->Characters = Characters;
-			Environment->Objects = Objects;
-			Environment->MainCharacter = MainCharacter;
+		// The client can only hold an older copy of the server environment, the current one supersedes it
+		if (Environment->GetVersion() != EnvironmentVersion)
+		{
+			UE_LOG(ConvaiPlayerLog, Log, TEXT("ResolveServerEnvironment: client sent environment version %u, using the current version %u"), EnvironmentVersion, Environment->GetVersion());
 		}
-		bool UseOverrideAPI_Key = !UseServerAPI_Key;
-		ConvaiChatbotComponent->StartGetResponseStream(this, FString(""), Environment, GenerateActions, VoiceResponse, true, UseOverrideAPI_Key, ClientAPI_Key, Token);
+		return Environment;
 	}
+
+	UConvaiEnvironment* Environment;
+	if (IsValid(ConvaiChatbotComponent->Environment))
+		Environment = ConvaiChatbotComponent->Environment;
+	else
+	{
+		Environment = UConvaiEnvironment::CreateConvaiEnvironment();
+	}
+
+	FConvaiEnvironmentDetails Details;
+	Details.Actions = Actions;
+	Details.Characters = Characters;
+	Details.Objects = Objects;
+	Details.MainCharacter = MainCharacter;
+	Details.AttentionObject = Environment->AttentionObject;
+	Environment->SetFromEnvironment(Details);
+	return Environment;
 }
 
 void UConvaiPlayerComponent::FinishTalkingServer_Implementation()
@@ -720,10 +1222,14 @@ void UConvaiPlayerComponent::SendText(UConvaiChatbotComponent* ConvaiChatbotComp
 
 	if (RunOnServer)
 	{
-		if (IsValid(Environment))
-			SendTextServer(ConvaiChatbotComponent, Text, true, Environment->Actions, Environment->Objects, Environment->Characters, Environment->MainCharacter, GenerateActions, VoiceResponse, UseServerAPI_Key, ClientAPI_Key);
+		// The character's own environment is already on the server, only its version is sent
+		const uint32 EnvironmentVersion = ConvaiChatbotComponent->GetServerEnvironmentVersion(Environment);
+		if (EnvironmentVersion != 0)
+			SendTextServer(ConvaiChatbotComponent, Text, true, EnvironmentVersion, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, UseServerAPI_Key, ClientAPI_Key);
+		else if (IsValid(Environment))
+			SendTextServer(ConvaiChatbotComponent, Text, true, 0, Environment->Actions, Environment->Objects, Environment->Characters, Environment->MainCharacter, GenerateActions, VoiceResponse, UseServerAPI_Key, ClientAPI_Key);
 		else
-			SendTextServer(ConvaiChatbotComponent, Text, false, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, UseServerAPI_Key, ClientAPI_Key);
+			SendTextServer(ConvaiChatbotComponent, Text, false, 0, TArray<FString>(), TArray<FConvaiObjectEntry>(), TArray<FConvaiObjectEntry>(), FConvaiObjectEntry(), GenerateActions, VoiceResponse, UseServerAPI_Key, ClientAPI_Key);
 	}
 	else
 	{
@@ -739,6 +1245,7 @@ void UConvaiPlayerComponent::SendTextServer_Implementation(
 	UConvaiChatbotComponent* ConvaiChatbotComponent,
 	const FString& Text,
 	bool EnvironemntSent,
+	uint32 EnvironmentVersion,
 	const TArray<FString>& Actions,
 	const TArray<FConvaiObjectEntry>& Objects,
 	const TArray<FConvaiObjectEntry>& Characters,
@@ -754,18 +1261,8 @@ void UConvaiPlayerComponent::SendTextServer_Implementation(
 		return;
 	}
 
-	UConvaiEnvironment* Environment;
-	if (IsValid(ConvaiChatbotComponent->Environment))
-		Environment = ConvaiChatbotComponent->Environment;
-	else
-	{
-		Environment = UConvaiEnvironment::CreateConvaiEnvironment();
-	}
-
-	Environment->Actions = Actions;
-	Environment->Characters = Characters;
-	Environment->Objects = Objects;
-	Environment->MainCharacter = MainCharacter;
+	// Text requests always apply the environment they carry, even an empty one
+	UConvaiEnvironment* Environment = ResolveServerEnvironment(ConvaiChatbotComponent, true, EnvironmentVersion, Actions, Objects, Characters, MainCharacter);
 
 	bool UseOverrideAPI_Key = !UseServerAPI_Key;
 	ConvaiChatbotComponent->StartGetResponseStream(this, Text, Environment, GenerateActions, VoiceResponse, true, UseOverrideAPI_Key, ClientAPI_Key, Token);
@@ -822,14 +1319,30 @@ void UConvaiPlayerComponent::BeginPlay()
 	}
 }
 
+void UConvaiPlayerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Queued capture commands point to this component
+	if (IsInit)
+	{
+		SetEchoReferenceSource(nullptr);
+		WaitForCaptureThread();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 bool UConvaiPlayerComponent::ConsumeStreamingBuffer(TArray<uint8>& Buffer)
 {
-	int Datalength = VoiceCaptureRingBuffer.RingDataUsage();
-	if (Datalength <= 0)
+	TArrayView<const uint8> First, Second;
+	const uint32 Datalength = VoiceCaptureRingBuffer.GetReadRegions(First, Second);
+	if (Datalength == 0)
 		return false;
 
 	Buffer.SetNumUninitialized(Datalength, false);
-	VoiceCaptureRingBuffer.Dequeue(Buffer.GetData(), Datalength);
+	FMemory::Memcpy(Buffer.GetData(), First.GetData(), First.Num());
+	if (Second.Num() > 0)
+		FMemory::Memcpy(Buffer.GetData() + First.Num(), Second.GetData(), Second.Num());
+	VoiceCaptureRingBuffer.CommitRead(Datalength);
 
 	return true;
 }
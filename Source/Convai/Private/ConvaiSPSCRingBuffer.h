@@ -0,0 +1,290 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+#include <atomic>
+
+/**
+ * Lock-free single producer / single consumer ring buffer.
+ * Storage is allocated once and never zeroed, Reset() only moves the read index.
+ * The read and write indices live on separate cache lines so the producer and consumer threads do not false-share.
+ * Indices increase monotonically and are masked into the power of two sized storage.
+ */
+template< typename DataType >
+class TConvaiSPSCRingBuffer
+{
+	static_assert(TIsPODType<DataType>::Value, "TConvaiSPSCRingBuffer only supports trivially copyable types");
+
+public:
+	TConvaiSPSCRingBuffer();
+
+	explicit TConvaiSPSCRingBuffer(uint32 InMinCapacity);
+
+	~TConvaiSPSCRingBuffer();
+
+	TConvaiSPSCRingBuffer(const TConvaiSPSCRingBuffer&) = delete;
+	TConvaiSPSCRingBuffer& operator=(const TConvaiSPSCRingBuffer&) = delete;
+
+	/**
+	 * Allocates the storage, not thread-safe with respect to any other call.
+	 * @param InMinCapacity		Requested capacity, rounded up to the next power of two
+	 */
+	void Init(uint32 InMinCapacity);
+
+	/**
+	 * Discards all readable data in O(1). Consumer side only.
+	 */
+	void Reset();
+
+	/**
+	 * Discards everything written so far, from the producer side. Data written afterwards is kept.
+	 * The consumer drops the discarded data on its next GetReadRegions() or Dequeue(), Num() still counts it until then.
+	 */
+	void RequestReset();
+
+	/**
+	 * Copies as much of the buffer as fits into the free space. Producer side only.
+	 * @param ValBuf		The buffer pointer
+	 * @param BufLen		The length to copy
+	 * @return	the number of words actually written, data that does not fit is dropped
+	 */
+	uint32 Enqueue(const DataType* ValBuf, uint32 BufLen);
+
+	/**
+	 * Copies up to BufLen words out of the buffer. Consumer side only.
+	 * @param ValBuf		The buffer to receive the data
+	 * @param BufLen		The number of words requested
+	 * @return	the number of words actually copied
+	 */
+	uint32 Dequeue(DataType* ValBuf, uint32 BufLen);
+
+	/**
+	 * Returns up to two contiguous regions of free space. Producer side only.
+	 * Fill the regions in order then call CommitWrite() with the number of words written.
+	 * @param OutFirst		First region, starting at the write index
+	 * @param OutSecond		Wrapped around region, empty if not needed
+	 * @param MaxLen		Upper bound on the total size of the regions
+	 * @return	total number of words available in both regions
+	 */
+	uint32 GetWriteRegions(TArrayView<DataType>& OutFirst, TArrayView<DataType>& OutSecond, uint32 MaxLen = MAX_uint32);
+
+	/** Publishes NumWritten words previously written through GetWriteRegions(). Producer side only. */
+	void CommitWrite(uint32 NumWritten);
+
+	/**
+	 * Returns up to two contiguous regions of readable data. Consumer side only.
+	 * The regions stay valid until CommitRead() or Reset() is called.
+	 * @param OutFirst		First region, starting at the read index
+	 * @param OutSecond		Wrapped around region, empty if not needed
+	 * @param MaxLen		Upper bound on the total size of the regions
+	 * @return	total number of words available in both regions
+	 */
+	uint32 GetReadRegions(TArrayView<const DataType>& OutFirst, TArrayView<const DataType>& OutSecond, uint32 MaxLen = MAX_uint32);
+
+	/** Releases NumRead words previously read through GetReadRegions(). Consumer side only. */
+	void CommitRead(uint32 NumRead);
+
+	/** Number of words available to the consumer */
+	FORCEINLINE uint32 Num() const;
+
+	/** Number of words the producer can write without dropping data */
+	FORCEINLINE uint32 Slack() const;
+
+	/** Size of the storage in words */
+	FORCEINLINE uint32 Capacity() const { return CapacityMask + 1; }
+
+	FORCEINLINE bool IsEmpty() const { return Num() == 0; }
+
+private:
+	void Release();
+
+	/** Consumer side, moves the read index up to a reset requested by the producer */
+	void ApplyRequestedReset();
+
+	DataType* Data;
+	uint32 CapacityMask;
+
+	/** Only written by the consumer */
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> ReadIndex;
+
+	/** Only written by the producer */
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> WriteIndex;
+
+	/** Write index at the last RequestReset(), only written by the producer */
+	std::atomic<uint32> ResetIndex;
+
+	/** Set by the producer, cleared by the consumer */
+	std::atomic<bool> bResetRequested;
+};
+
+/* TConvaiSPSCRingBuffer implementation
+*****************************************************************************/
+template< typename DataType >
+TConvaiSPSCRingBuffer< DataType >::TConvaiSPSCRingBuffer()
+	: Data(nullptr)
+	, CapacityMask(0)
+	, ReadIndex(0)
+	, WriteIndex(0)
+	, ResetIndex(0)
+	, bResetRequested(false)
+{
+}
+
+template< typename DataType >
+TConvaiSPSCRingBuffer< DataType >::TConvaiSPSCRingBuffer(uint32 InMinCapacity)
+	: TConvaiSPSCRingBuffer()
+{
+	Init(InMinCapacity);
+}
+
+template< typename DataType >
+TConvaiSPSCRingBuffer< DataType >::~TConvaiSPSCRingBuffer()
+{
+	Release();
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::Release()
+{
+	if (Data)
+	{
+		FMemory::Free(Data);
+		Data = nullptr;
+	}
+	CapacityMask = 0;
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::Init(uint32 InMinCapacity)
+{
+	Release();
+
+	const uint32 Capacity = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(InMinCapacity, 2));
+	Data = (DataType*)FMemory::Malloc(Capacity * sizeof(DataType), PLATFORM_CACHE_LINE_SIZE);
+	CapacityMask = Capacity - 1;
+	ReadIndex.store(0, std::memory_order_relaxed);
+	ResetIndex.store(0, std::memory_order_relaxed);
+	bResetRequested.store(false, std::memory_order_relaxed);
+	WriteIndex.store(0, std::memory_order_release);
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::Reset()
+{
+	ReadIndex.store(WriteIndex.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::RequestReset()
+{
+	ResetIndex.store(WriteIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	bResetRequested.store(true, std::memory_order_release);
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::ApplyRequestedReset()
+{
+	if (!bResetRequested.exchange(false, std::memory_order_acquire))
+	{
+		return;
+	}
+
+	// The consumer may already have read past the mark, indices wrap so compare the signed difference
+	const uint32 Mark = ResetIndex.load(std::memory_order_relaxed);
+	const uint32 Current = ReadIndex.load(std::memory_order_relaxed);
+	if (static_cast<int32>(Mark - Current) > 0)
+	{
+		ReadIndex.store(Mark, std::memory_order_release);
+	}
+}
+
+template< typename DataType >
+FORCEINLINE uint32 TConvaiSPSCRingBuffer< DataType >::Num() const
+{
+	return WriteIndex.load(std::memory_order_acquire) - ReadIndex.load(std::memory_order_relaxed);
+}
+
+template< typename DataType >
+FORCEINLINE uint32 TConvaiSPSCRingBuffer< DataType >::Slack() const
+{
+	if (!Data)
+	{
+		return 0;
+	}
+	return Capacity() - (WriteIndex.load(std::memory_order_relaxed) - ReadIndex.load(std::memory_order_acquire));
+}
+
+template< typename DataType >
+uint32 TConvaiSPSCRingBuffer< DataType >::GetWriteRegions(TArrayView<DataType>& OutFirst, TArrayView<DataType>& OutSecond, uint32 MaxLen)
+{
+	const uint32 Total = FMath::Min(Slack(), MaxLen);
+	const uint32 Start = WriteIndex.load(std::memory_order_relaxed) & CapacityMask;
+	const uint32 FirstLen = FMath::Min(Total, Capacity() - Start);
+
+	OutFirst = TArrayView<DataType>(Data + Start, FirstLen);
+	OutSecond = TArrayView<DataType>(Data, Total - FirstLen);
+	return Total;
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::CommitWrite(uint32 NumWritten)
+{
+	check(NumWritten <= Slack());
+	WriteIndex.store(WriteIndex.load(std::memory_order_relaxed) + NumWritten, std::memory_order_release);
+}
+
+template< typename DataType >
+uint32 TConvaiSPSCRingBuffer< DataType >::GetReadRegions(TArrayView<const DataType>& OutFirst, TArrayView<const DataType>& OutSecond, uint32 MaxLen)
+{
+	ApplyRequestedReset();
+
+	const uint32 Total = FMath::Min(Num(), MaxLen);
+	const uint32 Start = ReadIndex.load(std::memory_order_relaxed) & CapacityMask;
+	const uint32 FirstLen = FMath::Min(Total, Capacity() - Start);
+
+	OutFirst = TArrayView<const DataType>(Data + Start, FirstLen);
+	OutSecond = TArrayView<const DataType>(Data, Total - FirstLen);
+	return Total;
+}
+
+template< typename DataType >
+void TConvaiSPSCRingBuffer< DataType >::CommitRead(uint32 NumRead)
+{
+	check(NumRead <= Num());
+	ReadIndex.store(ReadIndex.load(std::memory_order_relaxed) + NumRead, std::memory_order_release);
+}
+
+template< typename DataType >
+uint32 TConvaiSPSCRingBuffer< DataType >::Enqueue(const DataType* ValBuf, uint32 BufLen)
+{
+	TArrayView<DataType> First, Second;
+	const uint32 Written = GetWriteRegions(First, Second, BufLen);
+
+	FMemory::Memcpy(First.GetData(), ValBuf, First.Num() * sizeof(DataType));
+	if (Second.Num() > 0)
+	{
+		FMemory::Memcpy(Second.GetData(), ValBuf + First.Num(), Second.Num() * sizeof(DataType));
+	}
+
+	CommitWrite(Written);
+	return Written;
+}
+
+template< typename DataType >
+uint32 TConvaiSPSCRingBuffer< DataType >::Dequeue(DataType* ValBuf, uint32 BufLen)
+{
+	TArrayView<const DataType> First, Second;
+	const uint32 Read = GetReadRegions(First, Second, BufLen);
+
+	FMemory::Memcpy(ValBuf, First.GetData(), First.Num() * sizeof(DataType));
+	if (Second.Num() > 0)
+	{
+		FMemory::Memcpy(ValBuf + First.Num(), Second.GetData(), Second.Num() * sizeof(DataType));
+	}
+
+	CommitRead(Read);
+	return Read;
+}
@@ -0,0 +1,180 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiSoundWaveProcedural.h"
+#include "ConvaiEchoCanceller.h"
+#include "ConvaiDefinitions.h"
+
+namespace
+{
+	/** Smoothing of the inter-arrival jitter estimate, same gain as RFC 3550 */
+	constexpr float JitterSmoothing = 1.0f / 16.0f;
+
+	/** Target depth in multiples of the jitter estimate on top of the minimum depth */
+	constexpr float JitterDepthFactor = 2.0f;
+}
+
+UConvaiSoundWaveProcedural::UConvaiSoundWaveProcedural(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+	, QueuedBytes(0)
+	, ConsumedBytesAtStart(0)
+	, LastArrivalTime(0)
+	, LastChunkDuration(0)
+	, InterArrivalJitter(0)
+	, NumUnderruns(0)
+	, TargetDepthBytes(0)
+	, ConsumedBytes(0)
+	, StarvedBytes(0)
+	, bBuffering(true)
+	, BufferingBytes(0)
+{
+}
+
+int32 UConvaiSoundWaveProcedural::GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded)
+{
+	const int32 BytesNeeded = SamplesNeeded * sizeof(int16);
+	const int32 AvailableBytes = GetAvailableAudioByteCount();
+
+	if (bBuffering && AvailableBytes > 0)
+	{
+		// Start once the target depth is queued, or once we waited that long so a short final chunk is not held back
+		const int32 TargetBytes = TargetDepthBytes.load(std::memory_order_acquire);
+		if (AvailableBytes >= TargetBytes || BufferingBytes >= TargetBytes)
+			bBuffering = false;
+		else
+			BufferingBytes += BytesNeeded;
+	}
+
+	int32 BytesGenerated = 0;
+	if (!bBuffering)
+	{
+		BytesGenerated = FMath::Clamp(Super::GeneratePCMData(PCMData, SamplesNeeded), 0, BytesNeeded);
+		ConsumedBytes.fetch_add(BytesGenerated, std::memory_order_release);
+
+		if (BytesGenerated < BytesNeeded)
+		{
+			// Ran dry, hold back the output until the buffer refills
+			bBuffering = true;
+			BufferingBytes = 0;
+		}
+	}
+
+	// Fill the rest with silence and count it towards the end of speech
+	const int32 SilentBytes = BytesNeeded - BytesGenerated;
+	FMemory::Memzero(PCMData + BytesGenerated, SilentBytes);
+	StarvedBytes.store(BytesGenerated > 0 ? SilentBytes : StarvedBytes.load(std::memory_order_relaxed) + SilentBytes, std::memory_order_release);
+
+	if (EchoReference.IsValid() && NumChannels > 0)
+	{
+		const int32 SamplesGenerated = BytesGenerated / (int32)sizeof(int16);
+		EchoReference->PushRenderedAudio((const int16*)PCMData, SamplesGenerated, NumChannels, GetSampleRateForCurrentPlatform());
+		EchoReference->PushSilence((SamplesNeeded - SamplesGenerated) / NumChannels);
+	}
+
+	return BytesNeeded;
+}
+
+void UConvaiSoundWaveProcedural::QueueVoice(const uint8* AudioData, const int32 BufferSize)
+{
+	if (BufferSize <= 0)
+		return;
+
+	const double Now = FPlatformTime::Seconds();
+	const bool bNewUtterance = LastArrivalTime <= 0 || IsPlaybackFinished();
+
+	if (bNewUtterance)
+	{
+		ConsumedBytesAtStart = ConsumedBytes.load(std::memory_order_acquire);
+	}
+	else
+	{
+		// Only late chunks can starve the output, chunks arriving faster than real time are absorbed by the queue anyway
+		const float MaxDepth = ConvaiConstants::VoiceJitterBufferMaxDepth / 1000.0f;
+		const float Lateness = FMath::Clamp(float(Now - LastArrivalTime) - LastChunkDuration, 0.0f, MaxDepth);
+		InterArrivalJitter += (Lateness - InterArrivalJitter) * JitterSmoothing;
+
+		if (ConsumedBytes.load(std::memory_order_acquire) >= QueuedBytes)
+		{
+			NumUnderruns++;
+		}
+	}
+
+	const int32 BytesPerSecond = GetBytesPerSecond();
+	LastArrivalTime = Now;
+	LastChunkDuration = BytesPerSecond > 0 ? float(BufferSize) / BytesPerSecond : 0;
+	UpdateTargetDepth();
+
+	QueuedBytes += BufferSize;
+	QueueAudio(AudioData, BufferSize);
+}
+
+void UConvaiSoundWaveProcedural::ResetVoice()
+{
+	ResetAudio();
+
+	// Anything the render thread copied out concurrently is counted as played
+	QueuedBytes = ConsumedBytes.load(std::memory_order_acquire);
+	LastArrivalTime = 0;
+}
+
+void UConvaiSoundWaveProcedural::ResetForReuse()
+{
+	ResetVoice();
+
+	// Not playing, so the render thread state can be reset from here as well
+	bBuffering = true;
+	BufferingBytes = 0;
+	InterArrivalJitter = 0;
+	LastChunkDuration = 0;
+	NumUnderruns = 0;
+	UpdateTargetDepth();
+
+	Volume = 1.0f;
+	EchoReference.Reset();
+}
+
+bool UConvaiSoundWaveProcedural::IsPlaybackFinished() const
+{
+	return ConsumedBytes.load(std::memory_order_acquire) >= QueuedBytes
+		&& StarvedBytes.load(std::memory_order_acquire) >= TargetDepthBytes.load(std::memory_order_relaxed);
+}
+
+float UConvaiSoundWaveProcedural::GetRemainingDuration() const
+{
+	const int32 BytesPerSecond = GetBytesPerSecond();
+	if (BytesPerSecond <= 0)
+		return 0;
+	const int64 RemainingBytes = FMath::Max<int64>(QueuedBytes - ConsumedBytes.load(std::memory_order_acquire), 0);
+	return float(RemainingBytes) / BytesPerSecond;
+}
+
+float UConvaiSoundWaveProcedural::GetPlayedDuration() const
+{
+	const int32 BytesPerSecond = GetBytesPerSecond();
+	if (BytesPerSecond <= 0)
+		return 0;
+	const int64 PlayedBytes = FMath::Max<int64>(ConsumedBytes.load(std::memory_order_acquire) - ConsumedBytesAtStart, 0);
+	return float(PlayedBytes) / BytesPerSecond;
+}
+
+float UConvaiSoundWaveProcedural::GetTargetDepth() const
+{
+	const int32 BytesPerSecond = GetBytesPerSecond();
+	return BytesPerSecond > 0 ? float(TargetDepthBytes.load(std::memory_order_relaxed)) / BytesPerSecond : 0;
+}
+
+int32 UConvaiSoundWaveProcedural::GetBytesPerSecond() const
+{
+	return SampleRate * FMath::Max(NumChannels, 1) * sizeof(int16);
+}
+
+void UConvaiSoundWaveProcedural::UpdateTargetDepth()
+{
+	const float MinDepth = ConvaiConstants::VoiceJitterBufferMinDepth / 1000.0f;
+	const float MaxDepth = ConvaiConstants::VoiceJitterBufferMaxDepth / 1000.0f;
+	const float TargetDepth = FMath::Clamp(MinDepth + JitterDepthFactor * InterArrivalJitter, MinDepth, MaxDepth);
+
+	// Keep the target on a whole frame boundary
+	const int32 BlockAlign = FMath::Max(NumChannels, 1) * sizeof(int16);
+	const int32 TargetBytes = FMath::RoundToInt(TargetDepth * GetBytesPerSecond() / BlockAlign) * BlockAlign;
+	TargetDepthBytes.store(TargetBytes, std::memory_order_release);
+}
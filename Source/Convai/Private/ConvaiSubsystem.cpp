@@ -2,6 +2,10 @@
 
 #include "ConvaiSubsystem.h"
 #include "ConvaiAndroid.h"
+#include "ConvaiSoundWaveProcedural.h"
+#include "ConvaiDefinitions.h"
+#include "ConvaiAudioStreamer.h"
+#include "../Convai.h"
 #include "Engine/Engine.h"
 #include "Async/Async.h"
 
@@ -226,6 +230,9 @@ void UConvaiSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	gRPC_Runnable->StartStub();
 	UE_LOG(ConvaiSubsystemLog, Log, TEXT("UConvaiSubsystem Started"));
 
+	// Character voices arrive as 24 kHz mono
+	PrewarmVoiceWaves(24000, 1, ConvaiConstants::VoiceWavePoolPrewarmCount);
+
 	#if PLATFORM_ANDROID
 	GetAndroidMicPermission();
 	#endif
@@ -238,6 +245,10 @@ void UConvaiSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 void UConvaiSubsystem::Deinitialize()
 {
 	gRPC_Runnable->Exit();
+	FreeVoiceWaves.Empty();
+	VoiceRequests.Empty();
+	AudibleVoices.Empty();
+	CulledVoices.Empty();
 	Super::Deinitialize();
 	UE_LOG(ConvaiSubsystemLog, Log, TEXT("UConvaiSubsystem Stopped"));
 }
@@ -247,3 +258,146 @@ void UConvaiSubsystem::GetAndroidMicPermission()
 	if (!UConvaiAndroid::ConvaiAndroidHasMicrophonePermission())
 		UConvaiAndroid::ConvaiAndroidAskMicrophonePermission();
 }
+
+UConvaiSoundWaveProcedural* UConvaiSubsystem::AcquireVoiceWave(int32 SampleRate, int32 NumChannels)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double ReuseDelay = ConvaiConstants::VoiceWavePoolReuseDelay / 1000.0;
+
+	for (int32 i = 0; i < FreeVoiceWaves.Num(); i++)
+	{
+		UConvaiSoundWaveProcedural* Wave = FreeVoiceWaves[i].Wave;
+		if (!IsValid(Wave))
+		{
+			FreeVoiceWaves.RemoveAtSwap(i--);
+			continue;
+		}
+
+		if (Wave->GetSampleRateForCurrentPlatform() == SampleRate && Wave->NumChannels == NumChannels && Now - FreeVoiceWaves[i].ReleaseTime >= ReuseDelay)
+		{
+			FreeVoiceWaves.RemoveAtSwap(i);
+			Wave->ResetForReuse();
+			return Wave;
+		}
+	}
+
+	UE_LOG(ConvaiSubsystemLog, Verbose, TEXT("Voice wave pool has no idle wave for %d hz %d channels, creating one"), SampleRate, NumChannels);
+	return CreateVoiceWave(this, SampleRate, NumChannels);
+}
+
+void UConvaiSubsystem::ReleaseVoiceWave(UConvaiSoundWaveProcedural* Wave)
+{
+	if (!IsValid(Wave))
+		return;
+
+	int32 NumSameFormat = 0;
+	for (const FConvaiVoiceWavePoolEntry& Entry : FreeVoiceWaves)
+	{
+		if (Entry.Wave == Wave)
+			return;
+		if (IsValid(Entry.Wave) && Entry.Wave->GetSampleRateForCurrentPlatform() == Wave->GetSampleRateForCurrentPlatform() && Entry.Wave->NumChannels == Wave->NumChannels)
+			NumSameFormat++;
+	}
+
+	// Let the garbage collector have waves of formats that are rarely used at once
+	if (NumSameFormat >= ConvaiConstants::VoiceWavePoolMaxPerFormat)
+		return;
+
+	FConvaiVoiceWavePoolEntry& Entry = FreeVoiceWaves.AddDefaulted_GetRef();
+	Entry.Wave = Wave;
+	Entry.ReleaseTime = FPlatformTime::Seconds();
+}
+
+UConvaiSoundWaveProcedural* UConvaiSubsystem::CreateVoiceWave(UObject* Outer, int32 SampleRate, int32 NumChannels)
+{
+	UConvaiSoundWaveProcedural* Wave = NewObject<UConvaiSoundWaveProcedural>(Outer ? Outer : GetTransientPackage());
+	Wave->SetSampleRate(SampleRate);
+	Wave->NumChannels = NumChannels;
+	Wave->Duration = INDEFINITELY_LOOPING_DURATION;
+	Wave->SoundGroup = SOUNDGROUP_Voice;
+	Wave->bLooping = false;
+	Wave->bProcedural = true;
+	Wave->Pitch = 1.0f;
+	Wave->Volume = 1.0f;
+	Wave->AttenuationSettings = nullptr;
+	Wave->bDebug = true;
+	Wave->VirtualizationMode = EVirtualizationMode::PlayWhenSilent;
+	return Wave;
+}
+
+void UConvaiSubsystem::PrewarmVoiceWaves(int32 SampleRate, int32 NumChannels, int32 Count)
+{
+	for (int32 i = 0; i < Count; i++)
+	{
+		FConvaiVoiceWavePoolEntry& Entry = FreeVoiceWaves.AddDefaulted_GetRef();
+		Entry.Wave = CreateVoiceWave(this, SampleRate, NumChannels);
+	}
+}
+
+bool UConvaiSubsystem::RequestAudibleVoice(UConvaiAudioStreamer* Streamer, float Priority)
+{
+	if (VoiceBudgetFrame != GFrameCounter)
+	{
+		ResolveVoiceBudget();
+		VoiceBudgetFrame = GFrameCounter;
+	}
+
+	VoiceRequests.Emplace(Streamer, Priority);
+
+	const int32 MaxAudibleVoices = Convai::Get().GetConvaiSettings()->MaxAudibleVoices;
+	if (MaxAudibleVoices <= 0)
+		return true;
+
+	if (CulledVoices.Contains(Streamer))
+		return false;
+	if (AudibleVoices.Contains(Streamer))
+		return true;
+
+	// Not part of the last resolve, admitted now only if it fits or outranks the quietest audible voice, which the next resolve culls
+	if (AudibleVoices.Num() < MaxAudibleVoices || Priority > LowestAudiblePriority)
+	{
+		AudibleVoices.Add(Streamer);
+		return true;
+	}
+
+	CulledVoices.Add(Streamer);
+	return false;
+}
+
+void UConvaiSubsystem::ResolveVoiceBudget()
+{
+	AudibleVoices.Reset();
+	CulledVoices.Reset();
+	LowestAudiblePriority = 0;
+
+	const int32 MaxAudibleVoices = Convai::Get().GetConvaiSettings()->MaxAudibleVoices;
+	if (MaxAudibleVoices > 0)
+	{
+		VoiceRequests.Sort([](const TPair<TWeakObjectPtr<UConvaiAudioStreamer>, float>& A, const TPair<TWeakObjectPtr<UConvaiAudioStreamer>, float>& B)
+		{
+			return A.Value > B.Value;
+		});
+
+		// A streamer may have asked more than once, its highest priority comes first
+		for (const TPair<TWeakObjectPtr<UConvaiAudioStreamer>, float>& Request : VoiceRequests)
+		{
+			if (AudibleVoices.Contains(Request.Key) || CulledVoices.Contains(Request.Key))
+				continue;
+
+			if (AudibleVoices.Num() < MaxAudibleVoices)
+			{
+				AudibleVoices.Add(Request.Key);
+				LowestAudiblePriority = Request.Value;
+			}
+			else
+			{
+				CulledVoices.Add(Request.Key);
+			}
+		}
+
+		if (CulledVoices.Num() > 0)
+			UE_LOG(ConvaiSubsystemLog, Verbose, TEXT("Voice budget culled %d of %d voices"), CulledVoices.Num(), AudibleVoices.Num() + CulledVoices.Num());
+	}
+
+	VoiceRequests.Reset();
+}
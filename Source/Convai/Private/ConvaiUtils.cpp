@@ -761,13 +761,78 @@ FString UConvaiUtils::FUTF8ToFString(const char* StringToConvert)
 	return text_string;
 }
 
+namespace
+{
+	/**
+	 * Length of the longest common subsequence, bit-parallel (Hyyro): one bit per character of Pattern, one word update per character of Text.
+	 * Pattern is at most 64 characters.
+	 */
+	int32 LongestCommonSubsequence64(const FString& Pattern, const FString& Text)
+	{
+		uint64 AsciiMatches[128] = {};
+		TArray<TPair<TCHAR, uint64>, TInlineAllocator<8>> OtherMatches;
+		for (int32 i = 0; i < Pattern.Len(); i++)
+		{
+			const TCHAR Char = Pattern[i];
+			const uint64 Bit = uint64(1) << i;
+			if (static_cast<uint32>(Char) < 128)
+			{
+				AsciiMatches[Char] |= Bit;
+				continue;
+			}
+
+			TPair<TCHAR, uint64>* Found = OtherMatches.FindByPredicate([Char](const TPair<TCHAR, uint64>& Entry) { return Entry.Key == Char; });
+			if (Found)
+				Found->Value |= Bit;
+			else
+				OtherMatches.Emplace(Char, Bit);
+		}
+
+		// Zero bits of V mark the pattern positions that extend the common subsequence
+		uint64 V = ~uint64(0);
+		for (const TCHAR Char : Text)
+		{
+			uint64 Matches = 0;
+			if (static_cast<uint32>(Char) < 128)
+			{
+				Matches = AsciiMatches[Char];
+			}
+			else if (const TPair<TCHAR, uint64>* Found = OtherMatches.FindByPredicate([Char](const TPair<TCHAR, uint64>& Entry) { return Entry.Key == Char; }))
+			{
+				Matches = Found->Value;
+			}
+
+			const uint64 U = V & Matches;
+			V = (V + U) | (V - U);
+		}
+
+		const uint64 PatternMask = Pattern.Len() == 64 ? ~uint64(0) : (uint64(1) << Pattern.Len()) - 1;
+		return FMath::CountBits(~V & PatternMask);
+	}
+}
+
 int UConvaiUtils::LevenshteinDistance(const FString& s, const FString& t)
 {
 	// Degenerate cases
 	if (s == t) return 0;
+
+	return IndelDistance(s, t);
+}
+
+int32 UConvaiUtils::IndelDistance(const FString& s, const FString& t)
+{
 	if (s.Len() == 0) return t.Len();
 	if (t.Len() == 0) return s.Len();
 
+	// A substitution costs as much as a deletion and an insertion, so the distance is what is left outside the longest common subsequence
+	if (s.Len() <= 64 || t.Len() <= 64)
+	{
+		const bool bSIsShorter = s.Len() <= t.Len();
+		const FString& Pattern = bSIsShorter ? s : t;
+		const FString& Text = bSIsShorter ? t : s;
+		return s.Len() + t.Len() - 2 * LongestCommonSubsequence64(Pattern, Text);
+	}
+
 	// Create two work vectors of integer distances
 	TArray<int32> v0;
 	v0.Init(0, t.Len() + 1);
@@ -807,42 +872,351 @@ int UConvaiUtils::LevenshteinDistance(const FString& s, const FString& t)
 	return v1[t.Len()];
 }
 
-TArray<FAnimationFrame> UConvaiUtils::ParseJsonToBlendShapeData(const FString& JsonString)
+namespace
 {
-	TArray<FAnimationFrame> AnimationFrames;
-
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
-	TSharedPtr<FJsonValue> JsonParsed;
-	if (FJsonSerializer::Deserialize(Reader, JsonParsed) && JsonParsed.IsValid() && JsonParsed->Type == EJson::Array)
+	/**
+	 * Single pass reader for the blendshape payload, [{"FrameIndex": 0, "BlendShapes": [{"name": "JawOpen", "score": 0.1}, ...]}, ...].
+	 * Scores are written straight into the fixed curve layout, nothing is allocated besides the output frames.
+	 * Unknown keys are skipped, unknown curve names are ignored.
+	 */
+	template <typename CharType>
+	class TBlendShapeJsonReader
 	{
-		TArray<TSharedPtr<FJsonValue>> FrameArray = JsonParsed->AsArray();
-		for (auto FrameVal : FrameArray)
+	public:
+		TBlendShapeJsonReader(const CharType* InData, int32 InLength)
+			: Cursor(InData)
+			, End(InData + InLength)
+			, NextCurveIndex(0)
+		{
+		}
+
+		bool Read(TArray<FAnimationFrame>& OutFrames)
+		{
+			if (!Consume('['))
+				return false;
+			if (Consume(']'))
+				return true;
+
+			do
+			{
+				FAnimationFrame& Frame = OutFrames.AddDefaulted_GetRef();
+				Frame.BlendShapes.Reset(EConvaiFaceCurveSet::Blendshapes);
+				if (!ReadFrame(Frame))
+					return false;
+			} while (Consume(','));
+
+			return Consume(']');
+		}
+
+	private:
+		bool ReadFrame(FAnimationFrame& Frame)
+		{
+			if (!Consume('{'))
+				return false;
+			if (Consume('}'))
+				return true;
+
+			do
+			{
+				const CharType* Key;
+				int32 KeyLength;
+				if (!ReadString(Key, KeyLength) || !Consume(':'))
+					return false;
+
+				if (KeyEquals(Key, KeyLength, "FrameIndex"))
+				{
+					double FrameIndex;
+					if (!ReadNumber(FrameIndex))
+						return false;
+					Frame.FrameIndex = (int32)FrameIndex;
+				}
+				else if (KeyEquals(Key, KeyLength, "BlendShapes"))
+				{
+					if (!ReadBlendShapes(Frame.BlendShapes))
+						return false;
+				}
+				else if (!SkipValue())
+				{
+					return false;
+				}
+			} while (Consume(','));
+
+			return Consume('}');
+		}
+
+		bool ReadBlendShapes(FConvaiFaceCurves& Curves)
+		{
+			if (!Consume('['))
+				return false;
+			if (Consume(']'))
+				return true;
+
+			NextCurveIndex = 0;
+			do
+			{
+				if (!Consume('{'))
+					return false;
+
+				int32 CurveIndex = INDEX_NONE;
+				double Score = 0;
+				if (!Consume('}'))
+				{
+					do
+					{
+						const CharType* Key;
+						int32 KeyLength;
+						if (!ReadString(Key, KeyLength) || !Consume(':'))
+							return false;
+
+						if (KeyEquals(Key, KeyLength, "name"))
+						{
+							const CharType* Name;
+							int32 NameLength;
+							if (!ReadString(Name, NameLength))
+								return false;
+							CurveIndex = FindCurve(Name, NameLength);
+						}
+						else if (KeyEquals(Key, KeyLength, "score"))
+						{
+							// A score that is not a number counts as zero, as with the DOM reader
+							SkipWhitespace();
+							if (Cursor < End && (*Cursor == '-' || FChar::IsDigit((TCHAR)*Cursor)))
+							{
+								if (!ReadNumber(Score))
+									return false;
+							}
+							else if (!SkipValue())
+							{
+								return false;
+							}
+						}
+						else if (!SkipValue())
+						{
+							return false;
+						}
+					} while (Consume(','));
+
+					if (!Consume('}'))
+						return false;
+				}
+
+				if (CurveIndex != INDEX_NONE)
+					Curves[CurveIndex] = (float)Score;
+			} while (Consume(','));
+
+			return Consume(']');
+		}
+
+		/** Curves arrive in layout order, so the one after the last match is tried before the full scan */
+		int32 FindCurve(const CharType* Name, int32 NameLength)
+		{
+			const TArray<FString>& CurveNames = ConvaiConstants::BlendShapesNames;
+			const int32 NumCurves = CurveNames.Num();
+			for (int32 Offset = 0; Offset < NumCurves; Offset++)
+			{
+				const int32 Index = (NextCurveIndex + Offset) % NumCurves;
+				if (NameEquals(Name, NameLength, CurveNames[Index]))
+				{
+					NextCurveIndex = Index + 1;
+					return Index;
+				}
+			}
+			return INDEX_NONE;
+		}
+
+		// Curve names are matched case insensitively, as FName does
+		static bool NameEquals(const CharType* Name, int32 NameLength, const FString& CurveName)
+		{
+			if (NameLength != CurveName.Len())
+				return false;
+
+			const TCHAR* CurveChars = *CurveName;
+			for (int32 i = 0; i < NameLength; i++)
+			{
+				if (FChar::ToLower((TCHAR)Name[i]) != FChar::ToLower(CurveChars[i]))
+					return false;
+			}
+			return true;
+		}
+
+		static bool KeyEquals(const CharType* Key, int32 KeyLength, const ANSICHAR* Expected)
+		{
+			int32 i = 0;
+			for (; i < KeyLength; i++)
+			{
+				if (Expected[i] == '\0' || (TCHAR)Key[i] != (TCHAR)Expected[i])
+					return false;
+			}
+			return Expected[i] == '\0';
+		}
+
+		void SkipWhitespace()
+		{
+			while (Cursor < End && (*Cursor == ' ' || *Cursor == '\n' || *Cursor == '\r' || *Cursor == '\t'))
+				Cursor++;
+		}
+
+		bool Consume(CharType Expected)
+		{
+			SkipWhitespace();
+			if (Cursor < End && *Cursor == Expected)
+			{
+				Cursor++;
+				return true;
+			}
+			return false;
+		}
+
+		/** The returned span points into the payload and still holds any escapes, which no key or curve name uses */
+		bool ReadString(const CharType*& OutString, int32& OutLength)
+		{
+			if (!Consume('"'))
+				return false;
+
+			OutString = Cursor;
+			while (Cursor < End && *Cursor != '"')
+			{
+				if (*Cursor == '\\')
+					Cursor++;
+				Cursor++;
+			}
+			if (Cursor >= End)
+				return false;
+
+			OutLength = (int32)(Cursor - OutString);
+			Cursor++;
+			return true;
+		}
+
+		bool ReadNumber(double& OutValue)
+		{
+			SkipWhitespace();
+
+			double Sign = 1;
+			if (Cursor < End && *Cursor == '-')
+			{
+				Sign = -1;
+				Cursor++;
+			}
+
+			const CharType* Start = Cursor;
+			double Value = 0;
+			while (Cursor < End && FChar::IsDigit((TCHAR)*Cursor))
+				Value = Value * 10 + (*Cursor++ - '0');
+
+			if (Cursor < End && *Cursor == '.')
+			{
+				Cursor++;
+				double Scale = 0.1;
+				while (Cursor < End && FChar::IsDigit((TCHAR)*Cursor))
+				{
+					Value += (*Cursor++ - '0') * Scale;
+					Scale *= 0.1;
+				}
+			}
+
+			if (Cursor == Start)
+				return false;
+
+			if (Cursor < End && (*Cursor == 'e' || *Cursor == 'E'))
+			{
+				Cursor++;
+				int32 ExponentSign = 1;
+				if (Cursor < End && (*Cursor == '-' || *Cursor == '+'))
+					ExponentSign = *Cursor++ == '-' ? -1 : 1;
+
+				int32 Exponent = 0;
+				while (Cursor < End && FChar::IsDigit((TCHAR)*Cursor))
+					Exponent = FMath::Min(Exponent * 10 + (*Cursor++ - '0'), 400);
+				Value *= FMath::Pow(10.0, (double)(ExponentSign * Exponent));
+			}
+
+			OutValue = Sign * Value;
+			return true;
+		}
+
+		/** Skips any value, nested containers are tracked by depth only */
+		bool SkipValue()
 		{
-			TSharedPtr<FJsonObject> FrameObj = FrameVal->AsObject();
-			FAnimationFrame NewFrame;
+			SkipWhitespace();
+			if (Cursor >= End)
+				return false;
 
-			NewFrame.FrameIndex = FrameObj->GetIntegerField("FrameIndex");
+			if (*Cursor == '"')
+			{
+				const CharType* String;
+				int32 Length;
+				return ReadString(String, Length);
+			}
 
-			TArray<TSharedPtr<FJsonValue>> BlendShapeArray = FrameObj->GetArrayField("BlendShapes");
-			for (auto BlendShapeVal : BlendShapeArray)
+			if (*Cursor == '{' || *Cursor == '[')
 			{
-				TSharedPtr<FJsonObject> BlendShapeObj = BlendShapeVal->AsObject();
-				FName name = FName(BlendShapeObj->GetStringField("name"));
-				double score;
-				bool Success = BlendShapeObj->TryGetNumberField("score", score);
-				if (!Success)
-					score = 0;
-
-				NewFrame.BlendShapes.Add(name, score);
+				int32 Depth = 0;
+				while (Cursor < End)
+				{
+					const CharType Char = *Cursor;
+					if (Char == '"')
+					{
+						const CharType* String;
+						int32 Length;
+						if (!ReadString(String, Length))
+							return false;
+						continue;
+					}
+
+					Cursor++;
+					if (Char == '{' || Char == '[')
+						Depth++;
+					else if ((Char == '}' || Char == ']') && --Depth == 0)
+						return true;
+				}
+				return false;
 			}
 
-			AnimationFrames.Add(NewFrame);
+			// Number or literal
+			const CharType* Start = Cursor;
+			while (Cursor < End && *Cursor != ',' && *Cursor != '}' && *Cursor != ']' && *Cursor != ' ' && *Cursor != '\n' && *Cursor != '\r' && *Cursor != '\t')
+				Cursor++;
+			return Cursor != Start;
+		}
+
+		const CharType* Cursor;
+		const CharType* End;
+		int32 NextCurveIndex;
+	};
+
+	/** A frame of 55 scores takes roughly this many characters, used to size the output up front */
+	constexpr int32 BlendShapeJsonCharsPerFrame = 2500;
+
+	template <typename CharType>
+	bool ReadBlendShapeJson(const CharType* Json, int32 Length, TArray<FAnimationFrame>& OutFrames)
+	{
+		const int32 NumFramesBefore = OutFrames.Num();
+		OutFrames.Reserve(NumFramesBefore + Length / BlendShapeJsonCharsPerFrame + 1);
+
+		TBlendShapeJsonReader<CharType> Reader(Json, Length);
+		if (!Reader.Read(OutFrames))
+		{
+			UE_LOG(ConvaiUtilsLog, Warning, TEXT("ParseJsonToBlendShapeData: Malformed blendshape data, %d frames dropped"), OutFrames.Num() - NumFramesBefore);
+			OutFrames.SetNum(NumFramesBefore);
+			return false;
 		}
+		return true;
 	}
+}
 
+TArray<FAnimationFrame> UConvaiUtils::ParseJsonToBlendShapeData(const FString& JsonString)
+{
+	TArray<FAnimationFrame> AnimationFrames;
+	ReadBlendShapeJson(*JsonString, JsonString.Len(), AnimationFrames);
 	return AnimationFrames;
 }
 
+bool UConvaiUtils::ParseJsonToBlendShapeData(const ANSICHAR* Json, int32 Length, TArray<FAnimationFrame>& OutFrames)
+{
+	return ReadBlendShapeJson(Json, Length, OutFrames);
+}
+
 bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValuesString, FAnimationFrame& AnimationFrame)
 {
 	// Split the input string by ','
@@ -857,6 +1231,8 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 		return false;
 	}
 
+	AnimationFrame.BlendShapes.Reset(EConvaiFaceCurveSet::Visemes);
+
 	float ValuesSum = 0.0f; // Used to check if all blendshapes are zeros
 
 	bool ignore = true;
@@ -868,7 +1244,7 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 		if (StringValues[Index].TrimStartAndEnd().IsNumeric())
 		{
 			Value = FCString::Atof(*StringValues[Index]);
-			AnimationFrame.BlendShapes.Add(*ConvaiConstants::VisemeNames[Index], Value);
+			AnimationFrame.BlendShapes[Index] = Value;
 			if (Value > 0.03)
 				ignore = false;
 			ValuesSum += Value; // Add the value to the sum
@@ -878,18 +1254,15 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 			// Log a warning message if a string value is not numeric
 			//UE_LOG(LogTemp, Warning, TEXT("Invalid numeric value: %s"), *StringValues[Index])
 			Value = 0;
-			AnimationFrame.BlendShapes.Add(*ConvaiConstants::VisemeNames[Index], Value);
+			AnimationFrame.BlendShapes[Index] = Value;
 		}
 	}
 
 	// If the sum of all parsed values is close to zero, set the first blendshape to 1
 	if (ValuesSum < 0.1 || ignore)
 	{
-		if (ConvaiConstants::VisemeNames.Num() > 0)
-		{
-			AnimationFrame.BlendShapes[*ConvaiConstants::VisemeNames[0]] = 1.0f;
-			return false;
-		}
+		AnimationFrame.BlendShapes[EConvaiViseme::sil] = 1.0f;
+		return false;
 	}
 
 	return true;
@@ -0,0 +1,270 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiVisemeEstimator.h"
+
+namespace
+{
+	/** Hop between frames, the frame rate of the server visemes */
+	constexpr float VisemeFrameSeconds = 0.01f;
+
+	/** Band centers in Hz and their Q, first formant, second formant, upper formants and fricative noise */
+	constexpr float BandCenters[] = { 450.0f, 1400.0f, 3000.0f, 6000.0f };
+	constexpr float BandQs[] = { 0.7f, 0.9f, 1.0f, 1.2f };
+
+	/** Loudness in dBFS that maps to silence, and the range above it that maps to full loudness */
+	constexpr float SilenceDb = -50.0f;
+	constexpr float LoudnessRangeDb = 32.0f;
+
+	/** Per frame smoothing towards rising and falling weights */
+	constexpr float AttackRate = 0.6f;
+	constexpr float ReleaseRate = 0.3f;
+
+	/** Loudness rise from near silence within one frame that counts as a plosive release */
+	constexpr float OnsetRise = 0.25f;
+	constexpr float OnsetFloor = 0.2f;
+
+	float Triangle(float X, float Center, float HalfWidth)
+	{
+		return FMath::Max(0.0f, 1.0f - FMath::Abs(X - Center) / HalfWidth);
+	}
+
+	struct FVisemeToBlendshape
+	{
+		EConvaiViseme::Type Viseme;
+		EConvaiBlendshape::Type Blendshape;
+		float Weight;
+	};
+
+	/** Rough ARKit poses of the visemes, used when the face sync expects blendshapes */
+	const FVisemeToBlendshape VisemeBlendshapePoses[] =
+	{
+		{ EConvaiViseme::PP, EConvaiBlendshape::MouthClose, 0.5f },
+		{ EConvaiViseme::PP, EConvaiBlendshape::MouthPressLeft, 0.6f },
+		{ EConvaiViseme::PP, EConvaiBlendshape::MouthPressRight, 0.6f },
+		{ EConvaiViseme::FF, EConvaiBlendshape::MouthRollLower, 0.6f },
+		{ EConvaiViseme::FF, EConvaiBlendshape::MouthUpperUpLeft, 0.3f },
+		{ EConvaiViseme::FF, EConvaiBlendshape::MouthUpperUpRight, 0.3f },
+		{ EConvaiViseme::TH, EConvaiBlendshape::JawOpen, 0.15f },
+		{ EConvaiViseme::TH, EConvaiBlendshape::TongueOut, 0.5f },
+		{ EConvaiViseme::DD, EConvaiBlendshape::JawOpen, 0.2f },
+		{ EConvaiViseme::kk, EConvaiBlendshape::JawOpen, 0.25f },
+		{ EConvaiViseme::CH, EConvaiBlendshape::MouthFunnel, 0.5f },
+		{ EConvaiViseme::CH, EConvaiBlendshape::JawOpen, 0.1f },
+		{ EConvaiViseme::SS, EConvaiBlendshape::MouthStretchLeft, 0.4f },
+		{ EConvaiViseme::SS, EConvaiBlendshape::MouthStretchRight, 0.4f },
+		{ EConvaiViseme::nn, EConvaiBlendshape::JawOpen, 0.15f },
+		{ EConvaiViseme::RR, EConvaiBlendshape::MouthFunnel, 0.3f },
+		{ EConvaiViseme::RR, EConvaiBlendshape::JawOpen, 0.15f },
+		{ EConvaiViseme::aa, EConvaiBlendshape::JawOpen, 0.7f },
+		{ EConvaiViseme::aa, EConvaiBlendshape::MouthLowerDownLeft, 0.3f },
+		{ EConvaiViseme::aa, EConvaiBlendshape::MouthLowerDownRight, 0.3f },
+		{ EConvaiViseme::E, EConvaiBlendshape::JawOpen, 0.4f },
+		{ EConvaiViseme::E, EConvaiBlendshape::MouthStretchLeft, 0.4f },
+		{ EConvaiViseme::E, EConvaiBlendshape::MouthStretchRight, 0.4f },
+		{ EConvaiViseme::ih, EConvaiBlendshape::JawOpen, 0.25f },
+		{ EConvaiViseme::ih, EConvaiBlendshape::MouthSmileLeft, 0.3f },
+		{ EConvaiViseme::ih, EConvaiBlendshape::MouthSmileRight, 0.3f },
+		{ EConvaiViseme::oh, EConvaiBlendshape::JawOpen, 0.45f },
+		{ EConvaiViseme::oh, EConvaiBlendshape::MouthFunnel, 0.6f },
+		{ EConvaiViseme::ou, EConvaiBlendshape::JawOpen, 0.15f },
+		{ EConvaiViseme::ou, EConvaiBlendshape::MouthPucker, 0.8f },
+		{ EConvaiViseme::ou, EConvaiBlendshape::MouthFunnel, 0.3f },
+	};
+}
+
+void FConvaiVisemeEstimator::FBandFilter::Init(float SampleRate, float CenterFrequency, float Q)
+{
+	const float Omega = 2.0f * PI * CenterFrequency / SampleRate;
+	const float Alpha = FMath::Sin(Omega) / (2.0f * Q);
+	const float A0 = 1.0f + Alpha;
+	B0 = Alpha / A0;
+	B2 = -Alpha / A0;
+	A1 = -2.0f * FMath::Cos(Omega) / A0;
+	A2 = (1.0f - Alpha) / A0;
+	Reset();
+}
+
+FConvaiVisemeEstimator::FConvaiVisemeEstimator()
+	: HopSamples(0)
+	, ConfiguredSampleRate(0)
+{
+	Reset();
+}
+
+float FConvaiVisemeEstimator::GetFrameDuration()
+{
+	return VisemeFrameSeconds;
+}
+
+void FConvaiVisemeEstimator::Reset()
+{
+	for (FBandFilter& Band : Bands)
+	{
+		Band.Reset();
+	}
+	FMemory::Memzero(BandEnergy);
+	FMemory::Memzero(Smoothed);
+	Smoothed[EConvaiViseme::sil] = 1.0f;
+	HopEnergy = 0;
+	HopZeroCrossings = 0;
+	HopPosition = 0;
+	LastSample = 0;
+	LastLoudness = 0;
+	NextFrameIndex = 0;
+}
+
+void FConvaiVisemeEstimator::Configure(int32 SampleRate)
+{
+	ConfiguredSampleRate = SampleRate;
+	HopSamples = FMath::Max(FMath::RoundToInt(SampleRate * VisemeFrameSeconds), 1);
+
+	// Low sample rates cannot carry the upper bands, they are kept below Nyquist
+	const float MaxCenter = SampleRate * 0.42f;
+	for (int32 i = 0; i < NumBands; i++)
+	{
+		Bands[i].Init(SampleRate, FMath::Min(BandCenters[i], MaxCenter), BandQs[i]);
+	}
+	HopPosition = 0;
+	HopEnergy = 0;
+	HopZeroCrossings = 0;
+	FMemory::Memzero(BandEnergy);
+}
+
+void FConvaiVisemeEstimator::Process(const int16* PCM, int32 NumFrames, int32 NumChannels, int32 SampleRate, EConvaiFaceCurveSet CurveSet, TArray<FAnimationFrame>& OutFrames)
+{
+	if (!PCM || NumFrames <= 0 || NumChannels <= 0 || SampleRate <= 0)
+		return;
+
+	if (SampleRate != ConfiguredSampleRate)
+		Configure(SampleRate);
+
+	OutFrames.Reserve(OutFrames.Num() + (HopPosition + NumFrames) / HopSamples);
+
+	const float Scale = 1.0f / (32768.0f * NumChannels);
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		// Downmix to mono
+		int32 Sum = 0;
+		for (int32 Channel = 0; Channel < NumChannels; Channel++)
+		{
+			Sum += PCM[Frame * NumChannels + Channel];
+		}
+		const float Sample = Sum * Scale;
+
+		HopEnergy += Sample * Sample;
+		HopZeroCrossings += (Sample >= 0) != (LastSample >= 0);
+		LastSample = Sample;
+
+		for (int32 i = 0; i < NumBands; i++)
+		{
+			const float Filtered = Bands[i].Process(Sample);
+			BandEnergy[i] += Filtered * Filtered;
+		}
+
+		if (++HopPosition == HopSamples)
+		{
+			EmitFrame(CurveSet, OutFrames);
+			HopPosition = 0;
+			HopEnergy = 0;
+			HopZeroCrossings = 0;
+			FMemory::Memzero(BandEnergy);
+		}
+	}
+}
+
+void FConvaiVisemeEstimator::EmitFrame(EConvaiFaceCurveSet CurveSet, TArray<FAnimationFrame>& OutFrames)
+{
+	const float Rms = FMath::Sqrt(HopEnergy / HopSamples);
+	const float Db = 20.0f * FMath::LogX(10.0f, FMath::Max(Rms, 1e-6f));
+	const float Loudness = FMath::Clamp((Db - SilenceDb) / LoudnessRangeDb, 0.0f, 1.0f);
+
+	float Target[EConvaiViseme::Count] = {};
+	if (Loudness > 0)
+	{
+		const float BandSum = FMath::Max(BandEnergy[0] + BandEnergy[1] + BandEnergy[2] + BandEnergy[3], 1e-12f);
+		const float Low = BandEnergy[0] / BandSum;
+		const float Mid = BandEnergy[1] / BandSum;
+		const float High = BandEnergy[2] / BandSum;
+		const float Noise = BandEnergy[3] / BandSum;
+		const float ZeroCrossingRate = float(HopZeroCrossings) / HopSamples;
+
+		// Voiced sounds keep their energy in the formant bands, fricatives in the noise band with many zero crossings
+		const float Unvoiced = FMath::Clamp(Noise * 1.5f + FMath::Max(ZeroCrossingRate - 0.15f, 0.0f) * 2.0f, 0.0f, 1.0f);
+		const float Voiced = 1.0f - Unvoiced;
+
+		// Vowels by how far forward the second formant sits, back rounded vowels keep it low, front vowels push it up
+		const float Frontness = (Mid + High) / FMath::Max(Low + Mid + High, 1e-6f);
+		const float Rounded = Triangle(Frontness, 0.1f, 0.2f);
+		Target[EConvaiViseme::oh] = Voiced * Rounded * Loudness;
+		Target[EConvaiViseme::ou] = Voiced * Rounded * (1.0f - Loudness);
+		Target[EConvaiViseme::aa] = Voiced * Triangle(Frontness, 0.32f, 0.18f);
+		Target[EConvaiViseme::RR] = Voiced * Triangle(Frontness, 0.3f, 0.1f) * 0.3f;
+		Target[EConvaiViseme::E] = Voiced * Triangle(Frontness, 0.55f, 0.15f);
+		Target[EConvaiViseme::ih] = Voiced * Triangle(Frontness, 0.75f, 0.2f);
+
+		// Nasals are quiet with nearly all energy in the lowest band
+		Target[EConvaiViseme::nn] = Voiced * FMath::Clamp((Low - 0.8f) * 5.0f, 0.0f, 1.0f) * (1.0f - Loudness);
+
+		// Sibilants are noise heavy, the postalveolars lean on the upper formant band, weak broadband noise reads as labiodental
+		Target[EConvaiViseme::SS] = Unvoiced * Noise;
+		Target[EConvaiViseme::CH] = Unvoiced * High;
+		Target[EConvaiViseme::FF] = Unvoiced * (1.0f - Loudness) * 0.7f;
+		Target[EConvaiViseme::TH] = Unvoiced * (1.0f - Loudness) * 0.3f;
+
+		// A sudden rise from near silence is a plosive release
+		if (LastLoudness < OnsetFloor && Loudness - LastLoudness > OnsetRise)
+		{
+			Target[EConvaiViseme::PP] = Low;
+			Target[EConvaiViseme::kk] = High + Noise;
+			Target[EConvaiViseme::DD] = Mid;
+		}
+
+		// Speech weights share the loudness, silence takes the rest
+		float SpeechSum = 0;
+		for (int32 i = 1; i < EConvaiViseme::Count; i++)
+		{
+			SpeechSum += Target[i];
+		}
+		const float SpeechScale = SpeechSum > 1e-6f ? Loudness / SpeechSum : 0.0f;
+		for (int32 i = 1; i < EConvaiViseme::Count; i++)
+		{
+			Target[i] *= SpeechScale;
+		}
+		Target[EConvaiViseme::sil] = 1.0f - (SpeechSum > 1e-6f ? Loudness : 0.0f);
+	}
+	else
+	{
+		Target[EConvaiViseme::sil] = 1.0f;
+	}
+	LastLoudness = Loudness;
+
+	for (int32 i = 0; i < EConvaiViseme::Count; i++)
+	{
+		Smoothed[i] += (Target[i] - Smoothed[i]) * (Target[i] > Smoothed[i] ? AttackRate : ReleaseRate);
+	}
+
+	FAnimationFrame& Frame = OutFrames.AddDefaulted_GetRef();
+	Frame.FrameIndex = NextFrameIndex++;
+	if (CurveSet == EConvaiFaceCurveSet::Blendshapes)
+	{
+		VisemesToBlendshapes(Smoothed, Frame.BlendShapes);
+	}
+	else
+	{
+		Frame.BlendShapes.Reset(EConvaiFaceCurveSet::Visemes);
+		FMemory::Memcpy(Frame.BlendShapes.GetData(), Smoothed, sizeof(Smoothed));
+	}
+}
+
+void FConvaiVisemeEstimator::VisemesToBlendshapes(const float* Visemes, FConvaiFaceCurves& OutBlendshapes)
+{
+	OutBlendshapes.Reset(EConvaiFaceCurveSet::Blendshapes);
+	for (const FVisemeToBlendshape& Pose : VisemeBlendshapePoses)
+	{
+		OutBlendshapes[Pose.Blendshape] += Visemes[Pose.Viseme] * Pose.Weight;
+	}
+	for (int32 i = 0; i < EConvaiBlendshape::Count; i++)
+	{
+		OutBlendshapes[i] = FMath::Min(OutBlendshapes[i], 1.0f);
+	}
+}
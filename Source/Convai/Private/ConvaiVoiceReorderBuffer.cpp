@@ -0,0 +1,202 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiVoiceReorderBuffer.h"
+
+namespace
+{
+	/** Signed distance between two wrapping sequence numbers */
+	FORCEINLINE int32 SequenceDiff(uint16 A, uint16 B)
+	{
+		return (int16)(uint16)(A - B);
+	}
+}
+
+FConvaiVoiceReorderBuffer::FConvaiVoiceReorderBuffer()
+	: Timeout(0)
+	, NumPending(0)
+	, bActive(false)
+	, NextSequence(0)
+	, bHasEnd(false)
+	, EndSequence(0)
+	, EndTime(0)
+	, NumLost(0)
+	, NumLate(0)
+{
+}
+
+void FConvaiVoiceReorderBuffer::Init(int32 InWindowSize, float InTimeout)
+{
+	// Power of two so the slot mapping stays consistent when the sequence wraps
+	Slots.Reset();
+	Slots.SetNum(FMath::RoundUpToPowerOfTwo(FMath::Max(InWindowSize, 2)));
+	Timeout = InTimeout;
+	NumPending = 0;
+	bActive = false;
+	bHasEnd = false;
+}
+
+void FConvaiVoiceReorderBuffer::StartStream(uint16 FirstSequence, TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	// Packets may overtake the reliable marker, in which case the stream is already running
+	if (bActive && SequenceDiff(FirstSequence, NextSequence) <= 0)
+		return;
+
+	ReleasePending(OutReleased);
+	Restart(FirstSequence);
+}
+
+void FConvaiVoiceReorderBuffer::EndStream(uint16 LastSequence, double Now)
+{
+	bHasEnd = true;
+	EndSequence = LastSequence;
+	EndTime = Now;
+}
+
+void FConvaiVoiceReorderBuffer::AddPacket(FConvaiEncodedVoicePacket&& Packet, double Now, TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	if (Slots.Num() == 0)
+		return;
+
+	const uint16 Sequence = Packet.Sequence;
+
+	if (!bActive)
+	{
+		// Straggler of a stream that already ended
+		if (bHasEnd && SequenceDiff(Sequence, EndSequence) <= 0)
+		{
+			NumLate++;
+			return;
+		}
+		Restart(Sequence);
+	}
+
+	const int32 Offset = SequenceDiff(Sequence, NextSequence);
+	if (Offset < 0)
+	{
+		// Late or duplicate, its slot was already released
+		NumLate++;
+		return;
+	}
+
+	const int32 WindowSize = Slots.Num();
+	if (Offset >= 2 * WindowSize)
+	{
+		// Too far ahead to conceal the gap, start over from this packet
+		ReleasePending(OutReleased);
+		Restart(Sequence);
+	}
+	else
+	{
+		// Make room by giving up on the oldest missing packets
+		while (SequenceDiff(Sequence, NextSequence) >= WindowSize)
+		{
+			ReleaseNext(OutReleased);
+		}
+	}
+
+	FSlot& Slot = GetSlot(Sequence);
+	if (!Slot.bValid)
+	{
+		Slot.Packet = MoveTemp(Packet);
+		Slot.ArrivalTime = Now;
+		Slot.bValid = true;
+		NumPending++;
+	}
+
+	ReleaseReady(OutReleased);
+}
+
+void FConvaiVoiceReorderBuffer::Update(double Now, TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	if (!bActive)
+		return;
+
+	ReleaseReady(OutReleased);
+
+	// A packet that waited long enough gives up on everything missing before it
+	while (NumPending > 0)
+	{
+		double OldestArrival = Now;
+		for (const FSlot& Slot : Slots)
+		{
+			if (Slot.bValid)
+				OldestArrival = FMath::Min(OldestArrival, Slot.ArrivalTime);
+		}
+
+		if (Now - OldestArrival < Timeout)
+			break;
+
+		ReleaseNext(OutReleased);
+		ReleaseReady(OutReleased);
+	}
+
+	// The end of speech needs no concealment, stop once the last packet was released or had its chance to arrive
+	if (bHasEnd && NumPending == 0 && (SequenceDiff(NextSequence, EndSequence) > 0 || Now - EndTime >= Timeout))
+	{
+		bActive = false;
+	}
+}
+
+void FConvaiVoiceReorderBuffer::ReleaseNext(TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	FSlot& Slot = GetSlot(NextSequence);
+	FConvaiReceivedVoicePacket& Released = OutReleased.AddDefaulted_GetRef();
+
+	if (Slot.bValid)
+	{
+		Released.Packet = MoveTemp(Slot.Packet);
+		Slot.bValid = false;
+		NumPending--;
+	}
+	else
+	{
+		Released.bLost = true;
+		Released.Packet.Sequence = NextSequence;
+
+		const FSlot& NextSlot = GetSlot(NextSequence + 1);
+		if (NextSlot.bValid)
+		{
+			Released.FECData = NextSlot.Packet.EncodedData;
+		}
+		NumLost++;
+	}
+
+	NextSequence++;
+}
+
+void FConvaiVoiceReorderBuffer::ReleaseReady(TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	while (GetSlot(NextSequence).bValid)
+	{
+		ReleaseNext(OutReleased);
+	}
+}
+
+void FConvaiVoiceReorderBuffer::ReleasePending(TArray<FConvaiReceivedVoicePacket>& OutReleased)
+{
+	for (int32 i = 0; i < Slots.Num() && NumPending > 0; i++)
+	{
+		FSlot& Slot = GetSlot(NextSequence);
+		if (Slot.bValid)
+		{
+			ReleaseNext(OutReleased);
+		}
+		else
+		{
+			NextSequence++;
+		}
+	}
+}
+
+void FConvaiVoiceReorderBuffer::Restart(uint16 FirstSequence)
+{
+	for (FSlot& Slot : Slots)
+	{
+		Slot.bValid = false;
+		Slot.Packet = FConvaiEncodedVoicePacket();
+	}
+	NumPending = 0;
+	NextSequence = FirstSequence;
+	bActive = true;
+	bHasEnd = false;
+}
@@ -0,0 +1,316 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiActionMatcher.h"
+#include "ConvaiActionUtils.h"
+#include "ConvaiDefinitions.h"
+#include "ConvaiUtils.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Fixed so that a failure can be reproduced */
+	constexpr int32 ActionMatcherTestSeed = 1234;
+
+	constexpr int32 ActionMatcherTestNumQueries = 200;
+
+	/** Random string pairs checked against the plain edit distance, long enough to cover both IndelDistance paths */
+	constexpr int32 ActionMatcherTestNumDistancePairs = 500;
+	constexpr int32 ActionMatcherTestMaxDistanceLength = 150;
+
+	/** Edit distance with substitutions at 2, as LevenshteinDistance computed it before the bit-parallel path */
+	int32 ReferenceEditDistance(const FString& s, const FString& t)
+	{
+		if (s.Len() == 0) return t.Len();
+		if (t.Len() == 0) return s.Len();
+
+		TArray<int32> v0;
+		TArray<int32> v1;
+		v0.SetNumUninitialized(t.Len() + 1);
+		v1.SetNumUninitialized(t.Len() + 1);
+		for (int32 i = 0; i < v0.Num(); i++)
+			v0[i] = i;
+
+		for (int32 i = 0; i < s.Len(); i++)
+		{
+			v1[0] = i + 1;
+			for (int32 j = 0; j < t.Len(); j++)
+			{
+				const int32 Cost = s[i] == t[j] ? 0 : 2;
+				v1[j + 1] = FMath::Min3(v1[j] + 1, v0[j + 1] + 1, v0[j] + Cost);
+			}
+			Swap(v0, v1);
+		}
+		return v0[t.Len()];
+	}
+
+	/** LevenshteinDistance as it was, equal strings ignoring case count as a match */
+	int32 ReferenceLevenshteinDistance(const FString& s, const FString& t)
+	{
+		return s == t ? 0 : ReferenceEditDistance(s, t);
+	}
+
+	/** The linear scan UConvaiActions::ParseAction ran over every character and object before the matcher */
+	bool ReferenceFindClosePhraseOutsideQuotes(const FString& SearchString, const FString& PhraseToFind, int32& OutBestDistance)
+	{
+		if (PhraseToFind.IsEmpty())
+			return false;
+
+		const int32 MaxDistance = FMath::Clamp(PhraseToFind.Len() / 2, 2, 4);
+		OutBestDistance = MaxDistance + 1;
+
+		TArray<FString> Words;
+		FString CurrentWord;
+		bool bInsideQuotes = false;
+		for (const TCHAR Char : SearchString)
+		{
+			if (Char == '"')
+			{
+				bInsideQuotes = !bInsideQuotes;
+				if (!CurrentWord.IsEmpty())
+				{
+					Words.Add(CurrentWord);
+					CurrentWord.Empty();
+				}
+				continue;
+			}
+
+			if (!bInsideQuotes && (Char == ' ' || Char == '\t'))
+			{
+				if (!CurrentWord.IsEmpty())
+				{
+					Words.Add(CurrentWord);
+					CurrentWord.Empty();
+				}
+			}
+			else if (!bInsideQuotes)
+			{
+				CurrentWord.AppendChar(Char);
+			}
+		}
+		if (!CurrentWord.IsEmpty())
+			Words.Add(CurrentWord);
+
+		TArray<FString> PhraseWords;
+		const int32 NumWordsInPhrase = PhraseToFind.ParseIntoArray(PhraseWords, TEXT(" "), true);
+
+		for (int32 i = 0; i <= Words.Num() - NumWordsInPhrase; i++)
+		{
+			FString WindowString;
+			for (int32 j = 0; j < NumWordsInPhrase; j++)
+				WindowString += (j > 0 ? TEXT(" ") : TEXT("")) + Words[i + j];
+
+			if (WindowString.Len() - PhraseToFind.Len() >= MaxDistance || PhraseToFind.Len() - WindowString.Len() >= MaxDistance)
+				continue;
+
+			const int32 Distance = ReferenceLevenshteinDistance(WindowString, PhraseToFind);
+			if (Distance <= MaxDistance && Distance < OutBestDistance)
+				OutBestDistance = Distance;
+		}
+
+		return OutBestDistance <= MaxDistance;
+	}
+
+	bool ReferenceFindNearestObjectByName(const FString& SearchString, const TArray<FConvaiObjectEntry>& Objects, FConvaiObjectEntry& OutMatch)
+	{
+		bool bFound = false;
+		int32 BestDistance = 100;
+		for (const FConvaiObjectEntry& Object : Objects)
+		{
+			int32 Distance = 0;
+			if (ReferenceFindClosePhraseOutsideQuotes(SearchString, Object.Name, Distance) && Distance < BestDistance)
+			{
+				OutMatch = Object;
+				BestDistance = Distance;
+				bFound = true;
+			}
+		}
+		return bFound;
+	}
+
+	FString MakeWord(FRandomStream& Random, int32 MinLength, int32 MaxLength)
+	{
+		FString Word;
+		const int32 Length = Random.RandRange(MinLength, MaxLength);
+		for (int32 i = 0; i < Length; i++)
+			Word.AppendChar(TCHAR('a' + Random.RandRange(0, 25)));
+		return Word;
+	}
+
+	/** Up to two typos, sometimes in upper case to hit the case-insensitive exact match */
+	FString Misspell(FRandomStream& Random, FString Phrase)
+	{
+		const int32 NumEdits = Random.RandRange(0, 2);
+		for (int32 Edit = 0; Edit < NumEdits && Phrase.Len() > 1; Edit++)
+		{
+			const int32 At = Random.RandRange(0, Phrase.Len() - 1);
+			const TCHAR Letter = TCHAR('a' + Random.RandRange(0, 25));
+			switch (Random.RandRange(0, 2))
+			{
+			case 0: Phrase[At] = Letter; break;
+			case 1: Phrase.InsertAt(At, Letter); break;
+			default: Phrase.RemoveAt(At); break;
+			}
+		}
+		return Random.RandRange(0, 4) == 0 ? Phrase.ToUpper() : Phrase;
+	}
+
+	/** One to three words, unique ignoring case like the names the environment keeps */
+	FString MakeUniqueName(FRandomStream& Random, TSet<FString>& UsedNames, int32 MaxWords)
+	{
+		while (true)
+		{
+			FString Name = MakeWord(Random, 3, 9);
+			const int32 NumWords = Random.RandRange(1, MaxWords);
+			for (int32 i = 1; i < NumWords; i++)
+				Name += TEXT(" ") + MakeWord(Random, 2, 7);
+
+			if (!UsedNames.Contains(Name))
+			{
+				UsedNames.Add(Name);
+				return Name;
+			}
+		}
+	}
+
+	UConvaiEnvironment* MakeEnvironment(FRandomStream& Random, int32 NumEntries)
+	{
+		UConvaiEnvironment* Environment = UConvaiEnvironment::CreateConvaiEnvironment();
+		TSet<FString> UsedNames;
+		for (int32 i = 0; i < NumEntries; i++)
+		{
+			const FString Action = MakeUniqueName(Random, UsedNames, 3);
+			Environment->AddAction(Random.RandRange(0, 3) == 0 ? Action + TEXT(" <") + MakeWord(Random, 4, 12) + TEXT(">") : Action);
+
+			FConvaiObjectEntry Character;
+			Character.Name = MakeUniqueName(Random, UsedNames, 2);
+			Environment->AddCharacter(Character);
+
+			FConvaiObjectEntry Object;
+			Object.Name = MakeUniqueName(Random, UsedNames, 2);
+			Environment->AddObject(Object);
+		}
+		return Environment;
+	}
+
+	/** An action followed by a character or object, misspelled, with noise and quoted text around them */
+	FString MakeQuery(FRandomStream& Random, const UConvaiEnvironment& Environment)
+	{
+		auto PickName = [&Random](const TArray<FConvaiObjectEntry>& Entries)
+		{
+			return Entries[Random.RandRange(0, Entries.Num() - 1)].Name;
+		};
+
+		FString Query = Random.RandRange(0, 5) == 0
+			? MakeWord(Random, 2, 9)
+			: Misspell(Random, UConvaiActions::RemoveDesc(Environment.Actions[Random.RandRange(0, Environment.Actions.Num() - 1)]));
+
+		switch (Random.RandRange(0, 4))
+		{
+		case 0: Query += TEXT(" ") + Misspell(Random, PickName(Environment.Characters)); break;
+		case 1: Query += TEXT(" ") + Misspell(Random, PickName(Environment.Objects)); break;
+		case 2: Query += TEXT(" \"") + PickName(Environment.Characters) + TEXT(" ") + PickName(Environment.Objects) + TEXT("\""); break;
+		case 3: Query += TEXT(" ") + MakeWord(Random, 2, 9) + TEXT(" ") + MakeWord(Random, 2, 9); break;
+		default: break;
+		}
+
+		if (Random.RandRange(0, 3) == 0)
+			Query += TEXT(" ") + Misspell(Random, PickName(Environment.Objects));
+		return Query;
+	}
+
+	bool IsSameMatch(bool bExpectedFound, const FConvaiObjectEntry& Expected, bool bFound, const FConvaiObjectEntry& Actual)
+	{
+		return bExpectedFound == bFound && (!bFound || Actual.Name.Equals(Expected.Name, ESearchCase::CaseSensitive));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FConvaiActionMatcherTest, "Convai.Actions.ActionMatcher", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FConvaiActionMatcherTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(ActionMatcherTestSeed);
+
+	for (int32 Pair = 0; Pair < ActionMatcherTestNumDistancePairs; Pair++)
+	{
+		const FString A = MakeWord(Random, 0, ActionMatcherTestMaxDistanceLength);
+		const FString B = Random.RandBool() ? Misspell(Random, A) : MakeWord(Random, 0, ActionMatcherTestMaxDistanceLength);
+		const int32 Expected = ReferenceEditDistance(A, B);
+		const int32 Actual = UConvaiUtils::IndelDistance(A, B);
+		if (Actual != Expected)
+		{
+			AddError(FString::Printf(TEXT("IndelDistance(\"%s\", \"%s\") is %d, expected %d"), *A, *B, Actual, Expected));
+			break;
+		}
+	}
+
+	for (const int32 NumEntries : { 10, 100, 1000 })
+	{
+		UConvaiEnvironment* Environment = MakeEnvironment(Random, NumEntries);
+
+		TArray<FString> Queries;
+		for (int32 i = 0; i < ActionMatcherTestNumQueries; i++)
+			Queries.Add(MakeQuery(Random, *Environment));
+
+		double Start = FPlatformTime::Seconds();
+		const FConvaiActionMatcher Matcher(*Environment);
+		const double BuildSeconds = FPlatformTime::Seconds() - Start;
+
+		TArray<FString> MatchedActions;
+		TArray<TPair<bool, FConvaiObjectEntry>> MatchedCharacters;
+		TArray<TPair<bool, FConvaiObjectEntry>> MatchedObjects;
+		Start = FPlatformTime::Seconds();
+		for (const FString& Query : Queries)
+		{
+			MatchedActions.Add(Matcher.FindAction(Query));
+			TPair<bool, FConvaiObjectEntry>& Character = MatchedCharacters.AddDefaulted_GetRef();
+			Character.Key = Matcher.FindCharacter(Query, Character.Value);
+			TPair<bool, FConvaiObjectEntry>& Object = MatchedObjects.AddDefaulted_GetRef();
+			Object.Key = Matcher.FindObject(Query, Object.Value);
+		}
+		const double MatcherSeconds = FPlatformTime::Seconds() - Start;
+
+		TArray<FString> LinearActions;
+		TArray<TPair<bool, FConvaiObjectEntry>> LinearCharacters;
+		TArray<TPair<bool, FConvaiObjectEntry>> LinearObjects;
+		Start = FPlatformTime::Seconds();
+		for (const FString& Query : Queries)
+		{
+			LinearActions.Add(UConvaiActions::FindAction(Query, Environment->Actions));
+			TPair<bool, FConvaiObjectEntry>& Character = LinearCharacters.AddDefaulted_GetRef();
+			Character.Key = ReferenceFindNearestObjectByName(Query, Environment->Characters, Character.Value);
+			TPair<bool, FConvaiObjectEntry>& Object = LinearObjects.AddDefaulted_GetRef();
+			Object.Key = ReferenceFindNearestObjectByName(Query, Environment->Objects, Object.Value);
+		}
+		const double LinearSeconds = FPlatformTime::Seconds() - Start;
+
+		int32 NumMismatches = 0;
+		for (int32 i = 0; i < Queries.Num(); i++)
+		{
+			if (!MatchedActions[i].Equals(LinearActions[i], ESearchCase::CaseSensitive))
+			{
+				AddError(FString::Printf(TEXT("%d entries, action of \"%s\": matcher \"%s\", linear \"%s\""), NumEntries, *Queries[i], *MatchedActions[i], *LinearActions[i]));
+				NumMismatches++;
+			}
+			if (!IsSameMatch(LinearCharacters[i].Key, LinearCharacters[i].Value, MatchedCharacters[i].Key, MatchedCharacters[i].Value))
+			{
+				AddError(FString::Printf(TEXT("%d entries, character of \"%s\": matcher \"%s\", linear \"%s\""), NumEntries, *Queries[i], *MatchedCharacters[i].Value.Name, *LinearCharacters[i].Value.Name));
+				NumMismatches++;
+			}
+			if (!IsSameMatch(LinearObjects[i].Key, LinearObjects[i].Value, MatchedObjects[i].Key, MatchedObjects[i].Value))
+			{
+				AddError(FString::Printf(TEXT("%d entries, object of \"%s\": matcher \"%s\", linear \"%s\""), NumEntries, *Queries[i], *MatchedObjects[i].Value.Name, *LinearObjects[i].Value.Name));
+				NumMismatches++;
+			}
+		}
+
+		AddInfo(FString::Printf(TEXT("%d entries, %d queries: build %.3f ms, matcher %.1f us per query, linear scans %.1f us per query, %d mismatches"),
+			NumEntries, Queries.Num(), BuildSeconds * 1000, MatcherSeconds * 1000000 / Queries.Num(), LinearSeconds * 1000000 / Queries.Num(), NumMismatches));
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,141 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiUtils.h"
+#include "ConvaiDefinitions.h"
+#include "Misc/AutomationTest.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** About five seconds of face data at the server frame rate */
+	constexpr int32 BlendShapeJsonTestNumFrames = 300;
+
+	/** Each parser runs this many times, the timings are per run */
+	constexpr int32 BlendShapeJsonTestNumRuns = 20;
+
+	/** Scores are multiples of this, exact in decimal and in float, so both parsers must agree bit for bit */
+	constexpr int32 BlendShapeJsonTestScoreSteps = 256;
+
+	/** Payload in the layout the server sends, every curve of the blendshape layout in order with varying scores */
+	FString MakeBlendShapeJson()
+	{
+		const TArray<FName>& CurveNames = FConvaiFaceCurves::GetCurveNames(EConvaiFaceCurveSet::Blendshapes);
+
+		FString Json = TEXT("[");
+		for (int32 Frame = 0; Frame < BlendShapeJsonTestNumFrames; Frame++)
+		{
+			if (Frame > 0)
+				Json += TEXT(", ");
+			Json += FString::Printf(TEXT("{\"FrameIndex\": %d, \"BlendShapes\": ["), Frame);
+
+			for (int32 Curve = 0; Curve < CurveNames.Num(); Curve++)
+			{
+				if (Curve > 0)
+					Json += TEXT(", ");
+				const int32 Step = (Frame * 31 + Curve * 7) % (BlendShapeJsonTestScoreSteps + 1);
+				Json += FString::Printf(TEXT("{\"name\": \"%s\", \"score\": %.8f}"), *CurveNames[Curve].ToString(), (double)Step / BlendShapeJsonTestScoreSteps);
+			}
+			Json += TEXT("]}");
+		}
+		Json += TEXT("]");
+		return Json;
+	}
+
+	/** The DOM based parse the streaming reader replaced, kept as the reference */
+	TArray<FAnimationFrame> ParseBlendShapeJsonDOM(const FString& JsonString)
+	{
+		TArray<FAnimationFrame> AnimationFrames;
+
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+		TSharedPtr<FJsonValue> JsonParsed;
+		if (FJsonSerializer::Deserialize(Reader, JsonParsed) && JsonParsed.IsValid() && JsonParsed->Type == EJson::Array)
+		{
+			for (const TSharedPtr<FJsonValue>& FrameVal : JsonParsed->AsArray())
+			{
+				TSharedPtr<FJsonObject> FrameObj = FrameVal->AsObject();
+				FAnimationFrame& NewFrame = AnimationFrames.AddDefaulted_GetRef();
+				NewFrame.BlendShapes.Reset(EConvaiFaceCurveSet::Blendshapes);
+				NewFrame.FrameIndex = FrameObj->GetIntegerField(TEXT("FrameIndex"));
+
+				for (const TSharedPtr<FJsonValue>& BlendShapeVal : FrameObj->GetArrayField(TEXT("BlendShapes")))
+				{
+					TSharedPtr<FJsonObject> BlendShapeObj = BlendShapeVal->AsObject();
+					double Score;
+					if (!BlendShapeObj->TryGetNumberField(TEXT("score"), Score))
+						Score = 0;
+					NewFrame.BlendShapes.SetCurve(FName(BlendShapeObj->GetStringField(TEXT("name"))), Score);
+				}
+			}
+		}
+
+		return AnimationFrames;
+	}
+
+	bool AreFramesIdentical(FAutomationTestBase& Test, const TCHAR* What, const TArray<FAnimationFrame>& Expected, const TArray<FAnimationFrame>& Actual)
+	{
+		if (!Test.TestEqual(FString::Printf(TEXT("%s frame count"), What), Actual.Num(), Expected.Num()))
+			return false;
+
+		for (int32 i = 0; i < Expected.Num(); i++)
+		{
+			const FConvaiFaceCurves& ExpectedCurves = Expected[i].BlendShapes;
+			const FConvaiFaceCurves& ActualCurves = Actual[i].BlendShapes;
+			if (Actual[i].FrameIndex != Expected[i].FrameIndex
+				|| ActualCurves.GetCurveSet() != ExpectedCurves.GetCurveSet()
+				|| FMemory::Memcmp(ActualCurves.GetData(), ExpectedCurves.GetData(), ExpectedCurves.Num() * sizeof(float)) != 0)
+			{
+				Test.AddError(FString::Printf(TEXT("%s frame %d differs from the DOM parse: %s"), What, i, *Actual[i].ToString()));
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FConvaiBlendShapeJsonTest, "Convai.LipSync.BlendShapeJson", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FConvaiBlendShapeJsonTest::RunTest(const FString& Parameters)
+{
+	const FString Json = MakeBlendShapeJson();
+	const FTCHARToUTF8 JsonUTF8(*Json);
+
+	TArray<FAnimationFrame> DOMFrames;
+	TArray<FAnimationFrame> StringFrames;
+	TArray<FAnimationFrame> UTF8Frames;
+	double DOMSeconds = 0;
+	double StringSeconds = 0;
+	double UTF8Seconds = 0;
+
+	for (int32 Run = 0; Run < BlendShapeJsonTestNumRuns; Run++)
+	{
+		double Start = FPlatformTime::Seconds();
+		DOMFrames = ParseBlendShapeJsonDOM(Json);
+		DOMSeconds += FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		StringFrames = UConvaiUtils::ParseJsonToBlendShapeData(Json);
+		StringSeconds += FPlatformTime::Seconds() - Start;
+
+		// The gRPC thread parses the reply bytes through this overload
+		UTF8Frames.Reset();
+		Start = FPlatformTime::Seconds();
+		UConvaiUtils::ParseJsonToBlendShapeData((const ANSICHAR*)JsonUTF8.Get(), JsonUTF8.Length(), UTF8Frames);
+		UTF8Seconds += FPlatformTime::Seconds() - Start;
+	}
+
+	TestEqual(TEXT("DOM frame count"), DOMFrames.Num(), BlendShapeJsonTestNumFrames);
+	AreFramesIdentical(*this, TEXT("FString"), DOMFrames, StringFrames);
+	AreFramesIdentical(*this, TEXT("UTF-8"), DOMFrames, UTF8Frames);
+
+	AddInfo(FString::Printf(TEXT("%d frames of %d curves, %d characters, per parse: FJsonSerializer %.3f ms, streaming FString %.3f ms, streaming UTF-8 %.3f ms"),
+		BlendShapeJsonTestNumFrames, FConvaiFaceCurves::GetNumCurves(EConvaiFaceCurveSet::Blendshapes), Json.Len(),
+		DOMSeconds * 1000 / BlendShapeJsonTestNumRuns, StringSeconds * 1000 / BlendShapeJsonTestNumRuns, UTF8Seconds * 1000 / BlendShapeJsonTestNumRuns));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * BK-tree of strings under UConvaiUtils::IndelDistance.
+ * A lookup only descends into the children whose distance to their parent can still be within the radius,
+ * so with the small radii of the action matching most entries are never compared.
+ */
+class CONVAI_API FConvaiFuzzyIndex
+{
+public:
+	void Add(const FString& Key, int32 Value);
+
+	/** Calls Visitor(Value, Distance) for every entry within MaxDistance of Query, in no particular order */
+	void Find(const FString& Query, int32 MaxDistance, TFunctionRef<void(int32 Value, int32 Distance)> Visitor) const;
+
+	int32 Num() const { return Nodes.Num(); }
+
+private:
+	struct FNode
+	{
+		FString Key;
+		int32 Value;
+
+		/** Distance to this node and index of the child */
+		TArray<TPair<int32, int32>, TInlineAllocator<4>> Children;
+	};
+
+	TArray<FNode> Nodes;
+};
+
+/**
+ * Snapshot of the actions, characters and objects of an environment, indexed for UConvaiActions::ParseAction.
+ * Matches what the linear scans over the environment found, descriptions are stripped once when building.
+ * Immutable once built, shared between threads through UConvaiEnvironment::GetActionMatcher.
+ */
+class CONVAI_API FConvaiActionMatcher
+{
+public:
+	explicit FConvaiActionMatcher(const UConvaiEnvironment& Environment);
+
+	/** Environment version the snapshot was taken at */
+	uint32 GetVersion() const { return Version; }
+
+	/** Closest action to the first words of the parsed action, without its description, or "None" */
+	FString FindAction(const FString& ActionToBeParsed) const;
+
+	/** Closest character named outside quotes, OutMatch is left untouched when there is none */
+	bool FindCharacter(const FString& ActionToBeParsed, FConvaiObjectEntry& OutMatch) const;
+
+	/** Closest object named outside quotes, OutMatch is left untouched when there is none */
+	bool FindObject(const FString& ActionToBeParsed, FConvaiObjectEntry& OutMatch) const;
+
+private:
+	/** Names with the same number of words, they are compared against the same slice of the parsed action */
+	struct FPhraseGroup
+	{
+		int32 NumWords;
+		FConvaiFuzzyIndex Index;
+
+		/** Case-insensitive, first entry per name, LevenshteinDistance puts these at 0 */
+		TMap<FString, int32> ExactIndex;
+	};
+
+	struct FNamedEntries
+	{
+		TArray<FConvaiObjectEntry> Entries;
+		TArray<FPhraseGroup> Groups;
+
+		void Build(const TArray<FConvaiObjectEntry>& InEntries);
+		bool FindNearest(const TArray<FString>& Words, FConvaiObjectEntry& OutMatch) const;
+	};
+
+	static FPhraseGroup& FindOrAddGroup(TArray<FPhraseGroup>& Groups, int32 NumWords);
+
+	TArray<FString> Actions;
+	TArray<FPhraseGroup> ActionGroups;
+	FNamedEntries Characters;
+	FNamedEntries Objects;
+	uint32 Version;
+};
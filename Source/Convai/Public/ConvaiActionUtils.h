@@ -27,6 +27,7 @@ public:
 	// Extract number from an action result (e.g. Waits for 5 seconds -> 5)
 	static float ExtractNumber(FString ActionResult);
 
+	// Linear scan over the given actions, ParseAction uses the indexed FConvaiActionMatcher of the environment instead
 	static FString FindAction(FString ActionToBeParsed, TArray<FString> Actions);
 
 	// Removes inner descriptions from a string e.g. (Waits for <time in seconds> becomes Waits for)
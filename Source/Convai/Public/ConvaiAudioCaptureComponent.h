@@ -7,12 +7,27 @@
 #include "Components/SynthComponent.h"
 #include "AudioCaptureCore.h"
 #include "AudioCaptureDeviceInterface.h"
+#include "ConvaiSPSCRingBuffer.h"
+#include <atomic>
 #include "ConvaiAudioCaptureComponent.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiAudioLog, Log, All);
 
 namespace Audio
 {
+	/** Counters of the capture ring, read from any thread */
+	struct FConvaiAudioCaptureStats
+	{
+		/** Capture callbacks that did not fit in the ring */
+		uint32 Overflows = 0;
+		/** Samples dropped because the ring was full */
+		uint32 DroppedSamples = 0;
+		/** Callbacks where the capture device itself reported an overflow */
+		uint32 DeviceOverflows = 0;
+		/** Render callbacks that could not be filled completely */
+		uint32 Underruns = 0;
+	};
+
 	/** Class which contains an FAudioCapture object and performs analysis on the audio stream, only outputing audio if it matches a detection criteria. */
 	class FConvaiAudioCaptureSynth
 	{
@@ -51,19 +66,22 @@ namespace Audio
 		// Returns true if the capture synth is capturing audio
 		bool IsCapturing() const;
 
-		// Retrieves audio data from the capture synth.
-		// This returns audio only if there was non-zero audio since this function was last called.
-		bool GetAudioData(TArray<float>& OutAudioData);
+		// Copies up to NumSamples captured samples into OutAudio without allocating, returns the number of samples copied
+		int32 ReadAudioData(float* OutAudio, int32 NumSamples);
 
 		// Returns the number of samples enqueued in the capture synth
 		int32 GetNumSamplesEnqueued();
 
 		FAudioCapture* GetAudioCapture();
 
+		FConvaiAudioCaptureStats GetCaptureStats() const;
+
+		void ReportUnderrun();
+
 	private:
 
-		// Number of samples enqueued
-		int32 NumSamplesEnqueued;
+		// Called from the capture device callback thread
+		void OnAudioCaptured(const float* AudioData, int32 NumFrames, int32 NumChannels, bool bOverFlow);
 
 		// Information about the default capture device we're going to use
 		FCaptureDeviceInfo CaptureInfo;
@@ -71,17 +89,19 @@ namespace Audio
 		// Audio capture object dealing with getting audio callbacks
 		FAudioCapture AudioCapture;
 
-		// Critical section to prevent reading and writing from the captured buffer at the same time
-		FCriticalSection CaptureCriticalSection;
-
-		// Buffer of audio capture data, yet to be copied to the output 
-		TArray<float> AudioCaptureData;
+		// Audio capture data yet to be copied to the output, written by the capture callback and read by the audio render thread
+		TConvaiSPSCRingBuffer<float> AudioCaptureRing;
 
 		// If the object has been initialized
 		bool bInitialized;
 
 		// If we're capturing data
-		bool bIsCapturing;
+		std::atomic<bool> bIsCapturing;
+
+		std::atomic<uint32> NumOverflows;
+		std::atomic<uint32> NumDroppedSamples;
+		std::atomic<uint32> NumDeviceOverflows;
+		std::atomic<uint32> NumUnderruns;
 	};
 
 };
@@ -129,11 +149,12 @@ public:
 
 	Audio::FConvaiAudioCaptureSynth* GetCaptureSynth();
 
+	Audio::FConvaiAudioCaptureStats GetCaptureStats() const;
+
 private:
 	int32 SelectedDeviceIndex;
 
 	Audio::FConvaiAudioCaptureSynth CaptureSynth;
-	TArray<float> CaptureAudioData;
 	int32 CapturedAudioDataSamples;
 
 	bool bSuccessfullyInitialized;
@@ -141,7 +162,6 @@ private:
 	bool bIsStreamOpen;
 	int32 CaptureChannels;
 	int32 FramesSinceStarting;
-	int32 ReadSampleIndex;
 	FThreadSafeBool bIsDestroying;
 	FThreadSafeBool bIsNotReadyForForFinishDestroy;
 };
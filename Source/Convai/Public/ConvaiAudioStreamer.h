@@ -6,6 +6,11 @@
 #include "Components/AudioComponent.h"
 #include "ConvaiDefinitions.h"
 #include "Interfaces/VoiceCodec.h"
+#include "ConvaiSPSCRingBuffer.h"
+#include "Containers/Queue.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "ConvaiVoiceReorderBuffer.h"
+#include "ConvaiFaceFrameCodec.h"
 
 #include "ConvaiAudioStreamer.generated.h"
 
@@ -13,10 +18,38 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiAudioStreamerLog, Log, All);
 
-class USoundWaveProcedural;
+class UConvaiSoundWaveProcedural;
+class UNetConnection;
+class UConvaiPlayerComponent;
+struct FConvaiEchoReference;
 class IConvaiLipSyncInterface;
 class IConvaiLipSyncExtendedInterface;
 
+/** Opus encoder settings picked on the game thread and applied by the encode task */
+struct FConvaiVoiceEncoderParams
+{
+	/** Bits per second, 0 leaves the Opus default */
+	int32 Bitrate = 0;
+	int32 PacketLossPercentage = 0;
+	bool bUseFEC = false;
+
+	bool operator==(const FConvaiVoiceEncoderParams& Other) const
+	{
+		return Bitrate == Other.Bitrate && PacketLossPercentage == Other.PacketLossPercentage && bUseFEC == Other.bUseFEC;
+	}
+	bool operator!=(const FConvaiVoiceEncoderParams& Other) const { return !(*this == Other); }
+};
+
+/** PCM produced by the decode task, waiting to be queued for playback on the game thread */
+struct FConvaiDecodedVoiceChunk
+{
+	TArray<uint8> PCMData;
+	uint32 SampleRate = 0;
+	uint32 NumChannels = 0;
+	bool bPlay = false;
+	bool bServer = false;
+};
+
 UCLASS()
 class UConvaiAudioStreamer : public UAudioComponent
 {
@@ -27,13 +60,32 @@ class UConvaiAudioStreamer : public UAudioComponent
 	DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FOVRLipSyncVisemesDataReadySignature, UConvaiAudioStreamer, OnVisemesReady);
 
 public:
-	/** Send the encoded audio from the server to all clients (including the server again) */
-	UFUNCTION(NetMulticast, Reliable, Category = "VoiceNetworking")
-	void BroadcastVoiceDataToClients(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode);
+	/** Send the encoded audio from the server to all clients (including the server again), unreliable so a lost packet never stalls the channel */
+	UFUNCTION(NetMulticast, Unreliable, Category = "VoiceNetworking")
+	void BroadcastVoiceDataToClients(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence);
 
 	/** Send the encoded audio from a client(/server) to the server, it should call at the end BroadcastVoiceDataToClients() */
+	UFUNCTION(Server, Unreliable, Category = "VoiceNetworking")
+	virtual void ProcessEncodedVoiceData(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence);
+
+	/** Reliable start/stop marker of a voice stream sent from the server to all clients, Sequence is the first or the last packet of the stream */
+	UFUNCTION(NetMulticast, Reliable, Category = "VoiceNetworking")
+	void BroadcastVoiceStreamMarker(bool bStart, uint16 Sequence);
+
+	/** Reliable start/stop marker of a voice stream sent to the server, it should call at the end BroadcastVoiceStreamMarker() */
 	UFUNCTION(Server, Reliable, Category = "VoiceNetworking")
-	virtual void ProcessEncodedVoiceData(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode);
+	void ProcessVoiceStreamMarker(bool bStart, uint16 Sequence);
+
+	/** Voice packet of another streamer relayed by the server to this streamer's owning client only, used for per-connection voice relevancy */
+	UFUNCTION(Client, Unreliable, Category = "VoiceNetworking")
+	void ClientReceiveRelayedVoiceData(UConvaiAudioStreamer* Source, TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence);
+
+	/** Quantized face frames from the server to all clients, one packet per tick, see FConvaiFaceFrameCodec */
+	UFUNCTION(NetMulticast, Unreliable, Category = "VoiceNetworking")
+	void BroadcastFaceData(TArray<uint8> const& Packet);
+
+	/** Bytes per second of face data replicated by this streamer, smoothed over about a second */
+	float GetFaceDataBandwidth() const { return FaceDataBandwidth; }
 
 	/** If we should play audio on same client */
 	virtual bool ShouldMuteLocal();
@@ -43,6 +95,9 @@ public:
 
 	virtual void OnServerAudioReceived(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData = true, uint32 SampleRate = 21000, uint32 NumChannels = 1) {};
 
+	/** True if OnServerAudioReceived consumes the voice, so the server decodes it even where nothing is played */
+	virtual bool UsesServerAudio() const { return false; }
+
 	void PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData=true, uint32 SampleRate=21000, uint32 NumChannels=1);
 
 	void PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData, FAnimationSequence FaceSequence, uint32 SampleRate = 21000, uint32 NumChannels = 1);
@@ -60,7 +115,20 @@ public:
 
 	bool IsVoiceCurrentlyFading();
 
-	void ClearAudioFinishedTimer();
+	/** Seconds of the current speech already played, follows the audio clock */
+	float GetVoiceTimeElapsed() const;
+
+	/** Seconds of received speech not yet played */
+	float GetVoiceTimeRemaining() const;
+
+	/** Priority of this voice in the audible voice budget, roughly its level in dB at the listener */
+	float GetVoicePriority() const;
+
+	/** Voices the local player is talking to are never culled by the voice budget */
+	virtual bool IsInConversationWithLocalPlayer() const { return false; }
+
+	/** True while the voice budget keeps this voice silent, its speech is neither decoded nor lipsynced but its timing carries on */
+	bool IsVoiceCulled() const { return bVoiceCulled; }
 
 	bool IsLocal();
 
@@ -87,6 +155,9 @@ public:
 
 	bool ReplicateVoiceToNetwork;
 
+	/** Rendered output of this streamer, used by the microphone path to cancel the echo of this voice */
+	TSharedPtr<FConvaiEchoReference, ESPMode::ThreadSafe> GetEchoReference() const { return EchoReference; }
+
 public:
 	// UActorComponent interface
 	virtual void BeginPlay() override;
@@ -97,20 +168,24 @@ public:
 
 public:
 
-	FTimerHandle AudioFinishedTimerHandle;
 	bool IsTalking = false;
 	float TotalVoiceFadeOutTime;
 	float RemainingVoiceFadeOutTime;
 
+	/** Borrowed from the subsystem pool while talking */
 	UPROPERTY()
-	USoundWaveProcedural* SoundWaveProcedural;
+	UConvaiSoundWaveProcedural* SoundWaveProcedural;
 
-	TArray<uint8> AudioDataBuffer;
+	/** PCM waiting to be encoded, written on the game thread and read by the encode task */
+	TConvaiSPSCRingBuffer<uint8> AudioDataBuffer;
+	/** Decode output staging buffer, owned by the decode task */
 	TArray<uint8> ReceivedEncodedAudioDataBuffer;
  
 	IConvaiLipSyncInterface* ConvaiLipSync;
 	IConvaiLipSyncExtendedInterface* ConvaiLipSyncExtended;
 
+	TSharedPtr<FConvaiEchoReference, ESPMode::ThreadSafe> EchoReference;
+
 	void PlayLipSyncWithPreGeneratedData(FAnimationSequence FaceSequence);
 
 	void PlayLipSync(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels);
@@ -128,6 +203,12 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Convai|LipSync", Meta = (Tooltip = "Returns map of blendshapes"))
 	const TMap<FName, float> ConvaiGetFaceBlendshapes() const;
 
+	/** ConvaiGetFaceBlendshapes without the copy, for native animation code */
+	const TMap<FName, float>& GetFaceBlendshapesMap() const;
+
+	/** Current curves in their fixed index layout, nullptr without a lipsync component that keeps them */
+	const FConvaiFaceCurves* GetFaceCurves() const;
+
 	UFUNCTION(BlueprintPure, Category = "Convai|LipSync", Meta = (Tooltip = "True if the output visemes is in Blendshape format"))
 	bool GeneratesVisemesAsBlendshapes();
 
@@ -141,16 +222,107 @@ public:
 
 private:
 
+	/** Finishes talking once the sound wave reports that all received speech was rendered */
+	void UpdatePlaybackState();
+
+	/** Stops playback and hands the sound wave back to the subsystem pool */
+	void ReleaseVoiceWave();
+
+	/** Asks the subsystem whether this voice fits in the audible voice budget and culls or resumes it */
+	void UpdateVoiceBudget(float DeltaTime);
+
+	/** Accounts for speech that is not played because the voice is culled or cannot be rendered */
+	void SkipVoiceData(float Duration);
+
+	/** False where no audio is rendered (dedicated server, -nosound, no audio device), speech then runs on the game clock */
+	bool CanRenderVoice() const;
+
+	void UpdateVoiceLoudness(const uint8* PCMData, uint32 NumBytes);
+
 	bool InitEncoder(int32 InSampleRate, int32 InNumChannels, EAudioEncodeHint EncodeHint);
 	int32 Encode(const uint8* RawPCMData, uint32 RawDataSize, uint8* OutCompressedData, uint32& OutCompressedDataSize);
 	void DestroyOpusEncoder();
 
+	/** Runs on a worker thread, encodes all whole frames in AudioDataBuffer into EncodedVoicePackets */
+	void EncodePendingVoiceData();
+
+	void WaitForEncodeTask();
+
+	/** Retunes the encoder target from the stats of the connection the voice is sent over */
+	void UpdateEncoderParams(float DeltaTime);
+
+	/** Called by the encode task before encoding */
+	void ApplyEncoderParams(const FConvaiVoiceEncoderParams& Params);
+
+	/** Connection used to judge the link quality, the owning connection if there is one, otherwise the worst client connection */
+	UNetConnection* GetVoiceNetConnection() const;
+
+	/** Runs on a worker thread, decodes all packets in ReceivedVoicePackets into DecodedVoiceChunks */
+	void DecodePendingVoiceData();
+
+	void WaitForDecodeTask();
+
+	/** Queues the decoded chunks for playback, no DSP work is left for the game thread */
+	void PlayDecodedVoiceData();
+
+	/** Hands packets released by the reorder buffer to the decode task */
+	void DecodeVoicePackets(TArray<FConvaiReceivedVoicePacket>& Packets);
+
+	/** Conceals a lost packet, recovering its last frame from the in-band FEC of the following packet if available */
+	void DecodeLost(const uint8* NextCompressedData, uint32 NextCompressedDataSize, uint8* OutRawPCMData, uint32& OutRawDataSize);
+
 	bool InitDecoder(int32 InSampleRate, int32 InNumChannels);
 	void Decode(const uint8* CompressedData, uint32 CompressedDataSize, uint8* OutRawPCMData, uint32& OutRawDataSize);
 	void DestroyOpusDecoder();
 
 	void DestroyOpus();
 
+	/** Server side, sends a voice packet to the clients that can hear it, or to everyone if relevancy cannot be determined */
+	void ReplicateVoicePacket(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode, uint16 Sequence);
+
+	/** Server side, sends the face data received since the last tick */
+	void ReplicateFaceData(float DeltaTime);
+
+	/** Server side, sends the packet being built, returns its size */
+	int32 SendFaceDataPacket();
+
+	/** Distance beyond which this voice is inaudible, 0 if it is not attenuated */
+	float GetVoiceAudibleDistance() const;
+
+	/** Game thread, audible voice budget state */
+	bool bVoiceCulled;
+	/** Smoothed level of the received speech in dBFS */
+	float VoiceLoudness;
+	/** Seconds of skipped speech the character is still saying, counts below zero once it ran out */
+	float SkippedVoiceRemaining;
+	/** Seconds of the current speech that were played by an earlier sound wave or skipped */
+	float VoiceTimeElapsedOffset;
+	float LastSkippedPacketDuration;
+	bool bResetDecoderOnResume;
+
+	/** Face data received on the gRPC thread, waiting to be replicated */
+	TQueue<FAnimationSequence, EQueueMode::Mpsc> PendingFaceSequences;
+	/** Game thread, state of the outgoing face stream */
+	FConvaiFaceFrameCodec::FWriter FaceDataWriter;
+	uint8 FaceStreamId;
+	bool bSendingFaceStream;
+	/** Seconds of face frames sent in the current stream */
+	float FaceStreamTime;
+	float FaceStreamIdleTime;
+	int32 FaceStreamBytes;
+	int32 FaceStreamUncompressedBytes;
+	float FaceDataBandwidth;
+	/** Client side, the received stream and where on its timeline the next packet is expected */
+	uint8 ReceivedFaceStreamId;
+	bool bReceivingFaceStream;
+	float ReceivedFaceStreamTime;
+	FAnimationFrame LastReceivedFaceFrame;
+	TArray<FAnimationSequence> DecodedFaceSequences;
+
+	/** Player components of the remote clients, refreshed periodically */
+	TArray<TWeakObjectPtr<UConvaiPlayerComponent>> VoiceListeners;
+	float VoiceListenersRefreshTime;
+
 	/** Sample rate encoding (supports 8000, 12000, 16000, 24000, 480000) */
 	int32 EncoderSampleRate;
 	/** Encoded channel count (supports 1,2) */
@@ -167,6 +339,25 @@ private:
 	struct OpusEncoder* Encoder;
 	/** Last value set in the call to Encode() */
 	uint8 EncoderGeneration;
+	/** Preallocated staging buffers owned by the encode task */
+	TArray<uint8> EncodeInputBuffer;
+	TArray<uint8> EncodeOutputBuffer;
+	/** Encode task in flight, the encoder state must not be touched on the game thread while it runs */
+	FGraphEventRef EncodeTask;
+	/** Finished packets handed back to the game thread */
+	TQueue<FConvaiEncodedVoicePacket, EQueueMode::Spsc> EncodedVoicePackets;
+	/** Sequence number of the next encoded packet */
+	uint16 EncoderSequence;
+	/** Game thread, state of the outgoing stream markers */
+	bool bSendingVoiceStream;
+	uint16 LastSentVoiceSequence;
+	float VoiceStreamIdleTime;
+	/** Game thread */
+	FConvaiVoiceEncoderParams TargetEncoderParams;
+	float EncoderParamsUpdateTimer;
+	float SmoothedPacketLoss;
+	/** Encode task, last settings pushed to the Opus encoder */
+	FConvaiVoiceEncoderParams AppliedEncoderParams;
 
 
 	/** Sample rate to decode into, regardless of encoding (supports 8000, 12000, 16000, 24000, 480000) */
@@ -182,5 +373,16 @@ private:
 	struct OpusDecoder* Decoder;
 	/** Generation value received from the last incoming packet */
 	uint8 DecoderLastGeneration;
+	/** Frames in the last decoded packet, used to conceal a lost one */
+	int32 DecoderLastFramesPerPacket;
+	/** Game thread, puts the unreliable packets back in order */
+	FConvaiVoiceReorderBuffer VoiceReorderBuffer;
+	TArray<FConvaiReceivedVoicePacket> ReleasedVoicePackets;
+	/** Decode tasks are chained on the previous one so the decoder state is only ever used by one worker at a time */
+	FGraphEventRef DecodeTask;
+	/** Packets received on the game thread, waiting for the decode task */
+	TQueue<FConvaiReceivedVoicePacket, EQueueMode::Spsc> ReceivedVoicePackets;
+	/** Decoded PCM handed back to the game thread */
+	TQueue<FConvaiDecodedVoiceChunk, EQueueMode::Spsc> DecodedVoiceChunks;
 
 };
\ No newline at end of file
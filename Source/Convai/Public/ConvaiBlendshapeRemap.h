@@ -0,0 +1,66 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * Blendshape mapping of a rig compiled from names to curve indices.
+ * Applying it walks a flat list of source to target entries over float arrays, with the results of UConvaiUtils::MapBlendshapes:
+ * mapped curves are scaled, offset and clamped, several sources of one target keep the highest value,
+ * override values replace the target and curves without a mapping pass through.
+ * Not thread-safe, the owner guards it.
+ */
+class CONVAI_API FConvaiBlendshapeRemap
+{
+public:
+	FConvaiBlendshapeRemap();
+
+	/**
+	 * Recompiles the table if the source layout, the mapping or the global modifiers changed since the last call.
+	 * @return	true if the target curves changed
+	 */
+	bool Update(EConvaiFaceCurveSet SourceCurveSet, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset);
+
+	/** Maps the source curves, OutValues follows the order of GetTargetNames */
+	void Apply(const FConvaiFaceCurves& Source, TArray<float>& OutValues) const;
+
+	/** Target curves in the order they are first written, as MapBlendshapes adds them */
+	const TArray<FName>& GetTargetNames() const { return TargetNames; }
+
+private:
+	enum class EOp : uint8
+	{
+		/** Replaces the target */
+		Set,
+		/** Keeps the higher of the target and the value */
+		Max
+	};
+
+	struct FEntry
+	{
+		int32 Source;
+		int32 Target;
+		float Scale;
+		float Bias;
+		float ClampMin;
+		float ClampMax;
+		EOp Op;
+	};
+
+	void Compile(EConvaiFaceCurveSet SourceCurveSet, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset);
+
+	int32 FindOrAddTarget(FName TargetName);
+
+	static uint32 HashMapping(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset);
+
+	TArray<FEntry> Entries;
+	TArray<FName> TargetNames;
+	TMap<FName, int32> TargetIndices;
+
+	EConvaiFaceCurveSet CompiledCurveSet;
+	uint32 CompiledHash;
+	int32 CompiledMapSize;
+	bool bCompiled;
+};
@@ -32,6 +32,49 @@ DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_TwoParams(FOnInterruptedSignature, UCo
 
 // TODO (Mohamed): Manage onDestroy/onEndPlay - should end any on-going streams
 
+UENUM()
+enum class EConvaiChatbotUpdateType : uint8
+{
+	Transcription,
+	ResponseText,
+	SessionID,
+	Actions,
+	NarrativeSection,
+	Emotion
+};
+
+/** One response stream event replicated from the server to the clients, only the fields of its type are set */
+USTRUCT()
+struct FConvaiChatbotUpdate
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EConvaiChatbotUpdateType Type = EConvaiChatbotUpdateType::Transcription;
+
+	/** Transcription, response text, session ID, narrative section ID or emotion */
+	UPROPERTY()
+	FString Text;
+
+	UPROPERTY()
+	bool IsTranscriptionReady = false;
+
+	UPROPERTY()
+	bool IsFinal = false;
+
+	UPROPERTY()
+	TArray<FConvaiResultAction> Actions;
+
+	UPROPERTY()
+	FString BT_Code;
+
+	UPROPERTY()
+	FString BT_Constants;
+
+	/** A transcription still being refined, superseded by the next one */
+	bool IsPartialTranscription() const { return Type == EConvaiChatbotUpdateType::Transcription && !IsTranscriptionReady && !IsFinal; }
+};
+
 class UConvaiPlayerComponent;
 class USoundWaveProcedural;
 class UConvaiGRPCGetResponseProxy;
@@ -300,6 +343,15 @@ public:
 	UFUNCTION(NetMulticast, Reliable, Category = "VoiceNetworking")
 	void Broadcast_InterruptSpeech(float InVoiceFadeOutDuration);
 
+	// UConvaiAudioStreamer interface
+	virtual bool IsInConversationWithLocalPlayer() const override;
+
+	/**
+	 * Version the server knows InEnvironment by, so talk requests only need to send the version.
+	 * Returns 0 if InEnvironment is not this character's environment or was changed locally since it was replicated.
+	 */
+	uint32 GetServerEnvironmentVersion(const UConvaiEnvironment* InEnvironment) const;
+
 private:
 	// AActorComponent interface
 	virtual void BeginPlay() override;
@@ -342,18 +394,22 @@ private:
 	void Cleanup(bool StreamConnectionFinished = false);
 
 private:
+	/** All response stream events of one frame except a superseded or trailing partial transcription, in the order they were received */
 	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_OnTranscriptionReceived(const FString& Transcription, bool IsTranscriptionReady, bool IsFinal);
-	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_onResponseDataReceived(const FString& ReceivedText, bool IsFinal);
-	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_onSessionIDReceived(const FString& ReceivedSessionID);
-	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_onActionSequenceReceived(const TArray<FConvaiResultAction>& ReceivedSequenceOfActions);	
-	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_OnNarrativeSectionReceived(const FString& BT_Code, const FString& BT_Constants, const FString& ReceivedNarrativeSectionID);
-	UFUNCTION(NetMulticast, Reliable, Category = "Convai")
-	void Broadcast_onEmotionReceived(const FString& ReceivedEmotionResponse);
+	void Broadcast_ChatbotUpdates(const TArray<FConvaiChatbotUpdate>& Updates);
+
+	/** Latest partial transcription of one frame, TranscriptionSegment is the number of final transcriptions sent before it */
+	UFUNCTION(NetMulticast, Unreliable, Category = "Convai")
+	void Broadcast_PartialTranscription(const FString& Transcription, uint16 TranscriptionSegment);
+
+	/** Server side, queues a response stream event for the clients, callable from any thread */
+	void QueueChatbotUpdate(FConvaiChatbotUpdate&& Update);
+
+	/** Server side, collapses the events queued since the last frame and sends them */
+	void FlushChatbotUpdates();
+
+	/** Client side, runs a replicated response stream event */
+	void ApplyChatbotUpdate(const FConvaiChatbotUpdate& Update);
 
 	void OnTranscriptionReceived(FString Transcription, bool IsTranscriptionReady, bool IsFinal);
 	void onResponseDataReceived(const FString ReceivedText, const TArray<uint8>& ReceivedAudio, uint32 SampleRate, bool IsFinal);
@@ -366,14 +422,23 @@ private:
 	void onFailure();
 
 private:
+	/** Environment content, only the changed entries are replicated */
 	UPROPERTY(Replicated, ReplicatedUsing = OnRep_EnvironmentData)
-	FConvaiEnvironmentDetails ConvaiEnvironmentDetails;
+	FConvaiEnvironmentItems ReplicatedEnvironment;
+
+	/** Server version of the replicated environment content */
+	UPROPERTY(Replicated, ReplicatedUsing = OnRep_EnvironmentData)
+	uint32 ReplicatedEnvironmentVersion;
 
 	UFUNCTION()
 	void OnRep_EnvironmentData();
 
+	/** Server side, replicates the environment changes made since the last update */
 	void UpdateEnvironmentData();
 
+	/** Client side, local version of Environment right after the replicated content was applied */
+	uint32 AppliedEnvironmentVersion;
+
 private:
 	UPROPERTY()
 	UConvaiChatBotGetDetailsProxy* ConvaiChatBotGetDetailsProxy;
@@ -395,4 +460,10 @@ private:
 	bool ReceivedFinalData; // Did the character end his response
 	FString LastPlayerName;
 	TArray<uint8> PlayerInpuAudioBuffer;
+
+	/** Events produced on the gRPC thread, sent once per frame by the game thread */
+	TQueue<FConvaiChatbotUpdate, EQueueMode::Mpsc> PendingChatbotUpdates;
+	TArray<FConvaiChatbotUpdate> ChatbotUpdatesToSend;
+	/** Final transcriptions sent by the server or received by the client, orders the unreliable partial ones */
+	uint16 TranscriptionSegment;
 };
\ No newline at end of file
@@ -4,8 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "CoreGlobals.h"
+#include "Stats/Stats.h"
+#include "Engine/NetSerialization.h"
 #include "ConvaiDefinitions.generated.h"
 
+DECLARE_STATS_GROUP(TEXT("Convai"), STATGROUP_Convai, STATCAT_Advanced);
+
 
 UENUM(BlueprintType)
 enum class ETTS_Voice_Type : uint8
@@ -162,6 +166,102 @@ struct FConvaiBlendshapeParameters
 	float ClampMaxValue = 1;
 };
 
+/** Blendshape curve indices, in the order of ConvaiConstants::BlendShapesNames */
+namespace EConvaiBlendshape
+{
+	enum Type : uint8
+	{
+		EyeBlinkLeft, EyeLookDownLeft, EyeLookInLeft, EyeLookOutLeft, EyeLookUpLeft, EyeSquintLeft,
+		EyeWideLeft, EyeBlinkRight, EyeLookDownRight, EyeLookInRight, EyeLookOutRight, EyeLookUpRight,
+		EyeSquintRight, EyeWideRight, JawForward, JawLeft, JawRight, JawOpen,
+		MouthClose, MouthFunnel, MouthPucker, MouthLeft, MouthRight, MouthSmileLeft,
+		MouthSmileRight, MouthFrownLeft, MouthFrownRight, MouthDimpleLeft, MouthDimpleRight, MouthStretchLeft,
+		MouthStretchRight, MouthRollLower, MouthRollUpper, MouthShrugLower, MouthShrugUpper, MouthPressLeft,
+		MouthPressRight, MouthLowerDownLeft, MouthLowerDownRight, MouthUpperUpLeft, MouthUpperUpRight, BrowDownLeft,
+		BrowDownRight, BrowInnerUp, BrowOuterUpLeft, BrowOuterUpRight, CheekPuff, CheekSquintLeft,
+		CheekSquintRight, NoseSneerLeft, NoseSneerRight, TongueOut, HeadRoll, HeadPitch,
+		HeadYaw,
+		Count
+	};
+}
+
+/** Viseme curve indices, in the order of ConvaiConstants::VisemeNames */
+namespace EConvaiViseme
+{
+	enum Type : uint8
+	{
+		sil, PP, FF, TH, DD, kk, CH, SS,
+		nn, RR, aa, E, ih, oh, ou,
+		Count
+	};
+}
+
+enum class EConvaiFaceCurveSet : uint8
+{
+	None,
+	Blendshapes,
+	Visemes
+};
+
+/** Fixed layout face curves, one float per blendshape or viseme */
+struct CONVAI_API FConvaiFaceCurves
+{
+	static constexpr int32 MaxCurves = EConvaiBlendshape::Count;
+
+	FConvaiFaceCurves()
+		: CurveSet(EConvaiFaceCurveSet::None)
+	{
+		FMemory::Memzero(Values);
+	}
+
+	explicit FConvaiFaceCurves(EConvaiFaceCurveSet InCurveSet)
+		: CurveSet(InCurveSet)
+	{
+		FMemory::Memzero(Values);
+	}
+
+	/** Sets all curves to zero and switches the layout */
+	void Reset(EConvaiFaceCurveSet InCurveSet)
+	{
+		CurveSet = InCurveSet;
+		FMemory::Memzero(Values);
+	}
+
+	EConvaiFaceCurveSet GetCurveSet() const { return CurveSet; }
+
+	int32 Num() const { return GetNumCurves(CurveSet); }
+
+	float* GetData() { return Values; }
+	const float* GetData() const { return Values; }
+
+	float& operator[](int32 Index) { checkSlow(Index >= 0 && Index < MaxCurves); return Values[Index]; }
+	float operator[](int32 Index) const { checkSlow(Index >= 0 && Index < MaxCurves); return Values[Index]; }
+
+	/** Sets a curve by name, a frame without a layout takes the one the name belongs to. Unknown names are ignored */
+	bool SetCurve(FName CurveName, float Value);
+
+	/** Value of a curve by name, nullptr if the layout has no such curve */
+	const float* FindCurve(FName CurveName) const;
+
+	/** Name keyed copy of the curves */
+	TMap<FName, float> ToMap() const;
+
+	/** Overwrites the curves from a name keyed map, a frame without a layout takes the one of the first known name */
+	void FromMap(const TMap<FName, float>& CurveMap);
+
+	static int32 GetNumCurves(EConvaiFaceCurveSet InCurveSet);
+
+	/** Stable curve names of a layout, built from ConvaiConstants::BlendShapesNames and ConvaiConstants::VisemeNames */
+	static const TArray<FName>& GetCurveNames(EConvaiFaceCurveSet InCurveSet);
+
+	/** Index of a curve in a layout, INDEX_NONE if it has no such curve */
+	static int32 FindCurveIndex(EConvaiFaceCurveSet InCurveSet, FName CurveName);
+
+private:
+	float Values[MaxCurves];
+	EConvaiFaceCurveSet CurveSet;
+};
+
 USTRUCT()
 struct FAnimationFrame
 {
@@ -170,18 +270,16 @@ struct FAnimationFrame
 	UPROPERTY()
 	int32 FrameIndex = 0;
 
-	UPROPERTY()
-	TMap<FName, float> BlendShapes;
+	FConvaiFaceCurves BlendShapes;
 
-	FString ToString()
+	FString ToString() const
 	{
 		FString Result;
 
-		// iterate over all elements in the TMap
-		for (const auto& Elem : BlendShapes)
+		const TArray<FName>& CurveNames = FConvaiFaceCurves::GetCurveNames(BlendShapes.GetCurveSet());
+		for (int32 i = 0; i < CurveNames.Num(); i++)
 		{
-			// Append the key-value pair to the result string
-			Result += Elem.Key.ToString() + TEXT(": ") + FString::SanitizeFloat(Elem.Value) + TEXT(", ");
+			Result += CurveNames[i].ToString() + TEXT(": ") + FString::SanitizeFloat(BlendShapes[i]) + TEXT(", ");
 		}
 
 		// Remove the trailing comma and space for cleanliness, if present
@@ -377,6 +475,63 @@ public:
 	FConvaiObjectEntry AttentionObject;
 };
 
+UENUM()
+enum class EConvaiEnvironmentItemType : uint8
+{
+	Action,
+	Object,
+	Character,
+	MainCharacter,
+	AttentionObject
+};
+
+/** One action, object or character of a replicated environment, actions only use the entry name */
+USTRUCT()
+struct FConvaiEnvironmentItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EConvaiEnvironmentItemType Type = EConvaiEnvironmentItemType::Action;
+
+	UPROPERTY()
+	FConvaiObjectEntry Entry;
+};
+
+class UConvaiEnvironment;
+
+/** Environment content replicated per item, only the entries that changed are sent */
+USTRUCT()
+struct FConvaiEnvironmentItems : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FConvaiEnvironmentItem> Items;
+
+	/** Server side, updates the items to match the environment and marks the changed ones dirty */
+	void Update(const UConvaiEnvironment* Environment);
+
+	/** Client side, rebuilds the environment content from the items */
+	FConvaiEnvironmentDetails ToEnvironmentDetails() const;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FConvaiEnvironmentItem, FConvaiEnvironmentItems>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FConvaiEnvironmentItems> : public TStructOpsTypeTraitsBase2<FConvaiEnvironmentItems>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+class FConvaiActionMatcher;
+
 // TODO: OnEnvironmentChanged event should be called in an optimizied way for any change in the environment
 
 UCLASS(Blueprintable)
@@ -399,13 +554,14 @@ public:
 
 	void SetFromEnvironment(UConvaiEnvironment* InEnvironment)
 	{
-		if (IsValid(InEnvironment))
+		if (IsValid(InEnvironment) && InEnvironment != this)
 		{
 			Objects = InEnvironment->Objects;
 			Characters = InEnvironment->Characters;
 			Actions = InEnvironment->Actions;
 			MainCharacter = InEnvironment->MainCharacter;
 			AttentionObject = InEnvironment->AttentionObject;
+			MarkChanged();
 			OnEnvironmentChanged.ExecuteIfBound();
 		}
 	}
@@ -417,6 +573,7 @@ public:
 		Actions = InEnvironment.Actions;
 		MainCharacter = InEnvironment.MainCharacter;
 		AttentionObject = InEnvironment.AttentionObject;
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -435,6 +592,7 @@ public:
 		void AddAction(FString Action)
 	{
 		Actions.AddUnique(Action);
+		MarkChanged();
 	}
 
 	UFUNCTION(BlueprintCallable, category = "Convai|Action API")
@@ -442,6 +600,7 @@ public:
 	{
 		for (auto a : ActionsToAdd)
 			Actions.AddUnique(a);
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -449,6 +608,7 @@ public:
 		void RemoveAction(FString Action)
 	{
 		Actions.Remove(Action);
+		MarkChanged();
 	}
 
 	UFUNCTION(BlueprintCallable, category = "Convai|Action API")
@@ -456,6 +616,7 @@ public:
 	{
 		for (auto a : ActionsToRemove)
 			Actions.Remove(a);
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -463,6 +624,7 @@ public:
 		void ClearAllActions()
 	{
 		Actions.Empty();
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -492,6 +654,7 @@ public:
 		{
 			Objects.AddUnique(Object);
 		}
+		MarkChanged();
 	}
 
 	/**
@@ -512,6 +675,7 @@ public:
 		for (auto o : Objects)
 			if (ObjectName == o.Name)
 				Objects.Remove(o);
+		MarkChanged();
 	}
 
 	UFUNCTION(BlueprintCallable, category = "Convai|Action API")
@@ -526,6 +690,7 @@ public:
 		void ClearObjects()
 	{
 		Objects.Empty();
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -555,6 +720,7 @@ public:
 		{
 			Characters.AddUnique(Character);
 		}
+		MarkChanged();
 	}
 
 	/**
@@ -575,6 +741,7 @@ public:
 		for (auto c : Characters)
 			if (CharacterName == c.Name)
 				Characters.Remove(c);
+		MarkChanged();
 	}
 
 	UFUNCTION(BlueprintCallable, category = "Convai|Action API")
@@ -588,6 +755,7 @@ public:
 		void ClearCharacters()
 	{
 		Characters.Empty();
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -597,6 +765,7 @@ public:
 	{
 		MainCharacter = InMainCharacter;
 		AddCharacter(MainCharacter);
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -605,6 +774,7 @@ public:
 	{
 		AttentionObject = InAttentionObject;
 		AddObject(AttentionObject);
+		MarkChanged();
 		OnEnvironmentChanged.ExecuteIfBound();
 	}
 
@@ -612,12 +782,14 @@ public:
 	void ClearMainCharacter()
 	{
 		MainCharacter = FConvaiObjectEntry();
+		MarkChanged();
 	}
 
 	UFUNCTION(BlueprintCallable, category = "Convai|Action API")
 	void ClearAttentionObject()
 	{
 		AttentionObject = FConvaiObjectEntry();
+		MarkChanged();
 	}
 
 	UPROPERTY(BlueprintReadOnly, category = "Convai|Action API")
@@ -634,6 +806,20 @@ public:
 
 	UPROPERTY(BlueprintReadOnly, category = "Convai|Action API")
 	FConvaiObjectEntry AttentionObject;
+
+	/** Increases with every change made through the functions above, starts at 1 so 0 can mean no version */
+	uint32 GetVersion() const { return Version; }
+
+	void MarkChanged() { Version++; }
+
+	/** Index of the current actions, characters and objects for parsing, rebuilt on first use after a change. Any thread */
+	TSharedRef<const FConvaiActionMatcher, ESPMode::ThreadSafe> GetActionMatcher() const;
+
+private:
+	uint32 Version = 1;
+
+	mutable FCriticalSection ActionMatcherLock;
+	mutable TSharedPtr<const FConvaiActionMatcher, ESPMode::ThreadSafe> ActionMatcher;
 };
 
 UCLASS(Blueprintable)
@@ -655,11 +841,26 @@ namespace ConvaiConstants
 	{
 		// Buffer sizes
 		VoiceCaptureRingBufferCapacity = 1024 * 1024,
+		AudioCaptureRingBufferCapacity = 2 * 2 * 48000, // 2 seconds of stereo audio at 48k SR
+		VoiceEncodeRingBufferCapacity = 1024 * 1024, // aproximately 21 seconds of 24 kHz mono PCM
 		VoiceCaptureBufferSize = 1024 * 1024,
 		LipSyncBufferSize = 1024 * 100, // aproximately 1024 seconds for OVR
 		VoiceCaptureSampleRate = 16000,
 		VoiceCaptureChunk = 2084,
 		VoiceStreamMaxChunk = 4096,
+		EchoReferenceCapacity = 1 << 16, // aproximately 1.3 seconds of mono 48 kHz playback
+		EchoCancellerFilterLength = 1024, // 64 ms echo tail at VoiceCaptureSampleRate
+		EchoMaxBulkDelay = 8000, // 500 ms playback to capture delay at VoiceCaptureSampleRate, compensated before the filter
+		VoiceJitterBufferMinDepth = 60 /* 60 ms*/,
+		VoiceJitterBufferMaxDepth = 400 /* 400 ms*/,
+		VoiceMaxFramesPerPacket = 3, // 60 ms of 20 ms Opus frames per replicated voice packet
+		VoiceReorderWindow = 8,
+		VoiceReorderTimeout = 60 /* 60 ms*/,
+		VoiceStreamIdleTimeout = 500 /* 500 ms*/,
+		FaceDataMaxPacketSize = 1024, // bytes of quantized face frames per replicated packet
+		VoiceWavePoolPrewarmCount = 4,
+		VoiceWavePoolMaxPerFormat = 8,
+		VoiceWavePoolReuseDelay = 1000 /* 1000 ms*/,
 		PlayerTimeOut = 2500 /* 2500 ms*/,
 		ChatbotTimeOut = 6000 /* 6000 ms*/
 	};
@@ -0,0 +1,194 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiSPSCRingBuffer.h"
+#include <atomic>
+
+/**
+ * Output PCM of a character voice as it is rendered, used as the far-end reference for echo cancellation.
+ * Filled on the audio render thread by UConvaiSoundWaveProcedural and drained by a single consumer in the mic capture path.
+ */
+struct CONVAI_API FConvaiEchoReference
+{
+	FConvaiEchoReference();
+
+	/** Called from the audio render thread with the samples that were just handed to the mixer */
+	void PushRenderedAudio(const int16* InterleavedPCM, int32 NumSamples, int32 NumChannels, int32 SampleRate);
+
+	/** Called from the audio render thread on underrun so the reference keeps pace with the output clock */
+	void PushSilence(int32 NumFrames);
+
+	/** Consumer side, starts accepting rendered audio and discards anything stale */
+	void Attach();
+
+	/** Consumer side, stops accepting rendered audio */
+	void Detach();
+
+	bool IsAttached() const { return bAttached.load(std::memory_order_acquire); }
+
+	int32 GetSampleRate() const { return SampleRate.load(std::memory_order_acquire); }
+
+	/** Mono reference samples at GetSampleRate() */
+	TConvaiSPSCRingBuffer<int16> Samples;
+
+private:
+	std::atomic<bool> bAttached;
+	std::atomic<int32> SampleRate;
+	TArray<int16> DownmixScratch;
+};
+
+/**
+ * Normalized least mean squares echo canceller.
+ * Subtracts the estimated echo of the reference signal from the microphone signal, both must share the same sample rate.
+ * Adaptation is frozen while near-end speech is detected (Geigel double talk detection) so the player voice does not disturb the filter.
+ */
+class CONVAI_API FConvaiEchoCanceller
+{
+public:
+	FConvaiEchoCanceller();
+
+	/**
+	 * @param InFilterLength	Number of taps, should cover the room reverb plus whatever playback to capture delay is not compensated before the filter
+	 * @param InStepSize		Adaptation step size in (0, 1]
+	 */
+	void Init(int32 InFilterLength, float InStepSize = 0.5f);
+
+	void Reset();
+
+	/**
+	 * Cancels the echo in place.
+	 * @param InOutMic			Microphone samples, replaced by the residual
+	 * @param Ref				Reference samples aligned with InOutMic
+	 * @param NumSamples		Number of samples in both buffers
+	 */
+	void Process(float* InOutMic, const float* Ref, int32 NumSamples);
+
+	bool IsInitialized() const { return FilterLength > 0; }
+
+	/** True if the last processed block was classified as double talk */
+	bool IsDoubleTalk() const { return DoubleTalkHangover > 0; }
+
+private:
+	int32 FilterLength;
+	float StepSize;
+
+	TArray<float> Weights;
+
+	/** Reference history stored twice so the filter window is always contiguous */
+	TArray<float> History;
+	int32 HistoryPos;
+
+	/** Sum of squares of the reference samples currently in the filter window */
+	float WindowPower;
+
+	/** Running peak of the reference magnitude used for double talk detection */
+	float ReferencePeak;
+	int32 DoubleTalkHangover;
+};
+
+/**
+ * Estimates the bulk delay of the echo in the microphone signal relative to the reference.
+ * Cross-correlates the short term envelopes of both signals, so it works before the canceller converged and costs little.
+ */
+class CONVAI_API FConvaiEchoDelayEstimator
+{
+public:
+	FConvaiEchoDelayEstimator();
+
+	/**
+	 * @param InSampleRate	Sample rate of both signals
+	 * @param InMaxLead		Largest lead of the echo over the reference searched for, in samples
+	 * @param InMaxDelay	Largest delay of the echo behind the reference searched for, in samples
+	 */
+	void Init(int32 InSampleRate, int32 InMaxLead, int32 InMaxDelay);
+
+	void Reset();
+
+	bool IsInitialized() const { return BlockSize > 0; }
+
+	/**
+	 * @param Mic			Microphone samples
+	 * @param Ref			Reference samples read for the same block as Mic
+	 * @param NumSamples	Number of samples in both buffers
+	 * @return	true when a new estimate is available from GetDelay
+	 */
+	bool Process(const float* Mic, const float* Ref, int32 NumSamples);
+
+	/** Delay of the echo behind the reference in samples, negative if the echo leads */
+	int32 GetDelay() const { return Delay; }
+
+private:
+	bool Estimate();
+
+	int32 BlockSize;
+	int32 MaxLeadBlocks;
+	int32 MaxDelayBlocks;
+	int32 WindowBlocks;
+	int32 IntervalBlocks;
+
+	/** Per block RMS of both signals, circular with HistoryPos as the next write */
+	TArray<float> MicEnvelope;
+	TArray<float> RefEnvelope;
+	int32 HistoryPos;
+	int32 HistoryNum;
+	int32 BlocksSinceEstimate;
+
+	int32 BlockFill;
+	float BlockMicEnergy;
+	float BlockRefEnergy;
+
+	int32 Delay;
+};
+
+/**
+ * Detects the player speaking over the character, works on the echo cancelled residual.
+ * Only meaningful while a canceller runs against the character's voice, the raw microphone would pick up the character itself.
+ */
+class CONVAI_API FConvaiBargeInDetector
+{
+public:
+	FConvaiBargeInDetector();
+
+	/**
+	 * @param InSampleRate			Sample rate of the processed audio
+	 * @param InThresholdDb			Minimum residual level in dBFS for a frame to count as speech
+	 * @param InMinSpeechDuration	Seconds of accumulated speech before barge-in triggers
+	 * @param InEchoRatio			Minimum residual to microphone energy ratio while the reference is active
+	 */
+	void Init(int32 InSampleRate, float InThresholdDb, float InMinSpeechDuration, float InEchoRatio = 0.25f);
+
+	void Reset();
+
+	/**
+	 * @param Mic				Microphone samples before echo cancellation
+	 * @param Residual			Microphone samples after echo cancellation
+	 * @param NumSamples		Number of samples in both buffers
+	 * @param bReferenceActive	True if the character was audible in this block
+	 * @return	true once when barge-in is detected
+	 */
+	bool Process(const float* Mic, const float* Residual, int32 NumSamples, bool bReferenceActive);
+
+	/** Seconds since the last frame classified as speech */
+	float GetSilenceDuration() const { return SilenceDuration; }
+
+private:
+	void ProcessFrame(float MicEnergy, float ResidualEnergy, bool bReferenceActive);
+
+	int32 SampleRate;
+	int32 FrameSize;
+	float ThresholdEnergy;
+	float MinSpeechDuration;
+	float EchoRatio;
+
+	float NoiseFloor;
+	float SpeechDuration;
+	float SilenceDuration;
+	bool bTriggered;
+	bool bTriggeredThisBlock;
+
+	int32 FrameFill;
+	float FrameMicEnergy;
+	float FrameResidualEnergy;
+};
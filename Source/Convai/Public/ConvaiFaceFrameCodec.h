@@ -0,0 +1,56 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * Wire format of replicated face frames.
+ * Curves are sent in the fixed layout order, quantized to 8 bits. Every frame only carries the curves whose quantized value
+ * changed, as a bit mask followed by one wrapping byte delta per changed curve. The first frame of a packet is coded against
+ * the zero frame, so resting curves cost one mask bit and a packet never depends on an earlier one.
+ * A packet holds one or more sequences of a single layout, each with its own duration.
+ */
+struct CONVAI_API FConvaiFaceFrameCodec
+{
+	/** Packet being built, the frames of several sequences share one delta chain */
+	struct FWriter
+	{
+		/**
+		 * @param StreamId		Changes with every new face stream, so receivers restart their timeline
+		 * @param StartTime		Seconds since the start of the stream at the first sequence of this packet
+		 */
+		void Begin(EConvaiFaceCurveSet InCurveSet, uint8 StreamId, float StartTime);
+
+		/** Empties the packet, Begin starts the next one */
+		void Reset() { Packet.Reset(); NumSequences = 0; }
+
+		/** Appends a sequence, frames of another layout are sent as zero frames */
+		void AddSequence(const FAnimationSequence& Sequence);
+
+		EConvaiFaceCurveSet GetCurveSet() const { return CurveSet; }
+		bool IsEmpty() const { return NumSequences == 0; }
+		int32 Num() const { return Packet.Num(); }
+
+		TArray<uint8> Packet;
+
+	private:
+		EConvaiFaceCurveSet CurveSet = EConvaiFaceCurveSet::None;
+		uint8 PreviousValues[FConvaiFaceCurves::MaxCurves];
+		int32 NumSequences = 0;
+	};
+
+	/** Decoded packet header */
+	struct FPacketInfo
+	{
+		uint8 StreamId = 0;
+		float StartTime = 0;
+	};
+
+	/** Appends the sequences of a packet, false if it is malformed or truncated, OutSequences is then left as it was */
+	static bool Decode(const TArray<uint8>& Packet, FPacketInfo& OutInfo, TArray<FAnimationSequence>& OutSequences);
+
+	/** Size of the frames as four byte floats per curve, what the packet saves against */
+	static int32 GetUncompressedSize(const FAnimationSequence& Sequence);
+};
@@ -0,0 +1,48 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * Face frames waiting to be played, oldest first.
+ * Storage is a power of two ring, played frames are released from the front and their slots reused by later frames,
+ * so memory is bounded by how far the received frames run ahead of playback rather than by the length of the response.
+ * Not thread-safe, the owner guards it.
+ */
+class CONVAI_API FConvaiFaceFrameRing
+{
+public:
+	FConvaiFaceFrameRing();
+
+	void Add(const FAnimationFrame& Frame);
+
+	void Append(const TArray<FAnimationFrame>& Frames);
+
+	/** Releases the oldest frames */
+	void RemoveFront(int32 NumToRemove);
+
+	/** Releases all frames, the storage is kept */
+	void Reset();
+
+	int32 Num() const { return Count; }
+
+	bool IsEmpty() const { return Count == 0; }
+
+	/** Frame by age, 0 is the oldest */
+	const FAnimationFrame& operator[](int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Slots[(Head + Index) & (Slots.Num() - 1)];
+	}
+
+	const FAnimationFrame& Last() const { return (*this)[Count - 1]; }
+
+private:
+	void Reserve(int32 MinCapacity);
+
+	TArray<FAnimationFrame> Slots;
+	int32 Head;
+	int32 Count;
+};
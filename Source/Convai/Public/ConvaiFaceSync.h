@@ -7,10 +7,29 @@
 #include "Components/SceneComponent.h"
 #include "Containers/Map.h"
 #include "ConvaiDefinitions.h"
+#include "ConvaiFaceFrameRing.h"
+#include "ConvaiBlendshapeRemap.h"
+#include <atomic>
 #include "ConvaiFaceSync.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiFaceSyncLog, Log, All);
 
+class UConvaiFaceSyncSubsystem;
+struct FConvaiLocalLipSync;
+
+UENUM(BlueprintType)
+enum class EConvaiLipSyncLOD : uint8
+{
+	/** Every curve, every frame */
+	Full,
+	/** Jaw and mouth curves only, at a reduced rate */
+	MouthOnly,
+	/** Jaw open only, at a low rate */
+	JawOnly,
+	/** No curves, only the sequence timing is kept */
+	Off
+};
+
 UCLASS(meta = (BlueprintSpawnableComponent), DisplayName = "Convai Face Sync")
 class CONVAI_API UConvaiFaceSyncComponent : public USceneComponent, public IConvaiLipSyncExtendedInterface
 {
@@ -22,6 +41,7 @@ public:
 
 	// UActorComponent interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	// virtual void OnRegister() override;
 	// virtual void OnUnregister() override;
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType,
@@ -29,13 +49,11 @@ public:
 	// End UActorComponent interface
 
 	// IConvaiLipSyncInterface
-	virtual void ConvaiProcessLipSync(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels) override { return; }
+	virtual void ConvaiProcessLipSync(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels) override;
 	virtual void ConvaiStopLipSync() override;
 	virtual TArray<float> ConvaiGetVisemes() override 
 	{ 
-		TArray<float> VisemeValues;
-		CurrentBlendShapesMap.GenerateValueArray(VisemeValues);
-		return VisemeValues;
+		return TArray<float>(CurrentFrame.GetData(), CurrentFrame.Num());
 	}
 	virtual TArray<FString> ConvaiGetVisemeNames() override { return ConvaiConstants::VisemeNames; }
 	// End IConvaiLipSyncInterface interface
@@ -43,31 +61,95 @@ public:
 	// IConvaiLipSyncExtendedInterface
 	virtual void ConvaiProcessLipSyncAdvanced(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels, FAnimationSequence FaceSequence) override;
 	virtual void ConvaiProcessLipSyncSingleFrame(FAnimationFrame FaceFrame, float Duration) override;
-	virtual bool RequiresPreGeneratedFaceData() override { return true; }
+	virtual bool RequiresPreGeneratedFaceData() override { return !bEstimateVisemesFromAudio; }
 	virtual bool GeneratesVisemesAsBlendshapes() override { return ToggleBlendshapeOrViseme; }
-	virtual TMap<FName, float> ConvaiGetFaceBlendshapes() override { return CurrentBlendShapesMap; }
+	virtual const TMap<FName, float>& ConvaiGetFaceBlendshapes() override { return GetCurrentFrameMap(); }
+	virtual void ConvaiSetVoiceSource(UConvaiAudioStreamer* InVoiceSource) override;
+	virtual bool ConvaiIsFaceDataNeeded() override;
+	virtual const FConvaiFaceCurves* ConvaiGetFaceCurves() override { return &CurrentFrame; }
 	// End IConvaiLipSyncExtendedInterface interface
 
 	bool IsValidSequence(const FAnimationSequence &Sequence);
 
+	/** How far the sequence advances this tick, follows the played audio of the voice source while it talks */
+	float GetSequenceDeltaTime(float DeltaTime) { return GetSequenceDeltaTime(DeltaTime, LastVoiceTime); }
+
+	/**
+	 * Advances the sequence and interpolates the current frame.
+	 * Touches only the face data of this component, so components can be evaluated in parallel.
+	 * @return	true if the current frame changed
+	 */
+	bool EvaluateFaceSync(float SequenceDeltaTime) { return EvaluateFaceSync(SequenceDeltaTime, LODPendingTime); }
+
+	/** True if there are buffered frames to play */
+	bool HasMainSequence() const { return MainSequenceDuration > 0 && !MainSequenceFrames.IsEmpty() && MainSequenceFrames[0].BlendShapes.Num() > 0; }
+
 	void ClearMainSequence();
 
 	TMap<FName, float> InterpolateFrames(const TMap<FName, float>& StartFrame, const TMap<FName, float>& EndFrame, float Alpha);
 
+	/** Interpolates in the current curve layout, curves of another layout count as zero */
+	void InterpolateFrames(const FConvaiFaceCurves& StartFrame, const FConvaiFaceCurves& EndFrame, float Alpha, FConvaiFaceCurves& OutFrame);
+
 	TMap<FName, float> GenerateZeroFrame() { return GeneratesVisemesAsBlendshapes() ? ZeroBlendshapeFrame : ZeroVisemeFrame; }
 
+	const FConvaiFaceCurves& GetZeroCurves() { return GeneratesVisemesAsBlendshapes() ? ZeroBlendshapeCurves : ZeroVisemeCurves; }
+
 	void SetCurrentFrametoZero() 
 	{ 
-		if (GeneratesVisemesAsBlendshapes()) 
-			CurrentBlendShapesMap = ZeroBlendshapeFrame; 
-		else 
-			CurrentBlendShapesMap = ZeroVisemeFrame;
+		CurrentFrame = GetZeroCurves();
+		bCurrentFrameMapDirty = true;
 	}
 
-	TMap<FName, float> GetCurrentFrame() { return CurrentBlendShapesMap; }
+	TMap<FName, float> GetCurrentFrame() { return GetCurrentFrameMap(); }
+
+	/** Name keyed view of the current frame, rebuilt only when the curve layout changes and its values refreshed in place after a frame change */
+	const TMap<FName, float>& GetCurrentFrameMap();
+
+	/** Current frame mapped to a rig, as UConvaiUtils::MapBlendshapes does, with the mapping compiled once and reused while it stays the same */
+	UFUNCTION(BlueprintPure, Category = "Convai|LipSync")
+	TMap<FName, float> GetMappedFrame(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier = 1, float GlobalOffset = 0) { return GetMappedFrameMap(BlendshapeMap, GlobalMultiplier, GlobalOffset); }
+
+	/** GetMappedFrame without the copy, the values are refreshed in place */
+	const TMap<FName, float>& GetMappedFrameMap(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset);
 
 	const static TMap<FName, float> ZeroBlendshapeFrame;
 	const static TMap<FName, float> ZeroVisemeFrame;
+	const static FConvaiFaceCurves ZeroBlendshapeCurves;
+	const static FConvaiFaceCurves ZeroVisemeCurves;
+
+	/** Game thread, selects the detail tier from the override or the on-screen size of the character */
+	void UpdateLipSyncLOD();
+
+	/** Forces a detail tier, for example from a significance manager */
+	UFUNCTION(BlueprintCallable, Category = "Convai|LipSync")
+	void SetLipSyncLODOverride(EConvaiLipSyncLOD LOD);
+
+	UFUNCTION(BlueprintCallable, Category = "Convai|LipSync")
+	void ClearLipSyncLODOverride();
+
+	UFUNCTION(BlueprintPure, Category = "Convai|LipSync")
+	EConvaiLipSyncLOD GetLipSyncLOD() const { return LipSyncLOD; }
+
+	/** Estimates the lipsync from the voice audio on worker threads instead of requesting face data from the server, also animates voices that come without face data */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync")
+	bool bEstimateVisemesFromAudio = false;
+
+	/** Selects the detail tier from the on-screen size of the character, otherwise the full tier is used */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync")
+	bool bEnableLipSyncLOD = true;
+
+	/** Screen size, as a share of the view width, below which only the mouth is animated */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync", meta = (EditCondition = "bEnableLipSyncLOD"))
+	float MouthOnlyScreenSize = 0.25f;
+
+	/** Screen size below which only the jaw is animated */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync", meta = (EditCondition = "bEnableLipSyncLOD"))
+	float JawOnlyScreenSize = 0.08f;
+
+	/** Screen size below which the lipsync is culled, so is a character that is not rendered */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync", meta = (EditCondition = "bEnableLipSyncLOD"))
+	float OffScreenSize = 0.02f;
 
 	//UPROPERTY(EditAnywhere, Category = "Convai|LipSync")
 	float AnchorValue = 0.5;
@@ -77,8 +159,66 @@ public:
 
 protected:
 	float CurrentSequenceTimePassed;
-	TMap<FName, float> CurrentBlendShapesMap;
-	FAnimationSequence MainSequenceBuffer;
+	FConvaiFaceCurves CurrentFrame;
+	TMap<FName, float> CurrentFrameMap;
+	bool bCurrentFrameMapDirty = true;
+	FConvaiBlendshapeRemap BlendshapeRemap;
+	TArray<float> MappedFrameValues;
+	TMap<FName, float> MappedFrameMap;
+	/** Frames not played yet, CurrentSequenceTimePassed and MainSequenceDuration are relative to the first of them */
+	FConvaiFaceFrameRing MainSequenceFrames;
+	float MainSequenceDuration = 0;
+
+	TWeakObjectPtr<UConvaiAudioStreamer> VoiceSource;
+	/** Voice time seen on the previous tick, negative while the voice is not talking. Only used while the component ticks itself, the subsystem keeps it per slot */
+	float LastVoiceTime = -1;
 	FCriticalSection SequenceCriticalSection;
 	bool Stopping;
+
+private:
+	friend class UConvaiFaceSyncSubsystem;
+
+	/** Any thread, hands the component to the face sync subsystem once it has frames to play */
+	void RequestFaceSyncUpdate();
+
+	/** Game thread, true if the sequence is played out and the component can leave the subsystem */
+	bool TryDeactivateFaceSync();
+
+	/** Game thread, the voice time the sequence clock continues from, negative while the voice is not talking */
+	float GetVoiceClock() const;
+
+	/** Variants on clock state owned by the caller, the subsystem passes the entries of the slot of the component */
+	float GetSequenceDeltaTime(float DeltaTime, float& InOutLastVoiceTime) const;
+	bool EvaluateFaceSync(float SequenceDeltaTime, float& InOutPendingTime);
+
+	EConvaiLipSyncLOD ComputeLipSyncLOD() const;
+
+	/** Plays out the current frame to zero, without cancelling audio waiting for the viseme estimator */
+	void FadeOutMainSequence();
+
+	/** Voice audio queued for the viseme estimator, shared with its worker task */
+	TSharedPtr<FConvaiLocalLipSync, ESPMode::ThreadSafe> LocalLipSync;
+
+	/** Interpolates the curves of the current tier, the others rest at the zero frame. Tier changes blend instead of popping */
+	bool InterpolateFramesForLOD(const FConvaiFaceCurves& StartFrame, const FConvaiFaceCurves& EndFrame, float Alpha, float DeltaTime);
+
+	/** Written on the game thread before evaluation */
+	EConvaiLipSyncLOD LipSyncLOD = EConvaiLipSyncLOD::Full;
+	bool bLipSyncLODOverridden = false;
+	EConvaiLipSyncLOD LipSyncLODOverride = EConvaiLipSyncLOD::Full;
+
+	/** Sequence time not evaluated yet because of the update rate of the tier. Only used while the component ticks itself, the subsystem keeps it per slot */
+	float LODPendingTime = 0;
+	/** Seconds left to blend into the current tier */
+	float LODBlendRemaining = 0;
+	FConvaiFaceCurves LODTargetFrame;
+
+	/** Null when the world has no face sync subsystem, the component then ticks itself */
+	UConvaiFaceSyncSubsystem* FaceSyncSubsystem = nullptr;
+
+	/** Set when frames arrive, cleared by the subsystem when the sequence is played out */
+	std::atomic<bool> bFaceSyncActive{ false };
+
+	/** Game thread, index of the component in the arrays of the subsystem while it is evaluated there */
+	int32 FaceSyncSlot = INDEX_NONE;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Containers/Queue.h"
+#include "ConvaiFaceSyncSubsystem.generated.h"
+
+class UConvaiFaceSyncComponent;
+
+/**
+ * Evaluates every face sync component of the world that has frames to play, in one parallel pass per frame.
+ * Components join when they receive frames and leave once their sequence is played out, idle components cost nothing.
+ * The per tick clock state of the active components lives here in parallel arrays indexed by their slot.
+ */
+UCLASS()
+class CONVAI_API UConvaiFaceSyncSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Any thread, the component received frames to play */
+	void ActivateFaceSync(UConvaiFaceSyncComponent* Component);
+
+	/** Game thread, the component is going away */
+	void RemoveFaceSync(UConvaiFaceSyncComponent* Component);
+
+	/** Game thread, the voice source of the component changed */
+	void ResetVoiceClock(const UConvaiFaceSyncComponent* Component);
+
+	int32 GetNumActiveFaceSyncs() const { return ActiveComponents.Num(); }
+
+private:
+	void AddSlot(UConvaiFaceSyncComponent* Component);
+
+	/** Swaps the last slot into the removed one, like every array below */
+	void RemoveSlot(int32 Slot);
+
+	UPROPERTY()
+	TArray<UConvaiFaceSyncComponent*> ActiveComponents;
+
+	/** Per active component, voice time seen on the previous tick, negative while the voice is not talking */
+	TArray<float> LastVoiceTimes;
+
+	/** Per active component, sequence time not evaluated yet because of the update rate of its lipsync LOD */
+	TArray<float> PendingSequenceTimes;
+
+	/** Per active component, filled on the game thread before the parallel pass */
+	TArray<float> SequenceDeltaTimes;
+
+	/** Per active component, written by the parallel pass */
+	TArray<bool> FramesChanged;
+
+	/** Components whose current frame changed this tick, notified after the list was updated */
+	TArray<TWeakObjectPtr<UConvaiFaceSyncComponent>> UpdatedComponents;
+
+	TQueue<TWeakObjectPtr<UConvaiFaceSyncComponent>, EQueueMode::Mpsc> PendingActivations;
+};
@@ -4,8 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "Components/AudioComponent.h"
-#include "RingBuffer.h"
+#include "ConvaiSPSCRingBuffer.h"
 #include "ConvaiAudioStreamer.h"
+#include "ConvaiEchoCanceller.h"
 #include "Net/OnlineBlueprintCallProxyBase.h"
 #include "DSP/BufferVectorOperations.h"
 #include "ConvaiPlayerComponent.generated.h"
@@ -18,6 +19,28 @@ DECLARE_DELEGATE(FonDataReceived_Delegate);
 
 // class IVoiceCapture;
 class UConvaiAudioCaptureComponent;
+class UConvaiChatbotComponent;
+class USoundSubmix;
+
+namespace Audio
+{
+	class FMixerDevice;
+}
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnBargeInSignature, UConvaiChatbotComponent*, ChatbotComponent);
+
+/** Game thread state a chunk of microphone audio is processed with, copied into the capture command when the chunk is requested */
+struct FConvaiVoiceCaptureMode
+{
+	bool bRecording = false;
+	bool bStreaming = false;
+	bool bMonitoringBargeIn = false;
+	bool bBargeInTurn = false;
+	bool bPreRolling = false;
+	bool bReplicate = false;
+	bool bEchoCancellation = false;
+	float BargeInEndSilenceDuration = 0;
+};
 
 // UENUM(BlueprintType)
 // enum class EHardwareInputFeatureBP : uint8
@@ -54,6 +77,17 @@ struct FCaptureDeviceInfoBP
 	bool bSupportsHardwareAEC = 0;
 };
 
+/** Parameters of a "Start Talking" call */
+struct FConvaiTalkingParams
+{
+	TWeakObjectPtr<UConvaiChatbotComponent> ChatbotComponent;
+	TWeakObjectPtr<UConvaiEnvironment> Environment;
+	bool GenerateActions = false;
+	bool VoiceResponse = true;
+	bool RunOnServer = false;
+	bool StreamPlayerMic = false;
+	bool UseServerAPI_Key = false;
+};
 
 UCLASS(meta = (BlueprintSpawnableComponent), DisplayName = "Convai Player")
 class UConvaiPlayerComponent : public UConvaiAudioStreamer
@@ -82,6 +116,33 @@ public:
 	UFUNCTION(Server, Reliable, Category = "Convai|Network")
 	void SetPlayerNameServer(const FString& NewPlayerName);
 
+	/** Removes the voice of the character being talked to from the microphone audio, needed when the player is not using headphones */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|Microphone")
+	bool EnableEchoCancellation = true;
+
+	/**
+	 * Keeps listening while the character talks and starts a new turn, using the last "Start Talking" parameters, when the player speaks over it.
+	 * Needs echo cancellation, without it the character's own voice reaching the microphone would interrupt it.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|Microphone", meta = (EditCondition = "EnableEchoCancellation"))
+	bool EnableBargeIn = false;
+
+	/** Minimum echo cancelled microphone level in dBFS that is considered speech */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|Microphone", meta = (EditCondition = "EnableBargeIn", ClampMax = "0"))
+	float BargeInThresholdDb = -40.0f;
+
+	/** Seconds of speech needed before the character is interrupted */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|Microphone", meta = (EditCondition = "EnableBargeIn", ClampMin = "0.05"))
+	float BargeInMinSpeechDuration = 0.3f;
+
+	/** Seconds of silence that end a turn started by barge-in */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|Microphone", meta = (EditCondition = "EnableBargeIn", ClampMin = "0.1"))
+	float BargeInEndSilenceDuration = 1.0f;
+
+	/** Called when the player speaks over the character and a new turn is started */
+	UPROPERTY(BlueprintAssignable, Category = "Convai|Microphone", meta = (DisplayName = "On Barge In"))
+	FOnBargeInSignature OnBargeInEvent;
+
 	UFUNCTION(BlueprintCallable, Category = "Convai|Microphone")
 	bool GetDefaultCaptureDeviceInfo(FCaptureDeviceInfoBP& OutInfo);
 
@@ -156,6 +217,7 @@ public:
 	void StartTalkingServer(
 		class UConvaiChatbotComponent* ConvaiChatbotComponent,
 		bool EnvironemntSent,
+		uint32 EnvironmentVersion,
 		const TArray<FString>& Actions,
 		const TArray<FConvaiObjectEntry>& Objects,
 		const TArray<FConvaiObjectEntry>& Characters,
@@ -193,6 +255,7 @@ public:
 		UConvaiChatbotComponent* ConvaiChatbotComponent,
 		const FString& Text,
 		bool EnvironemntSent,
+		uint32 EnvironmentVersion,
 		const TArray<FString>& Actions,
 		const TArray<FConvaiObjectEntry>& Objects,
 		const TArray<FConvaiObjectEntry>& Characters,
@@ -208,8 +271,12 @@ public:
 
 	virtual void OnServerAudioReceived(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData = true, uint32 SampleRate = 21000, uint32 NumChannels = 1) override;
 
+	/** The microphone audio of a player talking through the server is streamed to the backend from there */
+	virtual bool UsesServerAudio() const override { return true; }
+
 	// UActorComponent interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	bool ConsumeStreamingBuffer(TArray<uint8>& Buffer);
@@ -243,6 +310,19 @@ public:
 
 private:
 
+	/**
+	 * Server side, the environment a talk request refers to.
+	 * A non zero EnvironmentVersion refers to the character's replicated environment, which is then not sent again.
+	 */
+	UConvaiEnvironment* ResolveServerEnvironment(
+		UConvaiChatbotComponent* ConvaiChatbotComponent,
+		bool EnvironemntSent,
+		uint32 EnvironmentVersion,
+		const TArray<FString>& Actions,
+		const TArray<FConvaiObjectEntry>& Objects,
+		const TArray<FConvaiObjectEntry>& Characters,
+		const FConvaiObjectEntry& MainCharacter);
+
 	uint32 GenerateNewToken()
 	{
 		Token += 1;
@@ -254,12 +334,12 @@ private:
 
 	//TSharedPtr<IVoiceCapture> VoiceCapture;
 
-	// Buffer used with recording
+	// Buffer used with recording, filled on the audio thread and read by FinishRecording once the audio thread is done with it
 	TArray<uint8> VoiceCaptureBuffer;
 
-	// Buffer used with streaming
-	// TODO (Mohamed): use TCircularAudioBuffer instead
-	TRingBuffer<uint8> VoiceCaptureRingBuffer;
+	// Buffer used with streaming, consumed on the gRPC thread.
+	// Filled on the audio thread, or on the game thread for a player talking through the server.
+	TConvaiSPSCRingBuffer<uint8> VoiceCaptureRingBuffer;
 
 	UPROPERTY()
 	UConvaiAudioCaptureComponent* AudioCaptureComponent;
@@ -267,11 +347,94 @@ private:
 	void UpdateVoiceCapture(float DeltaTime);
 	void StartVoiceChunkCapture(float ExpectedRecordingTime = 0.01);
 	void StopVoiceChunkCapture();
-	void ReadRecordedBuffer(Audio::AlignedFloatBuffer& RecordedBuffer, float& OutNumChannels, float& OutSampleRate);
+
+	/** Audio thread, reads the chunk recorded since the last call and routes it as the game thread state in Mode says */
+	void ProcessVoiceChunk(Audio::FMixerDevice* MixerDevice, USoundSubmix* Submix, const FConvaiVoiceCaptureMode& Mode);
+
+	FConvaiVoiceCaptureMode GetVoiceCaptureMode() const;
+
+	/**
+	 * Queues a command on the audio thread, which runs all the capture processing.
+	 * Commands run in order, so state changes queued around a turn change apply between the right chunks.
+	 */
+	void RunOnCaptureThread(TFunction<void()> Command);
+	void WaitForCaptureThread();
 
 	void StartAudioCaptureComponent();
 	void StopAudioCaptureComponent();
 
+	/**
+	 * Cancels the echo of the current character in place, returns true if barge-in was detected.
+	 * Runs on the audio thread with the rest of the capture processing.
+	 */
+	bool ProcessEchoCancellation(TArray<int16>& InOutPCM, const FConvaiVoiceCaptureMode& Mode);
+
+	/** Appends NumSamples of reference, resampled to the capture rate, to EchoReferenceDelayLine */
+	void ReadEchoReference(int32 NumSamples);
+
+	/**
+	 * Moves the reference so the estimated echo path starts just inside the filter.
+	 * Delays up to EchoMaxBulkDelay are taken from the delay line, an echo leading the reference skips ahead in the ring.
+	 */
+	void ApplyEchoDelay(int32 EstimatedDelay);
+	void SetEchoReferenceSource(UConvaiChatbotComponent* ChatbotComponent);
+	void InitBargeInDetector();
+
+	void UpdateBargeInMonitoring();
+	void StartBargeInMonitoring();
+	void StopBargeInMonitoring();
+	void OnBargeInDetected();
+	void OnBargeInTurnEnded();
+
+	/** Parameters of the last "Start Talking" call, reused when barge-in opens a new turn */
+	FConvaiTalkingParams LastTalkingParams;
+
+	/** Game thread side of CapturedEchoReference */
+	TWeakObjectPtr<UConvaiChatbotComponent> EchoReferenceSource;
+
+	/** Owned by the audio thread like the canceller, detector, resampler and pre-roll state below */
+	TSharedPtr<FConvaiEchoReference, ESPMode::ThreadSafe> CapturedEchoReference;
+	FConvaiEchoCanceller EchoCanceller;
+	FConvaiEchoDelayEstimator EchoDelayEstimator;
+	FConvaiBargeInDetector BargeInDetector;
+
+	/** Reference resampler state, Phase is relative to LastReferenceSample */
+	float EchoReferencePhase = 0;
+	float LastEchoReferenceSample = 0;
+	int32 EchoReferenceSilentSamples = 0;
+	TArray<float> EchoReferenceScratch;
+
+	/** Reference as read from the ring, newest last, EchoReferenceDelay samples behind the end is aligned with the microphone */
+	TArray<float> EchoReferenceDelayLine;
+	int32 EchoReferenceDelay = 0;
+	TArray<float> EchoReferenceAligned;
+	TArray<float> EchoMicScratch;
+	TArray<float> EchoMicOriginal;
+
+	bool CanPreRoll() const;
+
+	/** Pre-roll length in samples wanted by the current settings */
+	int32 GetDesiredPreRollSamples() const;
+	void InitPreRoll();
+	void UpdatePreRoll();
+	void PushPreRoll(const TArray<int16>& PCMData);
+	void FlushPreRoll(bool bReplicate);
+
+	/** Last few hundred milliseconds of microphone audio captured while not talking */
+	TArray<int16> PreRollBuffer;
+	int32 PreRollWriteIndex = 0;
+	int32 PreRollNum = 0;
+
+	/** Game thread copy of the size last requested for PreRollBuffer */
+	int32 PreRollCapacity = 0;
+	bool IsPreRolling = false;
+
+	bool IsMonitoringBargeIn = false;
+	bool IsBargeInTurn = false;
+	/** Raised by the audio thread, handled by the next tick which owns the turn state */
+	std::atomic<bool> BargeInDetectedPending{ false };
+	std::atomic<bool> BargeInTurnEndedPending{ false };
+
 
 	FonDataReceived_Delegate onDataReceived_Delegate;
 
@@ -0,0 +1,80 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Sound/SoundWaveProcedural.h"
+#include <atomic>
+
+#include "ConvaiSoundWaveProcedural.generated.h"
+
+struct FConvaiEchoReference;
+
+/**
+ * Procedural sound wave used for character voices.
+ * Acts as a jitter buffer: playback only starts once enough audio is queued to ride out the measured inter-arrival jitter,
+ * and the number of bytes actually handed to the mixer is counted on the audio render thread so the end of speech follows the audio clock.
+ * Every block handed to the mixer is also forwarded to an optional echo reference.
+ */
+UCLASS()
+class UConvaiSoundWaveProcedural : public USoundWaveProcedural
+{
+	GENERATED_BODY()
+
+public:
+	UConvaiSoundWaveProcedural(const FObjectInitializer& ObjectInitializer);
+
+	// USoundWave interface, called on the audio render thread
+	virtual int32 GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded) override;
+
+	/** Game thread, queues a received voice chunk and updates the jitter estimate */
+	void QueueVoice(const uint8* AudioData, const int32 BufferSize);
+
+	/** Game thread, drops all queued audio */
+	void ResetVoice();
+
+	/** Game thread, clears the state left by the previous owner when the wave is handed out again by the pool. The wave must not be playing */
+	void ResetForReuse();
+
+	/** True once every queued byte was played and the buffer stayed starved for longer than the target depth */
+	bool IsPlaybackFinished() const;
+
+	/** Seconds of queued audio not yet handed to the mixer */
+	float GetRemainingDuration() const;
+
+	/** Seconds of audio handed to the mixer since the current utterance started */
+	float GetPlayedDuration() const;
+
+	/** Current jitter buffer target depth in seconds */
+	float GetTargetDepth() const;
+
+	/** Number of times playback ran dry in the middle of speech */
+	uint32 GetNumUnderruns() const { return NumUnderruns; }
+
+	/** Shared with the owning streamer so the audio thread never touches a destroyed buffer */
+	TSharedPtr<FConvaiEchoReference, ESPMode::ThreadSafe> EchoReference;
+
+private:
+	int32 GetBytesPerSecond() const;
+
+	void UpdateTargetDepth();
+
+	// Game thread
+	int64 QueuedBytes;
+	int64 ConsumedBytesAtStart;
+	double LastArrivalTime;
+	float LastChunkDuration;
+	float InterArrivalJitter;
+	uint32 NumUnderruns;
+
+	// Written by the game thread, read by the audio render thread
+	std::atomic<int32> TargetDepthBytes;
+
+	// Written by the audio render thread, read by the game thread
+	std::atomic<int64> ConsumedBytes;
+	std::atomic<int32> StarvedBytes;
+
+	// Audio render thread
+	bool bBuffering;
+	int32 BufferingBytes;
+};
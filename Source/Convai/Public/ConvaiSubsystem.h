@@ -61,6 +61,9 @@ namespace grpc
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiSubsystemLog, Log, All);
 
+class UConvaiSoundWaveProcedural;
+class UConvaiAudioStreamer;
+
 DECLARE_DELEGATE_OneParam(FgRPC_Delegate, bool);
 
 class FgRPCClient : public FRunnable {
@@ -111,6 +114,18 @@ private:
 };
 
 
+USTRUCT()
+struct FConvaiVoiceWavePoolEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UConvaiSoundWaveProcedural* Wave = nullptr;
+
+	/** When the wave was returned, it is only handed out again once the audio renderer let go of it */
+	double ReleaseTime = 0;
+};
+
 UCLASS(meta = (DisplayName = "Convai Subsystem"))
 class UConvaiSubsystem : public UGameInstanceSubsystem
 {
@@ -127,6 +142,40 @@ public:
 
 	void GetAndroidMicPermission();
 
+	/** Hands out an idle voice wave of the given format, creating one if none is available */
+	UConvaiSoundWaveProcedural* AcquireVoiceWave(int32 SampleRate, int32 NumChannels);
+
+	/** Returns a voice wave once its owner stopped playing it, the wave keeps its buffer capacity for the next owner */
+	void ReleaseVoiceWave(UConvaiSoundWaveProcedural* Wave);
+
+	/** Creates a voice wave that is not part of any pool */
+	static UConvaiSoundWaveProcedural* CreateVoiceWave(UObject* Outer, int32 SampleRate, int32 NumChannels);
+
+	/**
+	 * Called every frame by each streamer that has speech to play, returns false if the voice is over the audible voice budget.
+	 * Voices known from the previous frame keep the decision made from the priorities submitted then,
+	 * a new voice is decided on its first request so it is never heard before being culled.
+	 */
+	bool RequestAudibleVoice(UConvaiAudioStreamer* Streamer, float Priority);
+
+private:
+	void PrewarmVoiceWaves(int32 SampleRate, int32 NumChannels, int32 Count);
+
+	/** Keeps the highest priority voices of the last frame audible and culls the rest */
+	void ResolveVoiceBudget();
+
+	/** Voices that asked to play since the budget was last resolved */
+	TArray<TPair<TWeakObjectPtr<UConvaiAudioStreamer>, float>> VoiceRequests;
+	TSet<TWeakObjectPtr<UConvaiAudioStreamer>> AudibleVoices;
+	TSet<TWeakObjectPtr<UConvaiAudioStreamer>> CulledVoices;
+
+	/** Priority of the quietest audible voice, a new voice has to beat it once the budget is full */
+	float LowestAudiblePriority = 0;
+	uint64 VoiceBudgetFrame = 0;
+
+	UPROPERTY()
+	TArray<FConvaiVoiceWavePoolEntry> FreeVoiceWaves;
+
 public:
     TSharedPtr<FgRPCClient> gRPC_Runnable;
 };
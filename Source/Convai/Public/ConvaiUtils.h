@@ -67,6 +67,7 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Convai")
 	static void GetPlatformInfo(FString& EngineVersion, FString& PlatformName);
 
+	/** Name based mapping of any curve map, UConvaiFaceSyncComponent::GetMappedFrame gives the same result from a compiled mapping */
 	UFUNCTION(BlueprintPure, Category = "Convai")
 	static TMap<FName, float> MapBlendshapes(const TMap<FName,float>& InputBlendshapes, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset);
 
@@ -84,10 +85,17 @@ public:
 
 	static FString FUTF8ToFString(const char* StringToConvert);
 
+	/** Edit distance with substitutions costing 2, strings equal ignoring case are at 0 */
 	static int LevenshteinDistance(const FString& s, const FString& t);
 
+	/** Insertions and deletions cost 1, case-sensitive, a metric. Bit-parallel when either string fits 64 characters */
+	static int32 IndelDistance(const FString& s, const FString& t);
+
 	static TArray<FAnimationFrame> ParseJsonToBlendShapeData(const FString& JsonString);
 
+	/** Appends the frames of a UTF-8 blendshape payload, on failure nothing is appended */
+	static bool ParseJsonToBlendShapeData(const ANSICHAR* Json, int32 Length, TArray<FAnimationFrame>& OutFrames);
+
 	static bool ParseVisemeValuesToAnimationFrame(const FString& VisemeValuesString, FAnimationFrame& AnimationFrame);
 
 
@@ -0,0 +1,74 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * Estimates visemes from speech PCM on the CPU, for voices that come without face data from the server.
+ * The signal runs through four band-pass filters covering roughly the first formant, the second formant, the upper formants
+ * and fricative noise. Every 10 ms the band balance, loudness and zero crossing rate are mapped to viseme weights,
+ * the same frame rate as the visemes of the server.
+ * Not thread-safe, calls must be serialized.
+ */
+class CONVAI_API FConvaiVisemeEstimator
+{
+public:
+	FConvaiVisemeEstimator();
+
+	/**
+	 * Appends one frame per full hop of audio, a partial hop is carried over to the next call.
+	 * @param PCM			Interleaved 16 bit samples
+	 * @param NumFrames		Samples per channel
+	 * @param CurveSet		Layout of the produced frames, blendshapes are derived from the visemes
+	 */
+	void Process(const int16* PCM, int32 NumFrames, int32 NumChannels, int32 SampleRate, EConvaiFaceCurveSet CurveSet, TArray<FAnimationFrame>& OutFrames);
+
+	/** Forgets the filter state and the carried over audio, for the start of a new utterance */
+	void Reset();
+
+	/** Seconds of audio per produced frame */
+	static float GetFrameDuration();
+
+private:
+	static constexpr int32 NumBands = 4;
+
+	/** RBJ band-pass biquad, constant peak gain */
+	struct FBandFilter
+	{
+		void Init(float SampleRate, float CenterFrequency, float Q);
+		void Reset() { X1 = X2 = Y1 = Y2 = 0; }
+
+		float Process(float X)
+		{
+			const float Y = B0 * X + B2 * X2 - A1 * Y1 - A2 * Y2;
+			X2 = X1;
+			X1 = X;
+			Y2 = Y1;
+			Y1 = Y;
+			return Y;
+		}
+
+		float B0 = 0, B2 = 0, A1 = 0, A2 = 0;
+		float X1 = 0, X2 = 0, Y1 = 0, Y2 = 0;
+	};
+
+	void Configure(int32 SampleRate);
+
+	void EmitFrame(EConvaiFaceCurveSet CurveSet, TArray<FAnimationFrame>& OutFrames);
+
+	static void VisemesToBlendshapes(const float* Visemes, FConvaiFaceCurves& OutBlendshapes);
+
+	FBandFilter Bands[NumBands];
+	float BandEnergy[NumBands];
+	float HopEnergy;
+	int32 HopZeroCrossings;
+	int32 HopPosition;
+	int32 HopSamples;
+	int32 ConfiguredSampleRate;
+	float LastSample;
+	float LastLoudness;
+	float Smoothed[EConvaiViseme::Count];
+	int32 NextFrameIndex;
+};
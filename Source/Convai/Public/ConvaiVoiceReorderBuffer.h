@@ -0,0 +1,99 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Opus packet produced by the encode task, waiting to be replicated on the game thread */
+struct FConvaiEncodedVoicePacket
+{
+	TArray<uint8> EncodedData;
+	uint32 SampleRate = 0;
+	uint32 NumChannels = 0;
+	uint32 SizeBeforeEncode = 0;
+	/** Increases by one per packet, wraps around */
+	uint16 Sequence = 0;
+};
+
+/** Opus packet received from the network, waiting for the decode task */
+struct FConvaiReceivedVoicePacket
+{
+	FConvaiEncodedVoicePacket Packet;
+	/** The packet never arrived, the decoder conceals it */
+	bool bLost = false;
+	/** Data of the following packet if it already arrived, its in-band FEC recovers the end of a lost packet */
+	TArray<uint8> FECData;
+	bool bPlay = false;
+	bool bServer = false;
+	/** Packets before this one were not decoded while the voice was culled */
+	bool bResetDecoder = false;
+};
+
+/**
+ * Puts voice packets received over an unreliable channel back in sequence order.
+ * Packets are held for a short time while an earlier one is missing, then the missing one is released as lost so the decoder can conceal it.
+ * Game thread only.
+ */
+class CONVAI_API FConvaiVoiceReorderBuffer
+{
+public:
+	FConvaiVoiceReorderBuffer();
+
+	/**
+	 * @param InWindowSize		Number of packets that can be held while waiting for a missing one
+	 * @param InTimeout			Seconds a packet waits for a missing earlier one before that one is declared lost
+	 */
+	void Init(int32 InWindowSize, float InTimeout);
+
+	/** Reliable start marker, FirstSequence is the first packet of the new stream */
+	void StartStream(uint16 FirstSequence, TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	/** Reliable stop marker, LastSequence is the last packet of the stream */
+	void EndStream(uint16 LastSequence, double Now);
+
+	void AddPacket(FConvaiEncodedVoicePacket&& Packet, double Now, TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	/** Releases packets whose missing predecessors timed out */
+	void Update(double Now, TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	bool IsActive() const { return bActive; }
+
+	uint32 GetNumLost() const { return NumLost; }
+
+	uint32 GetNumLate() const { return NumLate; }
+
+private:
+	struct FSlot
+	{
+		FConvaiEncodedVoicePacket Packet;
+		double ArrivalTime = 0;
+		bool bValid = false;
+	};
+
+	FSlot& GetSlot(uint16 Sequence) { return Slots[Sequence % Slots.Num()]; }
+
+	/** Releases the next packet in sequence, as lost if it did not arrive */
+	void ReleaseNext(TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	/** Releases every packet that is next in sequence */
+	void ReleaseReady(TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	/** Releases the packets that did arrive and drops the gaps */
+	void ReleasePending(TArray<FConvaiReceivedVoicePacket>& OutReleased);
+
+	void Restart(uint16 FirstSequence);
+
+	TArray<FSlot> Slots;
+	float Timeout;
+	int32 NumPending;
+
+	bool bActive;
+	uint16 NextSequence;
+
+	bool bHasEnd;
+	uint16 EndSequence;
+	double EndTime;
+
+	uint32 NumLost;
+	uint32 NumLate;
+};
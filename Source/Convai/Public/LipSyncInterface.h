@@ -9,6 +9,8 @@
 
 DECLARE_DELEGATE(FOnVisemesDataReadySignature);
 
+class UConvaiAudioStreamer;
+
 UINTERFACE()
 class CONVAI_API UConvaiLipSyncInterface : public UInterface
 {
@@ -43,5 +45,12 @@ public:
 	virtual void ConvaiProcessLipSyncSingleFrame(FAnimationFrame FaceFrame, float Duration) = 0;
 	virtual bool RequiresPreGeneratedFaceData() = 0;
 	virtual bool GeneratesVisemesAsBlendshapes() = 0;
-	virtual TMap<FName, float> ConvaiGetFaceBlendshapes() = 0;
+	/** Current curves by name, the map is kept by the implementation and stays valid until its next update */
+	virtual const TMap<FName, float>& ConvaiGetFaceBlendshapes() = 0;
+	/** Current curves without building a map, nullptr if the implementation does not keep them */
+	virtual const FConvaiFaceCurves* ConvaiGetFaceCurves() { return nullptr; }
+	/** The voice whose playback position drives the lipsync timing, nullptr to run on the game clock */
+	virtual void ConvaiSetVoiceSource(UConvaiAudioStreamer* VoiceSource) {}
+	/** False while the lipsync is culled, the character then requests no face data from the server */
+	virtual bool ConvaiIsFaceDataNeeded() { return true; }
 };
\ No newline at end of file